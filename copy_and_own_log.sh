@@ -8,7 +8,8 @@ else
     exit
 fi
 
-cp build/main/${log_name} ../Matlab/Muestra_defensa/plot_datos_log/
+# El log del main es binario, se convierte al formato de texto de siempre
+build/flight_log/flight_log2txt build/main/${log_name} ../Matlab/Muestra_defensa/plot_datos_log/${log_name}
 
 chown labcontrol2 ../Matlab/Muestra_defensa/plot_datos_log//${log_name}
 
@@ -39,11 +39,17 @@
 #define FAKE_YAW		1
 #define SOCKET_TEST		0
 
+// Planificacion de sbusd (requieren superusuario)
+#define SBUSD_SCHED_FIFO	0	//usa SCHED_FIFO en lugar de setpriority()
+#define SBUSD_FIFO_PRIO		50	//prioridad SCHED_FIFO de sbusd
+#define SBUSD_MLOCKALL		0	//evita page faults bloqueando la memoria de sbusd
+
 #define DEBUG                   1
 
 #if DEBUG
    #define DEBUG_TIMING_MAIN	0 //imprime en stdout la duracion del loop
    #define DEBUG_TIMING_SBUSD	0
+   #define DEBUG_SBUS_ENCODER	0 //compara el mensaje sbus con el codificador bit a bit
 #endif //DEBUG
 
 
@@ -0,0 +1,227 @@
+/**
+ ******************************************************************************
+ *
+ * @file       uquad_aux_evloop.c
+ * @author     Federico Favaro, Joaquin Berrutti y Lucas Falkenstein
+ * @brief      Bucle de eventos basado en epoll y timerfd.
+ *
+ *****************************************************************************/
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <http://www.gnu.org/licenses/> or write to the
+ * Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "uquad_aux_evloop.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+
+// Identificador del timer en epoll_event.data.u32
+#define UQUAD_EV_TIMER_ID	UQUAD_EV_MAX_FDS
+
+uquad_evloop_t *uquad_evloop_init(void)
+{
+    int i;
+    uquad_evloop_t *ev = (uquad_evloop_t *)malloc(sizeof(uquad_evloop_t));
+    if(ev == NULL)
+    {
+	err_log_stderr("malloc()");
+	return NULL;
+    }
+
+    ev->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if(ev->epfd < 0)
+    {
+	err_log_stderr("epoll_create1()");
+	free(ev);
+	return NULL;
+    }
+
+    for(i = 0; i < UQUAD_EV_MAX_FDS; ++i)
+	ev->src[i].fd = -1;
+    ev->timer.fd = -1;
+    ev->ticks = 0;
+    ev->overruns = 0;
+
+    return ev;
+}
+
+int uquad_evloop_add_fd(uquad_evloop_t *ev, int fd, uquad_ev_cb_t cb, void *arg)
+{
+    int i;
+    struct epoll_event e;
+
+    if(ev == NULL || cb == NULL || fd < 0)
+    {
+	err_check(ERROR_INVALID_ARG,"Invalid argument!");
+    }
+
+    for(i = 0; i < UQUAD_EV_MAX_FDS; ++i)
+	if(ev->src[i].fd < 0)
+	    break;
+    if(i == UQUAD_EV_MAX_FDS)
+    {
+	err_check(ERROR_FAIL,"Too many event sources!");
+    }
+
+    e.events = EPOLLIN;
+    e.data.u32 = (uint32_t)i;
+    if(epoll_ctl(ev->epfd, EPOLL_CTL_ADD, fd, &e) < 0)
+    {
+	err_log_stderr("epoll_ctl()");
+	return ERROR_IO;
+    }
+
+    ev->src[i].fd = fd;
+    ev->src[i].cb = cb;
+    ev->src[i].arg = arg;
+
+    return ERROR_OK;
+}
+
+int uquad_evloop_rm_fd(uquad_evloop_t *ev, int fd)
+{
+    int i;
+
+    if(ev == NULL)
+    {
+	err_check(ERROR_NULL_POINTER,"Invalid argument!");
+    }
+
+    for(i = 0; i < UQUAD_EV_MAX_FDS; ++i)
+	if(ev->src[i].fd == fd)
+	    break;
+    if(i == UQUAD_EV_MAX_FDS)
+    {
+	err_check(ERROR_IO_DEV_NOT_FOUND,"fd not registered!");
+    }
+
+    // Si el fd ya fue cerrado epoll lo quito solo, no es un error.
+    (void)epoll_ctl(ev->epfd, EPOLL_CTL_DEL, fd, NULL);
+    ev->src[i].fd = -1;
+
+    return ERROR_OK;
+}
+
+int uquad_evloop_set_period(uquad_evloop_t *ev, unsigned long period_us, uquad_ev_cb_t cb, void *arg)
+{
+    struct itimerspec its;
+    struct epoll_event e;
+    int tfd;
+
+    if(ev == NULL || cb == NULL || period_us == 0)
+    {
+	err_check(ERROR_INVALID_ARG,"Invalid argument!");
+    }
+    if(ev->timer.fd >= 0)
+    {
+	err_check(ERROR_FAIL,"Period already set!");
+    }
+
+    tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if(tfd < 0)
+    {
+	err_log_stderr("timerfd_create()");
+	return ERROR_IO;
+    }
+
+    its.it_interval.tv_sec  = period_us / 1000000UL;
+    its.it_interval.tv_nsec = (period_us % 1000000UL) * 1000L;
+    its.it_value = its.it_interval;
+    if(timerfd_settime(tfd, 0, &its, NULL) < 0)
+    {
+	err_log_stderr("timerfd_settime()");
+	close(tfd);
+	return ERROR_IO;
+    }
+
+    e.events = EPOLLIN;
+    e.data.u32 = UQUAD_EV_TIMER_ID;
+    if(epoll_ctl(ev->epfd, EPOLL_CTL_ADD, tfd, &e) < 0)
+    {
+	err_log_stderr("epoll_ctl()");
+	close(tfd);
+	return ERROR_IO;
+    }
+
+    ev->timer.fd = tfd;
+    ev->timer.cb = cb;
+    ev->timer.arg = arg;
+
+    return ERROR_OK;
+}
+
+int uquad_evloop_run_once(uquad_evloop_t *ev, int timeout_ms)
+{
+    struct epoll_event events[UQUAD_EV_MAX_FDS + 1];
+    uquad_ev_src_t *src;
+    uint64_t expirations;
+    int n, i, retval, ret_first = ERROR_OK;
+    int timer_fired = 0;
+
+    n = epoll_wait(ev->epfd, events, UQUAD_EV_MAX_FDS + 1, timeout_ms);
+    if(n < 0)
+    {
+	if(errno == EINTR)
+	    // Llego una senal, no es un error
+	    return ERROR_OK;
+	err_log_stderr("epoll_wait()");
+	return ERROR_IO;
+    }
+
+    // Primero las fuentes de datos, el timer al final
+    for(i = 0; i < n; ++i)
+    {
+	if(events[i].data.u32 == UQUAD_EV_TIMER_ID)
+	{
+	    timer_fired = 1;
+	    continue;
+	}
+	src = &ev->src[events[i].data.u32];
+	if(src->fd < 0)
+	    // Se quito durante esta misma iteracion
+	    continue;
+	retval = src->cb(src->fd, src->arg);
+	if(retval != ERROR_OK && ret_first == ERROR_OK)
+	    ret_first = retval;
+    }
+
+    if(timer_fired)
+    {
+	retval = read(ev->timer.fd, &expirations, sizeof(expirations));
+	if(retval == sizeof(expirations))
+	{
+	    ev->ticks += expirations;
+	    if(expirations > 1)
+		ev->overruns += expirations - 1;
+	    retval = ev->timer.cb(ev->timer.fd, ev->timer.arg);
+	    if(retval != ERROR_OK && ret_first == ERROR_OK)
+		ret_first = retval;
+	}
+    }
+
+    return ret_first;
+}
+
+void uquad_evloop_deinit(uquad_evloop_t *ev)
+{
+    if(ev == NULL)
+	return;
+    if(ev->timer.fd >= 0)
+	close(ev->timer.fd);
+    close(ev->epfd);
+    free(ev);
+}
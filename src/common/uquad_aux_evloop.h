@@ -0,0 +1,126 @@
+/**
+ ******************************************************************************
+ *
+ * @file       uquad_aux_evloop.h
+ * @author     Federico Favaro, Joaquin Berrutti y Lucas Falkenstein
+ * @brief      Bucle de eventos basado en epoll y timerfd.
+ *
+ * Permite registrar file descriptors (IMU, GPS, stdin, etc) junto con un
+ * callback que se ejecuta cuando el fd tiene datos para leer, y un periodo
+ * de control generado con un timerfd. El proceso duerme en epoll_wait() en
+ * lugar de hacer polling con select() y usleep().
+ *
+ * Examples:
+ *   - src/main/main.c
+ *
+ *****************************************************************************/
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <http://www.gnu.org/licenses/> or write to the
+ * Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+#ifndef UQUAD_AUX_EVLOOP_H
+#define UQUAD_AUX_EVLOOP_H
+
+#include <uquad_error_codes.h>
+
+#define UQUAD_EV_MAX_FDS	8	// cantidad maxima de fuentes registradas (sin contar el timer)
+
+/**
+ * Callback a ejecutar cuando un fd esta pronto para leer.
+ *
+ * @param fd file descriptor que genero el evento
+ * @param arg argumento registrado junto con el fd
+ *
+ * @return error code
+ */
+typedef int (*uquad_ev_cb_t)(int fd, void *arg);
+
+typedef struct uquad_ev_src {
+    int fd;			// -1 si el lugar esta libre
+    uquad_ev_cb_t cb;
+    void *arg;
+} uquad_ev_src_t;
+
+typedef struct uquad_evloop {
+    int epfd;					// instancia de epoll
+    uquad_ev_src_t src[UQUAD_EV_MAX_FDS];	// fuentes de datos
+    uquad_ev_src_t timer;			// timerfd periodico (fd == -1 si no se configuro)
+    unsigned long ticks;			// periodos atendidos
+    unsigned long overruns;			// periodos perdidos por atraso del callback
+} uquad_evloop_t;
+
+/**
+ * Crea la instancia de epoll.
+ *
+ * @return puntero al bucle de eventos, NULL si falla
+ */
+uquad_evloop_t *uquad_evloop_init(void);
+
+/**
+ * Registra un fd para ser atendido cuando tenga datos para leer.
+ * El fd se registra en modo level-triggered, por lo que si el callback
+ * no consume todos los datos se vuelve a llamar en la proxima iteracion.
+ *
+ * @param ev
+ * @param fd
+ * @param cb callback a ejecutar
+ * @param arg argumento para el callback
+ *
+ * @return error code
+ */
+int uquad_evloop_add_fd(uquad_evloop_t *ev, int fd, uquad_ev_cb_t cb, void *arg);
+
+/**
+ * Quita un fd del bucle de eventos.
+ *
+ * @param ev
+ * @param fd
+ *
+ * @return error code
+ */
+int uquad_evloop_rm_fd(uquad_evloop_t *ev, int fd);
+
+/**
+ * Configura un timerfd periodico (CLOCK_MONOTONIC). El callback se ejecuta
+ * una vez por periodo, despues de atender al resto de las fuentes que
+ * tengan datos en la misma iteracion, de forma que el control use siempre
+ * los datos mas nuevos.
+ *
+ * @param ev
+ * @param period_us periodo en microsegundos
+ * @param cb callback a ejecutar
+ * @param arg argumento para el callback
+ *
+ * @return error code
+ */
+int uquad_evloop_set_period(uquad_evloop_t *ev, unsigned long period_us, uquad_ev_cb_t cb, void *arg);
+
+/**
+ * Espera eventos y ejecuta los callbacks correspondientes.
+ *
+ * @param ev
+ * @param timeout_ms tiempo maximo de espera, -1 para esperar indefinidamente
+ *
+ * @return error code del primer callback que falle, ERROR_OK si no hubo errores
+ */
+int uquad_evloop_run_once(uquad_evloop_t *ev, int timeout_ms);
+
+/**
+ * Cierra epoll y el timerfd y libera memoria. No cierra los fds registrados.
+ *
+ * @param ev
+ */
+void uquad_evloop_deinit(uquad_evloop_t *ev);
+
+#endif
@@ -102,6 +102,29 @@ int wait_loop_T_US(unsigned long loop_duration_usec, struct timeval tv_in)
 }
 
 
+void uquad_timespec_add_ns(struct timespec *ts, long ns)
+{
+   ts->tv_sec  += ns / 1000000000L;
+   ts->tv_nsec += ns % 1000000000L;
+   if(ts->tv_nsec >= 1000000000L)
+   {
+      ts->tv_nsec -= 1000000000L;
+      ts->tv_sec++;
+   }
+   else if(ts->tv_nsec < 0)
+   {
+      ts->tv_nsec += 1000000000L;
+      ts->tv_sec--;
+   }
+}
+
+
+long long uquad_timespec_diff_ns(const struct timespec *x, const struct timespec *y)
+{
+   return (long long)(x->tv_sec - y->tv_sec)*1000000000LL + (x->tv_nsec - y->tv_nsec);
+}
+
+
 static struct timeval main_start_time;
 
 void set_main_start_time(void)
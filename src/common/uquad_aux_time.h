@@ -32,6 +32,7 @@
 #include <quadcop_config.h>
 
 #include <sys/time.h>
+#include <time.h> // for struct timespec, clock_nanosleep()
 #include <unistd.h> // for usleep()
 
 #define double2tv(tv,db)						\
@@ -48,6 +49,7 @@
 #define sleep_ms(ms) usleep(1000*ms)
 
 #define MAIN_LOOP_50_MS		49800UL//50000UL//105000UL
+#define MAIN_LOOP_T_US		50000UL	// periodo del timerfd del main (no necesita compensar el overhead)
 
 /** 
  * Calculate the difference between two time vals, without losing precision.
@@ -86,6 +88,24 @@ int in_range_us(struct timeval tv_diff, long int min_us, long int max_us);
  */
 int wait_loop_T_US(unsigned long loop_duration_usec, struct timeval tv_in);
 
+/**
+ * Suma un intervalo en nanosegundos a un timespec, normalizando tv_nsec.
+ *
+ * @param ts timespec a modificar
+ * @param ns intervalo a sumar (puede ser negativo)
+ */
+void uquad_timespec_add_ns(struct timespec *ts, long ns);
+
+/**
+ * Diferencia entre dos timespec, en nanosegundos.
+ *
+ * @param x
+ * @param y
+ *
+ * @return x-y [ns]
+ */
+long long uquad_timespec_diff_ns(const struct timespec *x, const struct timespec *y);
+
 void set_main_start_time(void);
 
 struct timeval get_main_start_time(void);
@@ -28,25 +28,34 @@
 #include <math.h>
 #include <quadcop_config.h>
 
-double Kp_alt = 1.85;     
-double Td_alt = 2.0;
-double alpha_alt = 0.3;
-double a_alt = 0.5;
-double b_alt = 0.5;
-
-/**
- * Buffer para almacenar senales de error
- * 
- * Elemento mas nuevo se almacena el lugar correspondiente
- *  al indice cero
+/*
+ * Inicializa el controlador con las ganancias por defecto y el estado en cero
  */
-error_alt_t error_alt_buff[CONTROL_ALT_BUFF_SIZE];
+void control_alt_init(control_alt_t *ctl)
+{
+   ctl->Kp = CONTROL_ALT_KP;
+   ctl->Td = CONTROL_ALT_TD;
+   ctl->alpha = CONTROL_ALT_ALPHA;
+   ctl->a = CONTROL_ALT_A;
+   ctl->b = CONTROL_ALT_B;
+   ctl->ki = CONTROL_ALT_KI;
+   ctl->alpha_i = CONTROL_ALT_ALPHA_I;
+
+   control_alt_init_error_buff(ctl);
+   ctl->y_k_1 = 0;
+   ctl->x_k_1 = 0;
+   ctl->yi_k_1 = 0;
+
+   ctl->alt_zero = 0;
+
+   return;
+}
 
 
 /*
  * Inicializa el buffer
  */
-void control_alt_init_error_buff(void)
+void control_alt_init_error_buff(control_alt_t *ctl)
 {
    error_alt_t new_err;
    new_err.error = 0;
@@ -54,7 +63,7 @@ void control_alt_init_error_buff(void)
    // Inicializo en cero
    for(i=0; i < CONTROL_ALT_BUFF_SIZE; i++)
    {
-      error_alt_buff[i] = new_err;
+      ctl->error_buff[i] = new_err;
    }
       
    return;
@@ -64,16 +73,16 @@ void control_alt_init_error_buff(void)
 /*
  * Agrega un elemento nuevo al buffer y elimina el ultimo.
  */
-int control_alt_add_error_buff(error_alt_t new_err)
+int control_alt_add_error_buff(control_alt_t *ctl, error_alt_t new_err)
 {
    int i;
    // Desplazo un lugar todos los elementos
    for(i=0; i < CONTROL_ALT_BUFF_SIZE-1; i++)
    {
-      error_alt_buff[CONTROL_ALT_BUFF_SIZE-1-i] = error_alt_buff[CONTROL_ALT_BUFF_SIZE-2-i];
+      ctl->error_buff[CONTROL_ALT_BUFF_SIZE-1-i] = ctl->error_buff[CONTROL_ALT_BUFF_SIZE-2-i];
    }
    // Agrego elemento nuevo en el primer lugar
-   error_alt_buff[0] = new_err;
+   ctl->error_buff[0] = new_err;
    
    return 0;
 }
@@ -83,7 +92,7 @@ int control_alt_add_error_buff(error_alt_t new_err)
  *
  * Puede hacer promedio (MEAN_ENABLE == 1) o saltear muestras (MEAN_ENABLE == 0)
  */
-double control_alt_derivate_error(void)
+double control_alt_derivate_error(const control_alt_t *ctl)
 {
    double err_mean_sup = 0;
    double err_mean_inf = 0;
@@ -96,8 +105,8 @@ double control_alt_derivate_error(void)
    int i;
    for(i=0; i < CONTROL_ALT_BUFF_SIZE/2; i++)
    {
-	err_mean_sup += error_alt_buff[CONTROL_ALT_BUFF_SIZE-1-i].error;
-	err_mean_inf += error_alt_buff[i].error; 
+	err_mean_sup += ctl->error_buff[CONTROL_ALT_BUFF_SIZE-1-i].error;
+	err_mean_inf += ctl->error_buff[i].error; 
    }
    err_mean_sup = err_mean_sup/(CONTROL_ALT_BUFF_SIZE/2);
    err_mean_inf = err_mean_inf/(CONTROL_ALT_BUFF_SIZE/2);
@@ -105,32 +114,28 @@ double control_alt_derivate_error(void)
    // e_dot = e_mean_inf - e_mean_sup / (n/2)*T
    err_dot = ( err_mean_inf - err_mean_sup )/(mean_time*CONTROL_ALT_BUFF_SIZE/2);
 #else
-   err_dot = ( error_alt_buff[0].error - error_alt_buff[CONTROL_ALT_BUFF_SIZE-1].error )/( mean_time*(CONTROL_ALT_BUFF_SIZE-1) );
+   err_dot = ( ctl->error_buff[0].error - ctl->error_buff[CONTROL_ALT_BUFF_SIZE-1].error )/( mean_time*(CONTROL_ALT_BUFF_SIZE-1) );
 #endif
 
    return err_dot;
 }
 
 
-void control_alt_filter_input(double *u)
+void control_alt_filter_input(control_alt_t *ctl, double *u)
 {
-   //datos anteriores
-   static double y_k_1 = 0,
-		 x_k_1 = 0;
-   
    double x_k = *u; 
 
 #if !CONTROL_ALT_ADD_ZERO
-   //y_{k} = alpha_alt*x_{k} + (1-alpha_alt)*y_{k-1}
-   double y_k = alpha_alt*x_k + (1-alpha_alt)*y_k_1;
+   //y_{k} = alpha*x_{k} + (1-alpha)*y_{k-1}
+   double y_k = ctl->alpha*x_k + (1-ctl->alpha)*ctl->y_k_1;
 #else
-   //y_{k} = x_{k} + a_alt*x_{k} - b_alt*y_{k-1}
-   double y_k = x_k + a_alt*x_k_1 - b_alt*y_k_1;
-   x_k_1 = x_k;
+   //y_{k} = x_{k} + a*x_{k} - b*y_{k-1}
+   double y_k = x_k + ctl->a*ctl->x_k_1 - ctl->b*ctl->y_k_1;
+   ctl->x_k_1 = x_k;
 #endif
 
    *u = y_k;
-   y_k_1 = y_k;
+   ctl->y_k_1 = y_k;
 
    return;
 }
@@ -139,17 +144,17 @@ void control_alt_filter_input(double *u)
 /*
  * 
  */
-double control_alt_calc_input(double alt_d, double alt_measured) 
+double control_alt_calc_input(control_alt_t *ctl, double alt_d, double alt_measured) 
 {
 
-   double u = Kp_alt*(alt_d - alt_measured); 
+   double u = ctl->Kp*(alt_d - alt_measured); 
 
    error_alt_t new_err;
    new_err.error = (alt_d - alt_measured);
-   control_alt_add_error_buff(new_err);
-   u += Kp_alt*Td_alt*control_alt_derivate_error();
+   control_alt_add_error_buff(ctl, new_err);
+   u += ctl->Kp*ctl->Td*control_alt_derivate_error(ctl);
    //Filtro la entrada a la planta para suavizar los picos
-   control_alt_filter_input(&u);
+   control_alt_filter_input(ctl, &u);
 
    return u;
 }
@@ -158,37 +163,33 @@ double control_alt_calc_input(double alt_d, double alt_measured)
 /*
  * 
  */
-double ki = 24.5; //N/m
-double alpha_alt_i = 0.001; //promedio de 200 muestras
-double control_alt_integral(double alt_d, double alt_measured) 
+double control_alt_integral(control_alt_t *ctl, double alt_d, double alt_measured) 
 {
 
-   static double y_k_1 = 0;
    double x_k = alt_d - alt_measured; //senal de error
-   double y_k = alpha_alt_i*x_k + (1-alpha_alt_i)*y_k_1;
+   double y_k = ctl->alpha_i*x_k + (1-ctl->alpha_i)*ctl->yi_k_1;
    if (y_k > 0.1)
 	y_k = 0.1;
    if (y_k < -0.1)
 	y_k = -0.1;
 
-   y_k_1 = y_k;
+   ctl->yi_k_1 = y_k;
 
-   return y_k*ki;
+   return y_k*ctl->ki;
 }
 
 
 
-static double alt_zero = 0;
-void set_alt_zero(double alt_measured)
+void set_alt_zero(control_alt_t *ctl, double alt_measured)
 {
-   alt_zero = alt_measured;
+   ctl->alt_zero = alt_measured;
    return;
 }
 
 
-double get_alt_zero(void)
+double get_alt_zero(const control_alt_t *ctl)
 {
-   return alt_zero;
+   return ctl->alt_zero;
 }
 
 
@@ -43,22 +43,70 @@
 #define LANDING_ALTITUDE		0.20 //20cm
 #define PORCENTAGE_UPDATE_TA		0.05 //5%
 
+// Ganancias por defecto, ver control_alt_init()
+#define CONTROL_ALT_KP			1.85
+#define CONTROL_ALT_TD			2.0
+#define CONTROL_ALT_ALPHA		0.3
+#define CONTROL_ALT_A			0.5
+#define CONTROL_ALT_B			0.5
+#define CONTROL_ALT_KI			24.5 //N/m
+#define CONTROL_ALT_ALPHA_I		0.001 //promedio de 200 muestras
+
 typedef struct error_alt {
 	double error;
 	struct timeval ts;
 } error_alt_t;
 
+/**
+ * Estado de un controlador de altura.
+ *
+ * Como en control_yaw_t, el control no guarda nada fuera de esta
+ * estructura.
+ */
+typedef struct control_alt {
+	// Ganancias
+	double Kp;
+	double Td;
+	double alpha;			// filtro de u sin cero
+	double a;			// filtro de u con cero
+	double b;
+	double ki;			// parte integral
+	double alpha_i;
+
+	/**
+	 * Buffer para almacenar senales de error
+	 *
+	 * Elemento mas nuevo se almacena el lugar correspondiente
+	 *  al indice cero
+	 */
+	error_alt_t error_buff[CONTROL_ALT_BUFF_SIZE];
+
+	// Datos anteriores del filtro de u
+	double y_k_1;
+	double x_k_1;
+
+	double yi_k_1;			// dato anterior de la parte integral
+
+	double alt_zero;
+} control_alt_t;
+
+
+/*
+ * Inicializa el controlador con las ganancias por defecto y el estado en cero
+ */
+void control_alt_init(control_alt_t *ctl);
+
 
 /*
  * Inicializa el buffer
  */
-void control_alt_init_error_buff(void);
+void control_alt_init_error_buff(control_alt_t *ctl);
 
 
 /*
  * Agrega un elemento nuevo al buffer y elimina el ultimo.
  */
-int control_alt_add_error_buff(error_alt_t new_err);
+int control_alt_add_error_buff(control_alt_t *ctl, error_alt_t new_err);
 
 
 /*
@@ -66,7 +114,7 @@ int control_alt_add_error_buff(error_alt_t new_err);
  *
  * Puede hacer promedio opt=1 o saltear muestras opt=0
  */
-double control_alt_derivate_error(void);
+double control_alt_derivate_error(const control_alt_t *ctl);
 
 
 /*
@@ -74,13 +122,13 @@ double control_alt_derivate_error(void);
  *
  * Control PD
  */
-double control_alt_calc_input(double alt_d, double alt_measured);
+double control_alt_calc_input(control_alt_t *ctl, double alt_d, double alt_measured);
 
-double control_alt_integral(double alt_d, double alt_measured); 
+double control_alt_integral(control_alt_t *ctl, double alt_d, double alt_measured); 
 
-void set_alt_zero(double alt_measured);
+void set_alt_zero(control_alt_t *ctl, double alt_measured);
 
-double get_alt_zero(void);
+double get_alt_zero(const control_alt_t *ctl);
 
 int control_altitude_takeoff(double *h_d);
 int control_altitude_land(double *h_d);
@@ -28,25 +28,32 @@
 #include <math.h>
 #include <quadcop_config.h>
 
-double Kp = 2.7;//3.5;//2.7;     
-double Td = 0.4;
-double alpha = 0.25;
-double a = 0.5;
-double b = 0.5;
-
-/**
- * Buffer para almacenar senales de error
- * 
- * Elemento mas nuevo se almacena el lugar correspondiente
- *  al indice cero
+/*
+ * Inicializa el controlador con las ganancias por defecto y el estado en cero
  */
-error_yaw_t error_yaw_buff[CONTROL_YAW_BUFF_SIZE];
+void control_yaw_init(control_yaw_t *ctl)
+{
+   ctl->Kp = CONTROL_YAW_KP;
+   ctl->Td = CONTROL_YAW_TD;
+   ctl->alpha = CONTROL_YAW_ALPHA;
+   ctl->a = CONTROL_YAW_A;
+   ctl->b = CONTROL_YAW_B;
+
+   control_yaw_init_error_buff(ctl);
+   ctl->y_k_1 = 0;
+   ctl->x_k_1 = 0;
+
+   ctl->yaw_zero = 0;
+   ctl->last_yaw_simulated = INITIAL_YAW;
+
+   return;
+}
 
 
 /*
  * Inicializa el buffer
  */
-void control_yaw_init_error_buff(void)
+void control_yaw_init_error_buff(control_yaw_t *ctl)
 {
    error_yaw_t new_err;
    new_err.error = 0;
@@ -54,7 +61,7 @@ void control_yaw_init_error_buff(void)
    // Inicializo en cero
    for(i=0; i < CONTROL_YAW_BUFF_SIZE; i++)
    {
-      error_yaw_buff[i] = new_err;
+      ctl->error_buff[i] = new_err;
    }
       
    return;
@@ -64,16 +71,16 @@ void control_yaw_init_error_buff(void)
 /*
  * Agrega un elemento nuevo al buffer y elimina el ultimo.
  */
-int control_yaw_add_error_buff(error_yaw_t new_err)
+int control_yaw_add_error_buff(control_yaw_t *ctl, error_yaw_t new_err)
 {
    int i;
    // Desplazo un lugar todos los elementos
    for(i=0; i < CONTROL_YAW_BUFF_SIZE-1; i++)
    {
-      error_yaw_buff[CONTROL_YAW_BUFF_SIZE-1-i] = error_yaw_buff[CONTROL_YAW_BUFF_SIZE-2-i];
+      ctl->error_buff[CONTROL_YAW_BUFF_SIZE-1-i] = ctl->error_buff[CONTROL_YAW_BUFF_SIZE-2-i];
    }
    // Agrego elemento nuevo en el primer lugar
-   error_yaw_buff[0] = new_err;
+   ctl->error_buff[0] = new_err;
    
    return 0;
 }
@@ -83,7 +90,7 @@ int control_yaw_add_error_buff(error_yaw_t new_err)
  *
  * Puede hacer promedio (MEAN_ENABLE == 1) o saltear muestras (MEAN_ENABLE == 0)
  */
-double control_yaw_derivate_error(void)
+double control_yaw_derivate_error(const control_yaw_t *ctl)
 {
    double err_mean_sup = 0;
    double err_mean_inf = 0;
@@ -96,8 +103,8 @@ double control_yaw_derivate_error(void)
    int i;
    for(i=0; i < CONTROL_YAW_BUFF_SIZE/2; i++)
    {
-	err_mean_sup += error_yaw_buff[CONTROL_YAW_BUFF_SIZE-1-i].error;
-	err_mean_inf += error_yaw_buff[i].error; 
+	err_mean_sup += ctl->error_buff[CONTROL_YAW_BUFF_SIZE-1-i].error;
+	err_mean_inf += ctl->error_buff[i].error; 
    }
    err_mean_sup = err_mean_sup/(CONTROL_YAW_BUFF_SIZE/2);
    err_mean_inf = err_mean_inf/(CONTROL_YAW_BUFF_SIZE/2);
@@ -105,32 +112,28 @@ double control_yaw_derivate_error(void)
    // e_dot = e_mean_inf - e_mean_sup / (n/2)*T
    err_dot = ( err_mean_inf - err_mean_sup )/(mean_time*CONTROL_YAW_BUFF_SIZE/2);
 #else
-   err_dot = ( error_yaw_buff[0].error - error_yaw_buff[CONTROL_YAW_BUFF_SIZE-1].error )/( mean_time*(CONTROL_YAW_BUFF_SIZE-1) );
+   err_dot = ( ctl->error_buff[0].error - ctl->error_buff[CONTROL_YAW_BUFF_SIZE-1].error )/( mean_time*(CONTROL_YAW_BUFF_SIZE-1) );
 #endif
 
    return err_dot;
 }
 
 
-void control_yaw_filter_input(double *u)
+void control_yaw_filter_input(control_yaw_t *ctl, double *u)
 {
-   //datos anteriores
-   static double y_k_1 = 0,
-		 x_k_1 = 0;
-   
    double x_k = *u; 
 
 #if !CONTROL_YAW_ADD_ZERO
    //y_{k} = alpha*x_{k} + (1-alpha)*y_{k-1}
-   double y_k = alpha*x_k + (1-alpha)*y_k_1;
+   double y_k = ctl->alpha*x_k + (1-ctl->alpha)*ctl->y_k_1;
 #else
    //y_{k} = x_{k} + a*x_{k} - b*y_{k-1}
-   double y_k = x_k + a*x_k_1 - b*y_k_1;
-   x_k_1 = x_k;
+   double y_k = x_k + ctl->a*ctl->x_k_1 - ctl->b*ctl->y_k_1;
+   ctl->x_k_1 = x_k;
 #endif
 
    *u = y_k;
-   y_k_1 = y_k;
+   ctl->y_k_1 = y_k;
 
    return;
 }
@@ -140,13 +143,13 @@ void control_yaw_filter_input(double *u)
 /*
  * Agrega un elemento nuevo al buffer y elimina el ultimo.
  */
-int control_yaw_print_error_buff(void)
+int control_yaw_print_error_buff(const control_yaw_t *ctl)
 {
    int i;
   
    for(i=0; i < CONTROL_YAW_BUFF_SIZE; i++)
    {
-      printf("%lf  ",error_yaw_buff[i].error);
+      printf("%lf  ",ctl->error_buff[i].error);
    }
    
    //printf("\n");
@@ -159,24 +162,24 @@ int control_yaw_print_error_buff(void)
 /*
  * Los parametros de entrada son en radianes pero el control es en grados
  */
-double control_yaw_calc_input(double yaw_d, double yaw_measured) 
+double control_yaw_calc_input(control_yaw_t *ctl, double yaw_d, double yaw_measured) 
 {
-   double u = 180/M_PI*Kp*(yaw_d - yaw_measured); //El control se hace en grados y los datos enstan en radianes
+   double u = 180/M_PI*ctl->Kp*(yaw_d - yaw_measured); //El control se hace en grados y los datos enstan en radianes
 
 #if CONTROL_YAW_ADD_DERIVATIVE
    error_yaw_t new_err;
    new_err.error = 180/M_PI*(yaw_d - yaw_measured);
-   control_yaw_add_error_buff(new_err);
+   control_yaw_add_error_buff(ctl, new_err);
 
-   //printf("%lf\n",control_yaw_derivate_error());   //dbg
+   //printf("%lf\n",control_yaw_derivate_error(ctl));   //dbg
 
-   u += Kp*Td*control_yaw_derivate_error();
+   u += ctl->Kp*ctl->Td*control_yaw_derivate_error(ctl);
    printf("%lf  ",u);
    //Filtro la entrada a la planta para suavizar los picos
-   control_yaw_filter_input(&u);
+   control_yaw_filter_input(ctl, &u);
 #endif
 
-   //control_yaw_print_error_buff(); //dbg
+   //control_yaw_print_error_buff(ctl); //dbg
    //printf("%lf",u);
 
    return u;
@@ -189,29 +192,26 @@ double control_yaw_calc_input(double yaw_d, double yaw_measured)
  *
  * devuelve yaw simulado
  */
-double simulate_yaw(double yaw_d)
+double simulate_yaw(control_yaw_t *ctl, double yaw_d)
 {
-   static double last_yaw_simulated = INITIAL_YAW;
-
-   double yaw_simulated = last_yaw_simulated + PORCENTAGE_UPDATE_YAW*(yaw_d - last_yaw_simulated);
-   last_yaw_simulated = yaw_simulated;
+   double yaw_simulated = ctl->last_yaw_simulated + PORCENTAGE_UPDATE_YAW*(yaw_d - ctl->last_yaw_simulated);
+   ctl->last_yaw_simulated = yaw_simulated;
 
    return yaw_simulated;
 }
 #endif
 
 
-static double yaw_zero = 0;
-void set_yaw_zero(double yaw_measured)
+void set_yaw_zero(control_yaw_t *ctl, double yaw_measured)
 {
-   yaw_zero = yaw_measured;
+   ctl->yaw_zero = yaw_measured;
    return;
 }
 
 
-double get_yaw_zero(void)
+double get_yaw_zero(const control_yaw_t *ctl)
 {
-   return yaw_zero;
+   return ctl->yaw_zero;
 }
 
 
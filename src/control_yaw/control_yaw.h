@@ -42,22 +42,66 @@
 #define CONTROL_YAW_MEAN_ENABLE		0 // Realiza promedio antes de derivar. Ver control_yaw_derivate_error()
 #define CONTROL_YAW_ADD_ZERO		0 // Agrega un cero al filtro de u. Ver control_yaw_filter_input() TODO ES COMPATIBLE CON DERIVAR EL ERROR??
 
+// Ganancias por defecto, ver control_yaw_init()
+#define CONTROL_YAW_KP			2.7//3.5//2.7
+#define CONTROL_YAW_TD			0.4
+#define CONTROL_YAW_ALPHA		0.25
+#define CONTROL_YAW_A			0.5
+#define CONTROL_YAW_B			0.5
+
 typedef struct error_yaw {
 	double error;
 	struct timeval ts;
 } error_yaw_t;
 
+/**
+ * Estado de un controlador de yaw.
+ *
+ * Todo lo que el control recuerda entre llamadas esta aca, por lo que se
+ * pueden tener varios controladores independientes (p.ej. simulaciones en
+ * paralelo con distintas ganancias).
+ */
+typedef struct control_yaw {
+	// Ganancias
+	double Kp;
+	double Td;
+	double alpha;			// filtro de u sin cero
+	double a;			// filtro de u con cero
+	double b;
+
+	/**
+	 * Buffer para almacenar senales de error
+	 *
+	 * Elemento mas nuevo se almacena el lugar correspondiente
+	 *  al indice cero
+	 */
+	error_yaw_t error_buff[CONTROL_YAW_BUFF_SIZE];
+
+	// Datos anteriores del filtro de u
+	double y_k_1;
+	double x_k_1;
+
+	double yaw_zero;		// yaw medido al armar
+	double last_yaw_simulated;	// ver simulate_yaw()
+} control_yaw_t;
+
+
+/*
+ * Inicializa el controlador con las ganancias por defecto y el estado en cero
+ */
+void control_yaw_init(control_yaw_t *ctl);
+
 
 /*
  * Inicializa el buffer
  */
-void control_yaw_init_error_buff(void);
+void control_yaw_init_error_buff(control_yaw_t *ctl);
 
 
 /*
  * Agrega un elemento nuevo al buffer y elimina el ultimo.
  */
-int control_yaw_add_error_buff(error_yaw_t new_err);
+int control_yaw_add_error_buff(control_yaw_t *ctl, error_yaw_t new_err);
 
 
 /*
@@ -65,7 +109,7 @@ int control_yaw_add_error_buff(error_yaw_t new_err);
  *
  * Puede hacer promedio opt=1 o saltear muestras opt=0
  */
-double control_yaw_derivate_error(void);
+double control_yaw_derivate_error(const control_yaw_t *ctl);
 
 
 /*
@@ -73,13 +117,13 @@ double control_yaw_derivate_error(void);
  *
  * Control proporcional o PD segun definido por usuario
  */
-double control_yaw_calc_input(double yaw_d, double yaw_measured);
+double control_yaw_calc_input(control_yaw_t *ctl, double yaw_d, double yaw_measured);
 
-double simulate_yaw(double yaw_d);
+double simulate_yaw(control_yaw_t *ctl, double yaw_d);
 
-void set_yaw_zero(double yaw_measured);
+void set_yaw_zero(control_yaw_t *ctl, double yaw_measured);
 
-double get_yaw_zero(void);
+double get_yaw_zero(const control_yaw_t *ctl);
 
 #endif // CONTROL_YAW_H
 
@@ -0,0 +1,299 @@
+/**
+ ******************************************************************************
+ *
+ * @file       flight_log.c
+ * @author     Federico Favaro, Joaquin Berrutti y Lucas Falkenstein
+ * @brief      Registro binario de vuelo en un archivo circular preasignado.
+ *
+ *****************************************************************************/
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <http://www.gnu.org/licenses/> or write to the
+ * Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "flight_log.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+
+/**
+ * Escribe en el archivo los registros [from, to) de la cola. Cada tramo
+ * contiguo en el archivo se manda con un unico pwritev(); como mucho hay
+ * dos iovec por tramo, por la vuelta de la cola.
+ */
+static int flight_log_write_range(flight_log_t *log, uint64_t from, uint64_t to)
+{
+    struct iovec iov[2];
+    uint64_t n, run, cap = log->hdr.capacity;
+    uint64_t slot_f, slot_q, first_q;
+    off_t offset;
+    ssize_t len, retval;
+    int iovcnt;
+
+    for(n = from; n < to; n += run)
+    {
+	// Tramo que no pasa el fin del anillo del archivo
+	slot_f = n % cap;
+	run = to - n;
+	if(run > cap - slot_f)
+	    run = cap - slot_f;
+
+	slot_q = n & FLIGHT_LOG_QUEUE_MASK;
+	first_q = FLIGHT_LOG_QUEUE_LEN - slot_q;
+	iov[0].iov_base = &log->queue[slot_q];
+	if(run <= first_q)
+	{
+	    iov[0].iov_len = run*sizeof(flight_rec_t);
+	    iovcnt = 1;
+	}
+	else
+	{
+	    iov[0].iov_len = first_q*sizeof(flight_rec_t);
+	    iov[1].iov_base = &log->queue[0];
+	    iov[1].iov_len = (run - first_q)*sizeof(flight_rec_t);
+	    iovcnt = 2;
+	}
+
+	offset = FLIGHT_LOG_HDR_SIZE + (off_t)(slot_f*sizeof(flight_rec_t));
+	len = (ssize_t)(run*sizeof(flight_rec_t));
+	retval = pwritev(log->fd, iov, iovcnt, offset);
+	if(retval != len)
+	{
+	    err_log_stderr("pwritev()");
+	    return ERROR_WRITE;
+	}
+    }
+
+    return ERROR_OK;
+}
+
+/**
+ * Vacia la cola y actualiza el encabezado.
+ */
+static int flight_log_flush(flight_log_t *log)
+{
+    uint64_t tail = log->tail;
+    uint64_t head = __atomic_load_n(&log->head, __ATOMIC_ACQUIRE);
+    int retval;
+
+    if(head == tail)
+	return ERROR_OK;
+
+    retval = flight_log_write_range(log, tail, head);
+    // Aun si fallo se liberan los lugares, para no frenar al main
+    __atomic_store_n(&log->tail, head, __ATOMIC_RELEASE);
+    err_propagate(retval);
+
+    __atomic_store_n(&log->hdr.head, head, __ATOMIC_RELAXED);
+    if(pwrite(log->fd, &log->hdr, sizeof(flight_log_hdr_t), 0) != sizeof(flight_log_hdr_t))
+    {
+	err_log_stderr("pwrite()");
+	return ERROR_WRITE;
+    }
+
+    return ERROR_OK;
+}
+
+static void *flight_log_writer(void *arg)
+{
+    flight_log_t *log = (flight_log_t *)arg;
+    struct timespec period = {0, FLIGHT_LOG_WRITER_MS*1000000L};
+    int ms_since_sync = 0;
+
+    // Baja prioridad: el control siempre le gana al log
+    if(setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), FLIGHT_LOG_WRITER_NICE) < 0)
+    {
+	err_log_stderr("setpriority()");
+    }
+
+    while(!__atomic_load_n(&log->stop, __ATOMIC_ACQUIRE))
+    {
+	nanosleep(&period, NULL);
+	if(flight_log_flush(log) != ERROR_OK)
+	    continue;
+
+	ms_since_sync += FLIGHT_LOG_WRITER_MS;
+	if(ms_since_sync >= FLIGHT_LOG_SYNC_MS)
+	{
+	    if(fdatasync(log->fd) < 0)
+	    {
+		err_log_stderr("fdatasync()");
+	    }
+	    ms_since_sync = 0;
+	}
+    }
+
+    return NULL;
+}
+
+flight_log_t *flight_log_open(const char *path, uint64_t capacity)
+{
+    int retval;
+    flight_log_t *log;
+
+    if(path == NULL || capacity == 0)
+    {
+	err_log("Invalid argument!");
+	return NULL;
+    }
+
+    log = (flight_log_t *)malloc(sizeof(flight_log_t));
+    if(log == NULL)
+    {
+	err_log_stderr("malloc()");
+	return NULL;
+    }
+    memset(log, 0, sizeof(flight_log_t));
+
+    log->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if(log->fd < 0)
+    {
+	err_log_stderr("open()");
+	free(log);
+	return NULL;
+    }
+
+    // Reserva los bloques ahora para no quedarse sin lugar durante el vuelo
+    retval = posix_fallocate(log->fd, 0, (off_t)(FLIGHT_LOG_HDR_SIZE + capacity*sizeof(flight_rec_t)));
+    if(retval != 0)
+    {
+	err_log_num("posix_fallocate() failed!", retval);
+	close(log->fd);
+	free(log);
+	return NULL;
+    }
+
+    memcpy(log->hdr.magic, FLIGHT_LOG_MAGIC, sizeof(FLIGHT_LOG_MAGIC));
+    log->hdr.version  = FLIGHT_LOG_VERSION;
+    log->hdr.rec_size = sizeof(flight_rec_t);
+    log->hdr.capacity = capacity;
+    log->hdr.head     = 0;
+    if(pwrite(log->fd, &log->hdr, sizeof(flight_log_hdr_t), 0) != sizeof(flight_log_hdr_t))
+    {
+	err_log_stderr("pwrite()");
+	close(log->fd);
+	free(log);
+	return NULL;
+    }
+
+    retval = pthread_create(&log->writer, NULL, flight_log_writer, log);
+    if(retval != 0)
+    {
+	err_log_num("pthread_create() failed!", retval);
+	close(log->fd);
+	free(log);
+	return NULL;
+    }
+
+    return log;
+}
+
+int flight_log_push(flight_log_t *log, flight_rec_t *rec)
+{
+    uint64_t head = log->head;
+    uint64_t used = head - __atomic_load_n(&log->tail, __ATOMIC_ACQUIRE);
+
+    if(used >= FLIGHT_LOG_QUEUE_LEN)
+    {
+	log->dropped++;
+	return ERROR_FAIL;
+    }
+    if(used + 1 > log->high_water)
+	log->high_water = used + 1;
+
+    rec->seq = head;
+    log->queue[head & FLIGHT_LOG_QUEUE_MASK] = *rec;
+    // El registro queda completo antes de que el thread lo vea
+    __atomic_store_n(&log->head, head + 1, __ATOMIC_RELEASE);
+
+    return ERROR_OK;
+}
+
+void flight_log_get_stats(flight_log_t *log, flight_log_stats_t *stats)
+{
+    stats->written    = (unsigned long)__atomic_load_n(&log->hdr.head, __ATOMIC_RELAXED);
+    stats->dropped    = log->dropped;
+    stats->high_water = log->high_water;
+}
+
+int flight_log_close(flight_log_t *log, flight_log_stats_t *stats)
+{
+    int retval = ERROR_OK;
+
+    if(log == NULL)
+	return ERROR_OK;
+
+    __atomic_store_n(&log->stop, true, __ATOMIC_RELEASE);
+    pthread_join(log->writer, NULL);
+
+    // Lo que quedo en la cola
+    if(flight_log_flush(log) != ERROR_OK)
+	retval = ERROR_WRITE;
+    if(stats != NULL)
+	flight_log_get_stats(log, stats);
+    if(fdatasync(log->fd) < 0)
+    {
+	err_log_stderr("fdatasync()");
+	retval = ERROR_IO;
+    }
+    if(close(log->fd) < 0)
+    {
+	err_log_stderr("close()");
+	retval = ERROR_IO;
+    }
+    free(log);
+
+    return retval;
+}
+
+int flight_log_rec_to_str(char *buf_str, const flight_rec_t *rec)
+{
+    char* buf_ptr = buf_str;
+
+    // Actitud, igual que uavtalk_to_str()
+    buf_ptr += sprintf(buf_ptr, "%04lu %06lu", (unsigned long)rec->act_sec, (unsigned long)rec->act_usec);
+    buf_ptr += sprintf(buf_ptr, " %lf", rec->roll);
+    buf_ptr += sprintf(buf_ptr, " %lf", rec->pitch);
+    buf_ptr += sprintf(buf_ptr, " %lf ", rec->yaw);
+
+    // Canales, timestamp del main y control
+    buf_ptr += sprintf(buf_ptr, "%u %u %u %u %lu %lu %lf %lf %lf %lf %lf %lf %lf",
+		       rec->ch_roll,
+		       rec->ch_pitch,
+		       rec->ch_yaw,
+		       rec->ch_throttle,
+		       (unsigned long)rec->main_sec,
+		       (unsigned long)rec->main_usec,
+		       rec->pos_x,
+		       rec->pos_y,
+		       rec->pos_z,
+		       rec->yaw_d,
+		       rec->u_yaw,
+		       rec->h_d,
+		       rec->U_h);
+
+    // IMU, igual que imu_to_str()
+    buf_ptr += sprintf(buf_ptr, " %04lu %06lu", (unsigned long)rec->imu_sec, (unsigned long)rec->imu_usec);
+    buf_ptr += sprintf(buf_ptr, " %lf", rec->alt);
+    buf_ptr += sprintf(buf_ptr, " %lf", rec->us_obstacle);
+    buf_ptr += sprintf(buf_ptr, " %lf\n", rec->us_altitude);
+
+    return (buf_ptr - buf_str); //char_count
+}
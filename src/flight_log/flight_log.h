@@ -0,0 +1,187 @@
+/**
+ ******************************************************************************
+ *
+ * @file       flight_log.h
+ * @author     Federico Favaro, Joaquin Berrutti y Lucas Falkenstein
+ * @brief      Registro binario de vuelo en un archivo circular preasignado.
+ *
+ * Cada periodo de control el main encola un registro de tamano fijo en una
+ * cola SPSC sin locks. Un thread de baja prioridad vacia la cola cada
+ * FLIGHT_LOG_WRITER_MS con pwritev() y cada FLIGHT_LOG_SYNC_MS hace
+ * fdatasync(), de forma que la latencia de la tarjeta SD nunca frena al
+ * bucle de control. Si la cola se llena el registro se descarta y se cuenta.
+ *
+ * El archivo se reserva completo al abrirlo. Si el vuelo dura mas que
+ * FLIGHT_LOG_RECORDS periodos se sobreescriben los registros mas viejos.
+ *
+ * Para obtener el log de texto de siempre (mismas columnas que antes) usar
+ * el conversor flight_log2txt.
+ *
+ * Examples:
+ *   - src/main/main.c
+ *   - src/flight_log/flight_log2txt.c
+ *
+ *****************************************************************************/
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <http://www.gnu.org/licenses/> or write to the
+ * Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+#ifndef FLIGHT_LOG_H
+#define FLIGHT_LOG_H
+
+#include <uquad_error_codes.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define FLIGHT_LOG_MAGIC	"UQFLOG1"
+#define FLIGHT_LOG_VERSION	1
+#define FLIGHT_LOG_HDR_SIZE	64	// los registros empiezan en este offset
+#define FLIGHT_LOG_RECORDS	72000	// 1 hora a 50 ms por registro (~10 MB)
+#define FLIGHT_LOG_STR_LEN	512	// alcanza para un registro en texto
+
+#define FLIGHT_LOG_QUEUE_LEN	256	// registros en la cola (potencia de 2, ~12 s)
+#define FLIGHT_LOG_QUEUE_MASK	(FLIGHT_LOG_QUEUE_LEN - 1)
+#define FLIGHT_LOG_WRITER_MS	250	// periodo del thread que escribe
+#define FLIGHT_LOG_SYNC_MS	1000	// periodo de fdatasync()
+#define FLIGHT_LOG_WRITER_NICE	10	// prioridad del thread que escribe
+
+/**
+ * Registro de un periodo de control. Los campos tienen ancho fijo y estan
+ * ordenados de mayor a menor tamano para que no haya padding: el archivo se
+ * puede leer en cualquier maquina little endian.
+ */
+typedef struct flight_rec {
+    uint64_t seq;		// numero de registro desde el comienzo del vuelo
+    // Actitud de la CC3D [rad]
+    double roll;
+    double pitch;
+    double yaw;
+    // Posicion y control
+    double pos_x;
+    double pos_y;
+    double pos_z;
+    double yaw_d;
+    double u_yaw;
+    double h_d;
+    double U_h;
+    // IMU
+    double alt;
+    double us_obstacle;
+    double us_altitude;
+    // Timestamps
+    uint32_t act_sec;		// actitud
+    uint32_t act_usec;
+    uint32_t main_sec;		// entrada al loop, relativo al comienzo
+    uint32_t main_usec;
+    uint32_t imu_sec;		// IMU
+    uint32_t imu_usec;
+    // Canales enviados a sbusd
+    uint16_t ch_roll;
+    uint16_t ch_pitch;
+    uint16_t ch_yaw;
+    uint16_t ch_throttle;
+} flight_rec_t;
+
+/**
+ * Encabezado del archivo. head es la cantidad de registros escritos; el
+ * registro n esta en el lugar n % capacity.
+ */
+typedef struct flight_log_hdr {
+    char magic[8];
+    uint32_t version;
+    uint32_t rec_size;
+    uint64_t capacity;
+    uint64_t head;
+} flight_log_hdr_t;
+
+typedef struct flight_log_stats {
+    unsigned long written;	// registros escritos en el archivo
+    unsigned long dropped;	// registros descartados por cola llena
+    unsigned long high_water;	// maxima ocupacion de la cola
+} flight_log_stats_t;
+
+typedef struct flight_log {
+    int fd;
+    flight_log_hdr_t hdr;	// copia del encabezado, la escribe el thread
+    // Cola SPSC: el main escribe head, el thread escribe tail
+    flight_rec_t queue[FLIGHT_LOG_QUEUE_LEN];
+    uint64_t head;
+    uint64_t tail;
+    unsigned long dropped;
+    unsigned long high_water;
+    // Thread que escribe
+    pthread_t writer;
+    bool stop;
+} flight_log_t;
+
+/**
+ * Crea el archivo (lo trunca si existia), reserva en disco lugar para
+ * capacity registros y lanza el thread que escribe.
+ *
+ * @param path
+ * @param capacity cantidad de registros del anillo
+ *
+ * @return puntero al log, NULL si falla
+ */
+flight_log_t *flight_log_open(const char *path, uint64_t capacity);
+
+/**
+ * Encola un registro (solo el main). No hace syscalls ni bloquea; si la
+ * cola esta llena el registro se descarta. El campo seq lo completa
+ * esta funcion.
+ *
+ * @param log
+ * @param rec
+ *
+ * @return ERROR_OK, o ERROR_FAIL si se descarto el registro
+ */
+int flight_log_push(flight_log_t *log, flight_rec_t *rec);
+
+/**
+ * Devuelve las estadisticas de la cola y del archivo.
+ *
+ * @param log
+ * @param stats
+ */
+void flight_log_get_stats(flight_log_t *log, flight_log_stats_t *stats);
+
+/**
+ * Detiene el thread, escribe lo que quede en la cola, baja a disco el
+ * contenido y cierra el archivo.
+ *
+ * @param log
+ * @param stats si no es NULL, estadisticas finales del log
+ *
+ * @return error code
+ */
+int flight_log_close(flight_log_t *log, flight_log_stats_t *stats);
+
+/**
+ * Convierte un registro a una linea de texto con las columnas del log
+ * original:
+ *
+ * T_s_act T_us_act roll pitch yaw C_roll C_pitch C_yaw C_throt T_s_main
+ * T_us_main pos.x pos.y pos.z yaw_d u_yaw h_d U_h T_s_imu T_us_imu alt
+ * us_obstacle us_altitude
+ *
+ * @param buf_str buffer de al menos FLIGHT_LOG_STR_LEN bytes
+ * @param rec
+ *
+ * @return cantidad de caracteres escritos
+ */
+int flight_log_rec_to_str(char *buf_str, const flight_rec_t *rec);
+
+#endif //FLIGHT_LOG_H
@@ -0,0 +1,121 @@
+/**
+ ******************************************************************************
+ *
+ * @file       flight_log2txt.c
+ * @author     Federico Favaro, Joaquin Berrutti y Lucas Falkenstein
+ * @brief      Convierte un registro binario de vuelo al log de texto que
+ *             usan los scripts de Matlab.
+ *
+ * Uso: ./flight_log2txt <log binario> [log de texto]
+ * Si no se indica el archivo de salida se escribe en stdout.
+ *
+ *****************************************************************************/
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <http://www.gnu.org/licenses/> or write to the
+ * Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include <flight_log.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#define HOW_TO	"./flight_log2txt <log binario> [log de texto]"
+
+int main(int argc, char *argv[])
+{
+    FILE *in, *out = stdout;
+    flight_log_hdr_t hdr;
+    flight_rec_t rec;
+    char buff[FLIGHT_LOG_STR_LEN];
+    uint64_t first, n;
+    long offset;
+    int len;
+
+    if(argc < 2)
+    {
+	err_log(HOW_TO);
+	return -1;
+    }
+
+    in = fopen(argv[1], "rb");
+    if(in == NULL)
+    {
+	err_log_stderr("fopen()");
+	return -1;
+    }
+
+    if(fread(&hdr, sizeof(hdr), 1, in) != 1 ||
+       memcmp(hdr.magic, FLIGHT_LOG_MAGIC, sizeof(FLIGHT_LOG_MAGIC)) != 0)
+    {
+	err_log("Not a flight log!");
+	fclose(in);
+	return -1;
+    }
+    if(hdr.version != FLIGHT_LOG_VERSION || hdr.rec_size != sizeof(flight_rec_t))
+    {
+	err_log_num("Unsupported flight log version:", (int)hdr.version);
+	fclose(in);
+	return -1;
+    }
+    // El escritor reserva el archivo entero al abrirlo: uno mas corto o sin
+    // capacidad esta corrupto, y n % capacity no tendria sentido
+    if(hdr.capacity == 0 ||
+       hdr.capacity > (uint64_t)(LONG_MAX - FLIGHT_LOG_HDR_SIZE)/sizeof(flight_rec_t))
+    {
+	err_log("Invalid flight log capacity!");
+	fclose(in);
+	return -1;
+    }
+    if(fseek(in, 0, SEEK_END) != 0 ||
+       ftell(in) < FLIGHT_LOG_HDR_SIZE + (long)(hdr.capacity*sizeof(flight_rec_t)))
+    {
+	err_log("Truncated flight log!");
+	fclose(in);
+	return -1;
+    }
+
+    if(argc > 2)
+    {
+	out = fopen(argv[2], "w");
+	if(out == NULL)
+	{
+	    err_log_stderr("fopen()");
+	    fclose(in);
+	    return -1;
+	}
+    }
+
+    // Si el anillo dio la vuelta el registro mas viejo es head - capacity
+    first = (hdr.head > hdr.capacity) ? hdr.head - hdr.capacity : 0;
+    for(n = first; n < hdr.head; ++n)
+    {
+	offset = FLIGHT_LOG_HDR_SIZE + (long)((n % hdr.capacity)*sizeof(flight_rec_t));
+	if(fseek(in, offset, SEEK_SET) != 0 ||
+	   fread(&rec, sizeof(rec), 1, in) != 1)
+	{
+	    err_log("Truncated flight log!");
+	    break;
+	}
+	len = flight_log_rec_to_str(buff, &rec);
+	fwrite(buff, 1, len, out);
+    }
+
+    fclose(in);
+    if(out != stdout)
+	fclose(out);
+
+    return 0;
+}
@@ -36,6 +36,18 @@ uint8_t sbusData[25] 	= {0x0f,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
 int16_t channels[18]   	= {0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0};
 uint8_t failsafe_status = SBUS_SIGNAL_OK;
 
+/* Canales modificados desde la ultima llamada a futaba_sbus_update_msg().
+ * Arranca con todos en 1 para que el primer mensaje se genere completo. */
+static uint16_t channels_dirty = 0xFFFF;
+
+/* Cada canal ocupa 11 bits a partir del bit 11*ch del payload (byte 1),
+ * por lo que siempre cae dentro de 3 bytes consecutivos. */
+static const uint8_t sbus_ch_byte[16]  = { 1, 2, 3, 5, 6, 7, 9,10,12,13,14,16,17,18,20,21};
+static const uint8_t sbus_ch_shift[16] = { 0, 3, 6, 1, 4, 7, 2, 5, 0, 3, 6, 1, 4, 7, 2, 5};
+
+/* Flags del byte 23 segun failsafe_status (SBUS_SIGNAL_OK, LOST, -, FAILSAFE) */
+static const uint8_t sbus_fs_flags[4] = { 0x00, (1<<2), 0x00, (1<<2)|(1<<3) };
+
 
 /** 
  * Esto se tiene que ir...no hace nada
@@ -70,7 +82,11 @@ void futaba_sbus_set_channel(uint8_t channel, int16_t value)
           }
       }
 
-      channels[channel-1] = value;
+      if (channels[channel-1] != value)
+      {
+         channels[channel-1] = value;
+         channels_dirty |= (uint16_t)(1 << (channel-1));
+      }
    }
 }
 
@@ -80,6 +96,7 @@ void futaba_sbus_reset_channels()
    int i;
    for (i=0; i<16; i++)
       channels[i] = 0;
+   channels_dirty = 0xFFFF;
 }
 
 
@@ -95,23 +112,56 @@ void futaba_sbus_set_failsafe(uint8_t fs)
 }
 
 
+/* Escribe los 11 bits del canal ch en el mensaje, sin tocar los bits
+ * de los canales vecinos que comparten los bytes de los extremos. */
+static inline void futaba_sbus_pack_channel(uint8_t ch)
+{
+   uint8_t *p     = &sbusData[sbus_ch_byte[ch]];
+   uint32_t mask  = 0x7FFUL << sbus_ch_shift[ch];
+   uint32_t value = ((uint32_t)channels[ch] << sbus_ch_shift[ch]) & mask;
+
+   p[0] = (uint8_t)((p[0] & ~mask) | value);
+   p[1] = (uint8_t)((p[1] & ~(mask >> 8)) | (value >> 8));
+   p[2] = (uint8_t)((p[2] & ~(mask >> 16)) | (value >> 16));
+}
+
+
 void futaba_sbus_update_msg(void)
 {
-   // Limpia mensaje anterior
-   futaba_sbus_reset_msg();
+   uint16_t dirty = channels_dirty;
+   uint8_t ch;
+
+   // Solo se recodifican los canales que cambiaron
+   for (ch=0; dirty != 0; ch++, dirty >>= 1)
+      if (dirty & 1)
+         futaba_sbus_pack_channel(ch);
+   channels_dirty = 0;
+
+   // Failsafe. Los canales digitales 17 y 18 (bits 0 y 1) no se usan.
+   sbusData[23] = sbus_fs_flags[failsafe_status & 0x03];
+}
+
 
+/* Codificador original, bit a bit. Se usa solo para verificar
+ * futaba_sbus_update_msg(). */
+void futaba_sbus_encode_bitwise(uint8_t *buff)
+{
    uint8_t ch = 0;
    uint8_t bit_in_servo = 0;
    uint8_t byte_in_sbus = 1;
    uint8_t bit_in_sbus = 0;
+   int i;
+
+   buff[0] = 0x0f;
+   for (i=1; i<SBUS_DATA_LENGTH; i++)
+      buff[i] = 0;
 
    // Convierte info de canales en mensaje sbus
-   int i;
    for (i=0; i<176; i++)
    {
       if (channels[ch] & (1<<bit_in_servo))
-         sbusData[byte_in_sbus] |= (1<<bit_in_sbus);
-     
+         buff[byte_in_sbus] |= (1<<bit_in_sbus);
+
       bit_in_sbus++;
       bit_in_servo++;
 
@@ -129,13 +179,40 @@ void futaba_sbus_update_msg(void)
 
    // Failsafe
    if (failsafe_status == SBUS_SIGNAL_LOST)
-      sbusData[23] |= (1<<2);
+      buff[23] |= (1<<2);
    if (failsafe_status == SBUS_SIGNAL_FAILSAFE)
    {
-      sbusData[23] |= (1<<2);
-      sbusData[23] |= (1<<3);
+      buff[23] |= (1<<2);
+      buff[23] |= (1<<3);
+   }
+}
+
+
+const uint8_t *futaba_sbus_get_msg(void)
+{
+   return sbusData;
+}
+
+
+#if DEBUG_SBUS_ENCODER
+int futaba_sbus_check_msg(void)
+{
+   uint8_t ref[SBUS_DATA_LENGTH];
+   int i;
+
+   futaba_sbus_encode_bitwise(ref);
+   for (i=0; i<SBUS_DATA_LENGTH; i++)
+   {
+      if (sbusData[i] != ref[i])
+      {
+         err_log_num("sbus encoder mismatch at byte:", i);
+         return -1;
+      }
    }
+
+   return 0;
 }
+#endif //DEBUG_SBUS_ENCODER
 
 
 void futaba_sbus_reset_msg(void)
@@ -143,6 +220,8 @@ void futaba_sbus_reset_msg(void)
    int i;
    for (i=1; i<24; i++)
       sbusData[i] = 0;
+   // El proximo update tiene que volver a escribir todos los canales
+   channels_dirty = 0xFFFF;
 }
 
 
@@ -139,10 +139,37 @@ void futaba_sbus_set_failsafe(uint8_t fs);
 
 /**
  * Genera el mensaje sbus con la informacion de los canales.
+ * Solo se recodifican los canales modificados con futaba_sbus_set_channel()
+ * desde la llamada anterior; el byte de flags se escribe siempre.
  *
  */ 
 void futaba_sbus_update_msg(void);
 
+/**
+ * Codificador original, bit a bit, a partir de la informacion de los canales.
+ * Es la referencia para verificar futaba_sbus_update_msg(), ver
+ * futaba_sbus_bench.
+ *
+ * @param buff mensaje de SBUS_DATA_LENGTH bytes
+ */
+void futaba_sbus_encode_bitwise(uint8_t *buff);
+
+/**
+ * Devuelve el mensaje sbus generado por futaba_sbus_update_msg().
+ *
+ * @return mensaje de SBUS_DATA_LENGTH bytes
+ */
+const uint8_t *futaba_sbus_get_msg(void);
+
+#if DEBUG_SBUS_ENCODER
+/**
+ * Compara el mensaje actual con el generado por el codificador bit a bit.
+ *
+ * @return 0 si coinciden, -1 si no
+ */
+int futaba_sbus_check_msg(void);
+#endif //DEBUG_SBUS_ENCODER
+
 /**
  * Reinicia (lleva a cero) la informacion del mensaje sbus.
  *
@@ -0,0 +1,141 @@
+/**
+ ******************************************************************************
+ *
+ * @file       futaba_sbus_bench.c
+ * @author     Federico Favaro, Joaquin Berrutti y Lucas Falkenstein
+ * @brief      Compara el codificador sbus por tablas con el codificador
+ *             original bit a bit, byte a byte y en tiempo de ejecucion.
+ *
+ * Uso: ./futaba_sbus_bench [iteraciones]
+ * Devuelve 0 si todos los mensajes coinciden, -1 si no.
+ *
+ *****************************************************************************/
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <http://www.gnu.org/licenses/> or write to the
+ * Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include <futaba_sbus.h>
+#include <uquad_aux_time.h>
+#include <uquad_error_codes.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define HOW_TO			"./futaba_sbus_bench [iteraciones]"
+#define BENCH_ITER_DEFAULT	1000000
+#define BENCH_SEED		1234
+#define BENCH_SECUENCIA		4096	// mensajes distintos, se repiten en ciclo
+
+// Estados de failsafe posibles, ver futaba_sbus_set_failsafe()
+static const uint8_t bench_fs[3] = { SBUS_SIGNAL_OK, SBUS_SIGNAL_LOST, SBUS_SIGNAL_FAILSAFE };
+
+// Cambios de canales entre dos mensajes, generados antes de medir para
+// que rand_r() no entre en los tiempos
+typedef struct bench_msg {
+    int n;			// canales modificados
+    uint8_t canal[16];
+    int16_t valor[16];
+    uint8_t fs;
+} bench_msg_t;
+
+static bench_msg_t bench_seq[BENCH_SECUENCIA];
+
+/* Entre 1 y 16 canales al azar por mensaje, como hace el main entre dos
+ * mensajes (en vuelo cambian 4 o 5 canales por periodo). */
+static void bench_generar(void)
+{
+    unsigned int seed = BENCH_SEED;
+    int i, j;
+
+    for(i = 0; i < BENCH_SECUENCIA; i++)
+    {
+	bench_seq[i].n = 1 + rand_r(&seed) % 16;
+	for(j = 0; j < bench_seq[i].n; j++)
+	{
+	    bench_seq[i].canal[j] = 1 + rand_r(&seed) % 16;
+	    bench_seq[i].valor[j] = MIN_THROTTLE + rand_r(&seed) % (MAX_COMMAND - MIN_THROTTLE + 1);
+	}
+	bench_seq[i].fs = bench_fs[rand_r(&seed) % 3];
+    }
+}
+
+static inline void bench_set_channels(const bench_msg_t *m)
+{
+    int j;
+    for(j = 0; j < m->n; j++)
+	futaba_sbus_set_channel(m->canal[j], m->valor[j]);
+}
+
+int main(int argc, char *argv[])
+{
+    uint8_t ref[SBUS_DATA_LENGTH];
+    struct timespec t0, t1;
+    long i, iter = BENCH_ITER_DEFAULT, errors = 0;
+    double ns_tabla, ns_bits;
+
+    if(argc > 1)
+    {
+	iter = atol(argv[1]);
+	if(iter <= 0)
+	{
+	    err_log(HOW_TO);
+	    return -1;
+	}
+    }
+
+    bench_generar();
+
+    // Verificacion byte a byte
+    futaba_sbus_reset_channels();
+    futaba_sbus_reset_msg();
+    for(i = 0; i < iter; i++)
+    {
+	bench_set_channels(&bench_seq[i % BENCH_SECUENCIA]);
+	futaba_sbus_set_failsafe(bench_seq[i % BENCH_SECUENCIA].fs);
+	futaba_sbus_update_msg();
+	futaba_sbus_encode_bitwise(ref);
+	if(memcmp(ref, futaba_sbus_get_msg(), SBUS_DATA_LENGTH) != 0)
+	    errors++;
+    }
+    futaba_sbus_set_failsafe(SBUS_SIGNAL_OK);
+
+    // Tiempos, con la misma secuencia de canales para ambos
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for(i = 0; i < iter; i++)
+    {
+	bench_set_channels(&bench_seq[i % BENCH_SECUENCIA]);
+	futaba_sbus_update_msg();
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    ns_tabla = (double)uquad_timespec_diff_ns(&t1, &t0)/iter;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for(i = 0; i < iter; i++)
+    {
+	bench_set_channels(&bench_seq[i % BENCH_SECUENCIA]);
+	futaba_sbus_encode_bitwise(ref);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    ns_bits = (double)uquad_timespec_diff_ns(&t1, &t0)/iter;
+
+    printf("mensajes:     %ld\n", iter);
+    printf("diferencias:  %ld\n", errors);
+    printf("tablas:       %.1f ns/mensaje\n", ns_tabla);
+    printf("bit a bit:    %.1f ns/mensaje\n", ns_bits);
+    printf("speedup:      %.2f\n", ns_bits/ns_tabla);
+
+    return (errors == 0) ? 0 : -1;
+}
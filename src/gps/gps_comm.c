@@ -45,7 +45,7 @@
 char* hostName = "localhost";
 char* hostPort = "1234";     // default port
 
-struct gps_data_t my_gps_data;
+struct gps_data_t my_gps_data = { .gps_fd = -1 };
 
 int preconfigure_gps(void)
 {
@@ -199,6 +199,11 @@ int get_gps_data(gps_t* gps)
    return 0;
 }
 
+int gps_get_fd(void)
+{
+   return my_gps_data.gps_fd;
+}
+
 /**
  * Funciones para pre configurar el gps (baudrate y tasa de envio de datos)
  */
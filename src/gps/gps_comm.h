@@ -60,6 +60,14 @@ int deinit_gps(void);
 int start_gpsd(void);
 int get_gps_data(gps_t* gps);
 
+/**
+ * Devuelve el fd del socket conectado a gpsd, para registrarlo
+ * en el bucle de eventos del main.
+ *
+ * @return fd del socket o -1 si no hay conexion
+ */
+int gps_get_fd(void);
+
 int gps_connect(const char *device, int baud);
 int gps_disconnect(int fd);
 int gps_send_command(int fd, const char *command);
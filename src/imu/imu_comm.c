@@ -23,8 +23,10 @@ int16_t us_obstacle;
         
 // Matrices calibracion IMU
 // Magn
-//static uquad_mat_t *magn_K;
-//static uquad_mat_t *magn_b;
+#if IMU_MAGN_CALIB
+static uquad_mat3x3_t magn_K;
+static uquad_mat3x1_t magn_b;
+#endif
 // Baro
 //static double K;
 //static double *pres_K = &K;
@@ -33,9 +35,14 @@ static double po = 0;
 //static double expo;
 //static double *pres_exponente = & expo;   
     
-// Buffer de recepcion.
+// Ultima trama recibida (para print_imu_raw)
 static unsigned char RX_imu_buffer[RX_IMU_BUFFER_SIZE];
 
+// Buffer de lectura en bloque. Los datos sin procesar estan en [0, imu_rx_len)
+static uint8_t imu_rx_buff[IMU_RX_STREAM_SIZE];
+static int imu_rx_len = 0;
+static unsigned long imu_dropped = 0;
+
 //*****************************************************************************
 //
 // Inicializacion imu
@@ -57,6 +64,13 @@ int imu_comm_init(char *device)
       return -1;
    }
 
+   // Solo despertar al main cuando hay una trama completa en el buffer
+   retval = serial_set_vmin(fd, RX_IMU_BUFFER_SIZE);
+   if (retval < 0) {
+      puts("No se pudo configurar VMIN en el puerto de la IMU");
+      return -1;
+   }
+
    // Change IMU to binary mode.
    retval = write(fd,"!",1);
    if (retval < 1) {
@@ -84,56 +98,19 @@ int imu_comm_init(char *device)
 
 //*****************************************************************************
 //
-// Leo datos de la imu
-//
-//*****************************************************************************
-int imu_comm_read(int fd)
-{
-   int ret;
-   int imu_data_ready = 0;
-   uint8_t c;
-   int index = 0;
-   bool in_sync = false;
-
-   while (!imu_data_ready)// && check_read_locks(fd))
-   {				
-	ret = read(fd,&c,1);
-	if (ret <= 0) {
-	   puts("read failed");
-	   return -1;
-	}
-
-	// Inicio del mensaje..
-        if ( (in_sync == false) && ((c == 'A') || (c == 'C')) ) {
-            index = 0;
-	    RX_imu_buffer[index] = c;
-	    in_sync = true;
-        } else if ((index < (RX_IMU_BUFFER_SIZE-2)) && (in_sync == true)) {
-	       RX_imu_buffer[++index] = c;
-	} else if ( (c == 'Z') && (in_sync == true) ) {
-               RX_imu_buffer[++index] = c;
-	       imu_data_ready = 1;
-	} else return -1;
-            
-   } // while...
-	
-   return imu_data_ready;
-}
-
-//*****************************************************************************
-//
-// Separa los datos del buffer RX y guarda la info en imu_raw
+// Separa los datos de una trama y guarda la info en imu_raw
 //
 //*****************************************************************************
-void imu_comm_parse_frame_binary(imu_raw_t *frame)//, unsigned char *data)
+static void imu_comm_parse_frame_binary(const uint8_t *buff, imu_raw_t *frame)
 {
-    unsigned char *data;
-    data = RX_imu_buffer+1;
+    const uint8_t *data;
+    data = buff+1;
     int i = 0;
-    int16_t* buffParse_16;
+    int16_t buffParse_16[RX_IMU_BUFFER_SIZE/2];
     memcpy(&frame->T_us, data, IMU_BYTES_T_US);
     data += IMU_BYTES_T_US;
-    buffParse_16 = (int16_t *)data;
+    // copio para no hacer accesos desalineados dentro del buffer de lectura
+    memcpy(buffParse_16, data, RX_IMU_BUFFER_SIZE - 2 - IMU_BYTES_T_US);
     //acc
     for(;i<3;++i)
         frame->acc[i%3] = buffParse_16[i];
@@ -146,7 +123,7 @@ void imu_comm_parse_frame_binary(imu_raw_t *frame)//, unsigned char *data)
     //temp
     frame->temp = (uint16_t)buffParse_16[i++];
     //press
-    frame->pres = *((uint32_t*)(buffParse_16 + i));
+    memcpy(&frame->pres, buffParse_16 + i, sizeof(uint32_t));
     //us - obstaculo
     i = i+2;
     frame->us_obstacle = buffParse_16[i];
@@ -155,6 +132,77 @@ void imu_comm_parse_frame_binary(imu_raw_t *frame)//, unsigned char *data)
 }
 
 
+//*****************************************************************************
+//
+// Leo datos de la imu
+//
+//*****************************************************************************
+static inline bool imu_is_start(uint8_t c)
+{
+    return (c == 'A') || (c == 'C');
+}
+
+int imu_comm_read_frames(int fd, imu_raw_t *frames, int max, bool newest_only)
+{
+   int n, i, count, first;
+   int offs[IMU_RX_STREAM_SIZE/RX_IMU_BUFFER_SIZE];
+   int n_offs = 0;
+
+   // Un read() con todo lo que entre en el buffer
+   n = read(fd, imu_rx_buff + imu_rx_len, IMU_RX_STREAM_SIZE - imu_rx_len);
+   if (n < 0) {
+	if (errno != EAGAIN) {
+	   err_log_stderr("read IMU");
+	   return -1;
+	}
+	n = 0;
+   }
+   imu_rx_len += n;
+
+   // Busco tramas completas, resincronizando en el caracter de inicio
+   i = 0;
+   while (imu_rx_len - i >= RX_IMU_BUFFER_SIZE) {
+	if (!imu_is_start(imu_rx_buff[i])) {
+	   ++i;
+	   continue;
+	}
+	if (imu_rx_buff[i + RX_IMU_BUFFER_SIZE - 1] != 'Z') {
+	   // Trama corrupta, busco el proximo inicio dentro de ella
+	   imu_dropped++;
+	   ++i;
+	   continue;
+	}
+	offs[n_offs++] = i;
+	i += RX_IMU_BUFFER_SIZE;
+   }
+   // Descarto basura hasta el proximo posible inicio de trama
+   while (i < imu_rx_len && !imu_is_start(imu_rx_buff[i]))
+	++i;
+
+   // Me quedo con las mas nuevas
+   if (newest_only)
+	max = 1;
+   first = (n_offs > max) ? n_offs - max : 0;
+   imu_dropped += first;
+   count = 0;
+   for (n = first; n < n_offs; ++n)
+	imu_comm_parse_frame_binary(imu_rx_buff + offs[n], &frames[count++]);
+   if (n_offs > 0)
+	memcpy(RX_imu_buffer, imu_rx_buff + offs[n_offs - 1], RX_IMU_BUFFER_SIZE);
+
+   // Muevo al principio lo que queda sin procesar
+   imu_rx_len -= i;
+   if (imu_rx_len > 0)
+	memmove(imu_rx_buff, imu_rx_buff + i, imu_rx_len);
+
+   return count;
+}
+
+unsigned long imu_comm_get_dropped(void)
+{
+   return imu_dropped;
+}
+
 
 //*****************************************************************************
 //
@@ -189,9 +237,11 @@ void print_imu_raw(imu_raw_t *frame)
 void print_imu_data(imu_data_t *data)
 {
     printf("%lf", data->T_us);
-    //printf("\t%lf", data->magn->m_full[0]);
-    //printf("\t%lf", data->magn->m_full[1]);
-    //printf("\t%lf", data->magn->m_full[2]);
+#if IMU_MAGN_CALIB
+    printf("\t%lf", data->magn.m[0][0]);
+    printf("\t%lf", data->magn.m[1][0]);
+    printf("\t%lf", data->magn.m[2][0]);
+#endif
     printf("\t%lf", data->alt);
     printf("\t%lf", data->us_obstacle);
     printf("\t%lf\n", data->us_altitude);
@@ -204,26 +254,24 @@ void print_imu_data(imu_data_t *data)
 //
 //*****************************************************************************
 
-#if 0
+#if IMU_MAGN_CALIB
 void magn_calib_init(void)
 {
     // K
-    magn_K = uquad_mat_alloc(3, 3);
-    magn_K->m_full[0] = 0.00402824066832922;
-    magn_K->m_full[1] = -8.96774717665988e-06;
-    magn_K->m_full[2] = 0.000363980178696652;
-    magn_K->m_full[3] = 0.0;
-    magn_K->m_full[4] = 0.00405222522881617;
-    magn_K->m_full[5] = -0.000155928970260749;
-    magn_K->m_full[6] = 0.0;
-    magn_K->m_full[7] = 0.0;
-    magn_K->m_full[8] = 0.00460429864076721;
+    magn_K.m[0][0] = 0.00402824066832922;
+    magn_K.m[0][1] = -8.96774717665988e-06;
+    magn_K.m[0][2] = 0.000363980178696652;
+    magn_K.m[1][0] = 0.0;
+    magn_K.m[1][1] = 0.00405222522881617;
+    magn_K.m[1][2] = -0.000155928970260749;
+    magn_K.m[2][0] = 0.0;
+    magn_K.m[2][1] = 0.0;
+    magn_K.m[2][2] = 0.00460429864076721;
 	
     // b
-    magn_b = uquad_mat_alloc(3, 1);
-    magn_b->m_full[0] = -63.9019715992965;
-    magn_b->m_full[1] = -38.911556235825;
-    magn_b->m_full[2] = -75.7517190381074;
+    magn_b.m[0][0] = -63.9019715992965;
+    magn_b.m[1][0] = -38.911556235825;
+    magn_b.m[2][0] = -75.7517190381074;
 }
 #endif
 
@@ -252,35 +300,26 @@ void temp_raw2data(imu_raw_t *raw, imu_data_t *data)
 {
 	data->temp = ((double)(raw->temp))/10;
 }
+#endif
 
 
+#if IMU_MAGN_CALIB
 void magn_raw2data(imu_raw_t *raw, imu_data_t *data)
 {
 	// Modelo: C = K(C_raw - b)
+	// Todo en el stack, sin malloc en el loop de control
+	uquad_mat3x1_t magn_raw, C_b;
   
 	// Paso los datos crudos del Magn a una matriz magn_raw
-	uquad_mat_t *magn_raw = uquad_mat_alloc(3, 1);
-	magn_raw->m_full[0] = raw->magn[0];
-	magn_raw->m_full[1] = raw->magn[1];
-	magn_raw->m_full[2] = raw->magn[2];
+	magn_raw.m[0][0] = raw->magn[0];
+	magn_raw.m[1][0] = raw->magn[1];
+	magn_raw.m[2][0] = raw->magn[2];
 	
 	// Resta: C_raw - b
-	uquad_mat_t *C_b = uquad_mat_alloc(3, 1);
-	uquad_mat_sub(C_b, magn_raw, magn_b);
-	
-	// Multiplicacion: K * (C_raw - b)
-	uquad_mat_t *magn_data = uquad_mat_alloc(3, 1);
-	uquad_mat_prod(magn_data, magn_K, C_b);
+	uquad_mat3x1_sub(&C_b, &magn_raw, &magn_b);
 	
-	// Copio resultado en matriz de salida
-	data->magn->m_full[0] = magn_data->m_full[0];
-	data->magn->m_full[1] = magn_data->m_full[1];
-	data->magn->m_full[2] = magn_data->m_full[2];
-	
-	// Liberacion de memoria
-	uquad_mat_free(magn_raw);
-	uquad_mat_free(C_b);	
-	uquad_mat_free(magn_data);
+	// Multiplicacion: K * (C_raw - b), directo en la salida
+	uquad_mat_prod_3x3_3x1(&data->magn, &magn_K, &C_b);
 }
 #endif
 
@@ -316,7 +355,9 @@ void imu_raw2data(imu_raw_t *raw, imu_data_t *data)
 
 	data->T_us = raw->T_us;
 	//temp_raw2data(raw, data);
-	//magn_raw2data(raw, data);
+#if IMU_MAGN_CALIB
+	magn_raw2data(raw, data);
+#endif
 	pres_raw2data(raw, data);
 
 	data->us_obstacle = (raw->us_obstacle*1.695)/100;//*0.99226 + 3.51228;
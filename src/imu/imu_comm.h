@@ -6,13 +6,17 @@
 #include <stdint.h>
 #include <string.h>
 #include <uquad_aux_math.h>
+#include <uquad_aux_mat_fixed.h>
 #include <uquad_aux_time.h>
 
 #define RX_IMU_BUFFER_SIZE	34 // Tamao del buffer de recepcion
 #define IMU_BYTES_T_US    	4  // Tamao del tiempo recibido por la IMU en formato binario
+#define IMU_RX_STREAM_SIZE	1024 // Buffer de lectura en bloque (~30 tramas)
+#define IMU_MAX_BATCH		16 // Tramas que se devuelven como maximo por lectura
 
 #define IMU_DEVICE		"/dev/ttyUSB1" // Conectado a pines CN3 del FTDI mini module
 #define BARO_CALIB_SAMPLES	100
+#define IMU_MAGN_CALIB		0 // Calibracion del magnetometro. Ver magn_raw2data()
 /**
  * Datos crudos de la IMU
  * Contiene 34 bytes, 32 utiles mas init/end.
@@ -54,7 +58,9 @@ typedef struct imu_frame {
  */
 typedef struct imu_data {
     double T_us;         // us
-    //uquad_mat_t *magn;   // rad - Euler angles - {psi/roll,phi/pitch,theta/yaw}
+#if IMU_MAGN_CALIB
+    uquad_mat3x1_t magn;  // magnetometro calibrado
+#endif
     //double temp;         // C
     double alt;          // m
     double us_obstacle;   // m
@@ -66,16 +72,38 @@ typedef struct imu_data {
 int imu_comm_init(char *device);
 //void imu_data_alloc(imu_data_t *imu_data);
 
-void imu_comm_parse_frame_binary(imu_raw_t *frame);
+/**
+ * Lee todo lo disponible en el puerto de la IMU con un read() y extrae todas
+ * las tramas completas ('A'/'C' ... 'Z'). Si hay basura o una trama corrupta
+ * se resincroniza en el proximo caracter de inicio. Los bytes de una trama
+ * incompleta quedan para la proxima lectura.
+ *
+ * @param fd
+ * @param frames buffer de salida, en orden de llegada
+ * @param max tamano de frames. Si hay mas tramas se descartan las mas viejas
+ * @param newest_only true para devolver solo la trama mas nueva en frames[0]
+ *
+ * @return cantidad de tramas en frames, -1 si falla la lectura
+ */
+int imu_comm_read_frames(int fd, imu_raw_t *frames, int max, bool newest_only);
+
+/**
+ * @return tramas descartadas (corruptas o por falta de lugar en el batch)
+ */
+unsigned long imu_comm_get_dropped(void);
+
 void print_imu_raw(imu_raw_t *frame);
 void print_imu_data(imu_data_t *data);
-int imu_comm_read(int fd);
 
-//void magn_calib_init(void);
+#if IMU_MAGN_CALIB
+void magn_calib_init(void);
+#endif
 void pres_calib_init(double po);
 
 //void temp_raw2data(imu_raw_t *raw, imu_data_t *data);
-//void magn_raw2data(imu_raw_t *raw, imu_data_t *data);
+#if IMU_MAGN_CALIB
+void magn_raw2data(imu_raw_t *raw, imu_data_t *data);
+#endif
 void pres_raw2data(imu_raw_t *raw, imu_data_t * data);
 
 void imu_raw2data(imu_raw_t *raw, imu_data_t *data);
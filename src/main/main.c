@@ -24,14 +24,17 @@
  */
 
 #include <quadcop_types.h>
-#include <uquad_kernel_msgq.h>
+#include <uquad_shm_cmd.h>
 #include <uquad_error_codes.h>
 #include <quadcop_config.h>
 #include <uquad_aux_time.h>
 #include <uquad_aux_io.h>
+#include <uquad_aux_evloop.h>
+#include <flight_log.h>
 #include <socket_comm.h>
+#include <wp_stream.h>
 //#include <path_planning.h>
-//#include <path_following.h>
+#include <path_following.h>
 #include <futaba_sbus.h>
 #include <serial_comm.h>
 #include <gps_comm.h>
@@ -48,19 +51,10 @@
 #include <stdlib.h>
 #include <sys/ioctl.h>
 
-// shm - shared memory.
-#include <sys/types.h>
-#include <sys/ipc.h>
-#include <sys/shm.h>
-
-#define CH_COUNT		6	//cantidad de canales de comunicacion con sbusd
-#define BUFF_SIZE		12	//tamano del buffer de comunicacion (tamano de cada canal = BUFF_SIZE/CH_COUNT)
+#define CH_COUNT		UQUAD_CMD_CH_COUNT	//cantidad de canales de comunicacion con sbusd
 
 #define KILL_SBUS		"killall sbusd"
 
-#define SHMSZ     27
-#include <semaphore.h>
-
 //#define SETANDO_CC3D
 
 /*********************************************
@@ -76,23 +70,31 @@ pid_t uavtalk_child_pid = 0;
 uint16_t throttle_hovering = 0;
 
 // Path planning
-Lista_path* lista_path;
-Lista_wp* lista_way_point;
+path_buff_t paths;	// trayectorias a seguir (se reservan una sola vez)
+wp_buff_t way_points;	// way points leidos del archivo
+#if WAYPOINTS_STREAM
+wp_stream_t wp_stream;	// fuente de way points (archivo, FIFO o socket)
+static bool wp_stream_registrado = false;	// fd en el bucle de eventos
+#endif
 way_point_t wp = {0,0,0,0};
+path_following_t follower;	// estado del seguimiento de trayectorias
+bool follower_sin_yaw = true;	// falta iniciar el follower con una muestra de actitud
 
 // GPS
 gps_t gps;
 bool gps_updated = false;
 
 // LOG
-int log_fd;
+flight_log_t *flight_log = NULL;
 
 // STDIN
-bool stdin_readOK = false;		//puedo leer de la entrada estandar sin bloquear
 unsigned char tmp_buff[2] = {0,0};	//almacena commnado enviado por el usuario
 
-// KMQ
-uquad_kmsgq_t *kmsgq 	= NULL;
+// Bucle de eventos (IMU, GPS, stdin y periodo de control)
+uquad_evloop_t *evloop = NULL;
+
+// Comandos a sbusd (memoria compartida)
+uquad_shm_cmd_t *shm_cmd = NULL;
 
 /** 
  * Valores iniciales de los canales a enviar al proceso sbusd
@@ -108,13 +110,6 @@ uquad_kmsgq_t *kmsgq 	= NULL;
  */
 uint16_t ch_buff[CH_COUNT]={1500,1500,1500,950,2000,0};
 
-/** 
- * Buffer para enviar mensajes de kernel
- * El casteo es necesario para enviar los mensajes de kernel
- * (de a 1 byte en lugar de 2)
- */
-uint8_t *buff_out=(uint8_t *)ch_buff;
-
 // UAVTalk
 int fd_CC3D;
 #if !FAKE_YAW
@@ -123,23 +118,27 @@ actitud_t act = {0,0,0,{0,0}}; 			//almacena variables de actitud leidas de la c
 actitud_t act = {0,0,INITIAL_YAW,{0,0}};	//si estoy en modo fake yaw inicializo el valor de yaw
 #endif
 bool uavtalk_updated = false;
+int err_uavtalk = 0;		//periodos de control sin datos nuevos de actitud
+uavtalk_state_t cc3d_state;	//estado de la CC3D (armado, modo de vuelo, alarmas)
 
 // IMU
 double h = 0;			//para simular altura
 imu_raw_t imu_raw; 		//datos crudos
 imu_data_t imu_data; 		//datos utiles
 int fd_IMU; 			//file descriptor de la IMU
-bool IMU_readOK = false; 	//puedo leer sin bloquear
+int err_imu = 0;		//periodos de control sin datos nuevos de la IMU
 bool imu_updated = false; 	//existen datos nuevos de la IMU
 bool baro_calibrated = false;	//barometro calibrado
 double po = 0; 			//variable para relevar presion ambiente (calib del baro)
 int baro_calib_cont = 0;	//contador para determinar cuantas muestras tomar para la calib del baro
 
 // Control de yaw
+control_yaw_t ctl_yaw;
 double u_yaw = 0; //senal de control (setpoint de velocidad angular)
 double yaw_d = 0;
 
 // Control de altura
+control_alt_t ctl_alt;
 double u_h = 0; //senal de control (peq señal)
 double U_h = 0; //senal de control (gran señal)
 double h_d = 0;
@@ -164,12 +163,45 @@ velocity_t velocity = {0,0,0,{0,0}};
 
 double pitch = 0; // angulo de pitch en radianes
 
+// Estado del loop de control
+int err_count_no_data = 0; 	//si no tengo datos nuevos varias veces es peligroso
+int no_gps_data = 0;
+bool first_time = true; 	//para saber cuando es la primer ejecucion del loop
+int8_t count_50 = 1; 		//controla tiempo de loop 100ms
+
+// Control de tiempos
+struct timeval tv_in_loop,
+	       tv_out_loop, tv_out_last_loop,
+	       tv_start_main,
+	       tv_diff;
+#if DEBUG
+struct timeval dt;
+#endif
+
 /// Declaracion de funciones auxiliares
 void quit(int Q);
 void uquad_sig_handler(int signal_num);
 void set_signals(void);
 void read_from_stdin(void);
 
+/// Callbacks del bucle de eventos
+int main_loop_cb(int fd, void *arg);
+int stdin_read_cb(int fd, void *arg);
+#if WAYPOINTS_STREAM
+int wp_stream_read_cb(int fd, void *arg);
+static int wp_stream_atender(void);
+static void wp_stream_evloop_actualizar(void);
+#endif
+#if !DISABLE_UAVTALK
+int uavtalk_read_cb(int fd, void *arg);
+#endif
+#if !DISABLE_IMU
+int imu_read_cb(int fd, void *arg);
+#endif
+#if !SIMULATE_GPS
+int gps_read_cb(int fd, void *arg);
+#endif
+
 uint16_t convert_yaw2pwm(double yaw); // Convierte angulo de yaw a senal de pwm para enviar a la cc3d // TODO no implementado
 
 /*********************************************/
@@ -208,20 +240,9 @@ int main(int argc, char *argv[])
 #endif
 
    int retval;
-   
-  
-   int err_imu = 0;		//Aumenta si no hay datos nuevos de imu
-   int err_count_no_data = 0; 	//si no tengo datos nuevos varias veces es peligroso
-   int no_gps_data = 0;
 
    // Para log
    char* log_name;
-   char buff_log[512]; 		//TODO determinar valor
-   char buff_log_aux[512];	//TODO determinar valor
-   int buff_log_len;
-
-   bool first_time = true; // para saber cuando es la primer ejecucion del loop
-   int8_t count_50 = 1; // controla tiempo de loop 100ms
 
    if(argc<3)
    {
@@ -252,15 +273,6 @@ int main(int argc, char *argv[])
    //setea senales y mascara
    set_signals();
 
-   // Control de tiempos
-   struct timeval tv_in_loop,
-		  tv_out_loop, tv_out_last_loop,
-                  tv_start_main,
-                  tv_diff;
-#if DEBUG
-   struct timeval dt;
-#endif
-
    // -- -- -- -- -- -- -- -- --
    // Inicializacion
    // -- -- -- -- -- -- -- -- --
@@ -275,34 +287,72 @@ int main(int argc, char *argv[])
 #endif
 
    /// Path planning & Following
-   // init lista path
-   lista_path = (Lista_path *)malloc(sizeof(struct ListaIdentificar_path));
-   inicializacion_path(lista_path);
-
-   // init lista wp
-   lista_way_point = (Lista_wp *)malloc(sizeof(struct ListaIdentificar_wp));
-   inicializacion_wp(lista_way_point);
-   retval = way_points_input(lista_way_point); //carga waypoints en la lista desde un archivo de texto
+   // init buffer path
+   path_buff_init(&paths);
+
+   // init buffer wp
+   wp_buff_init(&way_points);
+#if WAYPOINTS_STREAM
+   // Alcanza con el primer par de way points para arrancar, el resto se
+   // planifica a medida que llega (ver wp_stream_atender()). Los buffers
+   // son circulares, la mision puede tener cualquier largo
+   retval = wp_buff_reservar(&way_points, WAYPOINTS_STREAM_BUFF);
+   if (retval == 0)
+	retval = path_buff_reservar(&paths, WAYPOINTS_STREAM_BUFF);
+   if (retval < 0) {
+	puts("No hay memoria para los way points, cerrando");
+	exit(0);
+   }
+   retval = wp_stream_open(&wp_stream, WAYPOINTS_FILE);
+   if (retval < 0) {
+	puts("No se pudo abrir la fuente de waypoints, cerrando");
+	exit(0);
+   }
+   while (way_points.tamano < 2 && !wp_stream_terminado(&wp_stream)) {
+	retval = wp_stream_leer(&wp_stream, &way_points);
+	if (retval < 0) {
+	   puts("No se pudo cargar lista de waypoints, cerrando");
+	   exit(0);
+	}
+	if (way_points.tamano < 2 && !wp_stream_terminado(&wp_stream))
+	   sleep_ms(10);
+   }
+
+   // Generacion de las primeras trayectorias
+   path_planning_horizonte(&way_points, &paths, PATH_PLANNING_HORIZONTE);
+   if (paths.tamano == 0) {
+	puts("No se pudo generar la trayectoria, cerrando");
+	exit(0);
+   }
+#else
+   retval = way_points_input(&way_points); //carga waypoints en el buffer desde un archivo de texto
    if (retval < 0) {
 	puts("No se pudo cargar lista de waypoints, cerrando");
 	exit(0);
    }
 
    // Generacion de trayectoria
-   path_planning(lista_way_point, lista_path);
+   retval = path_planning(&way_points, &paths);
+   if (retval < 0) {
+	puts("No se pudo generar la trayectoria, cerrando");
+	exit(0);
+   }
 
-   log_trayectoria(lista_path);    //dbg
-   //visualizacion_path(lista_path); // dbg
+   log_trayectoria(&paths);    //dbg
+#endif
+   //visualizacion_path(&paths); // dbg
 
 #if SOCKET_TEST
-   if (socket_comm_send_path(lista_path) == -1)
+   if (socket_comm_send_path(&paths) == -1)
 	exit(0);
 #endif
 
+   /// Path following
+   // Se vuelve a iniciar con la primera muestra de actitud (uavtalk_read_cb())
+   path_following_init(&follower, yaw_d);
+
    /// Control yaw
-#if CONTROL_YAW_ADD_DERIVATIVE
-   control_yaw_init_error_buff();
-#endif
+   control_yaw_init(&ctl_yaw);
 
    /// Control velocidad
    // TODO
@@ -313,18 +363,17 @@ int main(int argc, char *argv[])
    //printf("pitch: %lf\n", pitch*180/M_PI); //dbg
 
    /// Control altura
-   control_alt_init_error_buff();
+   control_alt_init(&ctl_alt);
    //thrust_hovering = throttle_hovering*0.0694-88.81;
    printf("Thrust hovering: %lf\n", thrust_hovering);
 
-   /// Log
-   log_fd = open(log_name, O_RDWR | O_CREAT | O_NONBLOCK );
-   if(log_fd < 0)
+   /// Log - registro binario, convertir a texto con flight_log2txt
+   flight_log = flight_log_open(log_name, FLIGHT_LOG_RECORDS);
+   if(flight_log == NULL)
    {
       err_log_stderr("Failed to open log file!");
       exit(0);
    }
-   bool log_writeOK;
 
    ///GPS config - Envia comandos al gps a traves del puerto serie - //
 #if !SIMULATE_GPS
@@ -344,6 +393,14 @@ int main(int argc, char *argv[])
    }
 #endif //!SIMULATE_GPS
 
+   /// inicializa bloque de comandos compartido - para comunicacion con sbusd
+   // Se crea antes de lanzar sbusd para que este lo pueda abrir
+   shm_cmd = uquad_shm_cmd_init(true);
+   if(shm_cmd == NULL)
+   {
+      quit_log_if(ERROR_FAIL,"Failed to create command block!");
+   }
+
    /// Ejecuta Demonio S-BUS - proceso independiente
    sbusd_child_pid = futaba_sbus_start_daemon(); 
    if(sbusd_child_pid == -1)
@@ -352,19 +409,19 @@ int main(int argc, char *argv[])
       quit(1);  
    }
 
-   /// inicializa kernel messages queues - para comunicacion con sbusd
-   kmsgq = uquad_kmsgq_init(SERVER_KEY, DRIVER_KEY);
-   if(kmsgq == NULL)
-   {
-      quit_log_if(ERROR_FAIL,"Failed to start message queue!");
-   }
-
    //Doy tiempo a que inicien bien los procesos secundarios
    sleep_ms(500); //TODO verificar cuanto es necesario
 
 
    /// inicializa UAVTalk
 #if !DISABLE_UAVTALK
+   // El canal compartido se crea antes del fork para que el parser lo herede
+   retval = uavtalk_init_shm();
+   if (retval < 0) {
+	puts("Error al inicializar shm, cerrando");
+	quit(0);
+   }
+
    uavtalk_child_pid = uavtalk_parser_start(tv_start_main);
    if(uavtalk_child_pid == -1)
    {
@@ -382,8 +439,9 @@ int main(int argc, char *argv[])
       quit(0);  
    } 
    //imu_data_alloc(&imu_data);
-   //magn_calib_init();
-   int bytes_avail = 0; // Para obener bytes disponibles en el RX buffer de IMU
+#if IMU_MAGN_CALIB
+   magn_calib_init();
+#endif
 #endif
    
 #if !DISABLE_IMU
@@ -393,60 +451,106 @@ int main(int argc, char *argv[])
    sleep_ms(40);
 #endif
 
-#if !DISABLE_UAVTALK 
-   retval = uavtalk_init_shm();
-   if (retval < 0) {
-	puts("Error al inicializar shm, cerrando");
-	quit(0);
+
+   /// Bucle de eventos
+   evloop = uquad_evloop_init();
+   if (evloop == NULL) {
+      err_log("Failed to init event loop!");
+      quit(0);
+   }
+
+   retval = uquad_evloop_add_fd(evloop, STDIN_FILENO, stdin_read_cb, NULL);
+   if (retval != ERROR_OK) {
+      // Si stdin no soporta epoll (ej: redireccionado de un archivo) sigo sin comandos
+      err_log("WARN: no se pueden leer comandos de stdin");
+   }
+
+#if !DISABLE_IMU
+   retval = uquad_evloop_add_fd(evloop, fd_IMU, imu_read_cb, NULL);
+   if (retval != ERROR_OK) {
+      err_log("Failed to register IMU!");
+      quit(0);
+   }
+#endif
+
+#if !DISABLE_UAVTALK
+   retval = uquad_evloop_add_fd(evloop, uavtalk_get_fd(), uavtalk_read_cb, NULL);
+   if (retval != ERROR_OK) {
+      err_log("Failed to register uavtalk!");
+      quit(0);
+   }
+#endif
+
+#if !SIMULATE_GPS
+   retval = uquad_evloop_add_fd(evloop, gps_get_fd(), gps_read_cb, NULL);
+   if (retval != ERROR_OK) {
+      err_log("Failed to register gps!");
+      quit(0);
+   }
+#endif
+
+#if WAYPOINTS_STREAM
+   // Pipes y sockets se leen desde el bucle de eventos, un archivo comun
+   // desde el loop de control
+   wp_stream_evloop_actualizar();
+   if (!wp_stream.archivo && !wp_stream.fin && !wp_stream_registrado) {
+      err_log("Failed to register way point stream!");
+      quit(0);
+   }
+#endif
+
+   retval = uquad_evloop_set_period(evloop, MAIN_LOOP_T_US, main_loop_cb, NULL);
+   if (retval != ERROR_OK) {
+      err_log("Failed to set main loop period!");
+      quit(0);
    }
-#endif //!DISABLE_UAVTALK 
 
    printf("----------------------\n  Entrando al loop  \n----------------------\n");
    // -- -- -- -- -- -- -- -- -- 
    // Loop
    // -- -- -- -- -- -- -- -- -- 
+   // El proceso duerme en epoll hasta que llegan datos o vence el periodo
+   // de control, ver main_loop_cb().
    for(;;)
    {
-	//para tener tiempo de entrada en cada loop
-	gettimeofday(&tv_in_loop,NULL);
-	
-	//TODO Mejorar control de errores
-	if(err_count_no_data > 10)
-	{
-	   err_log("mas de 10 errores en recepcion de datos!");
-	   // TODO que hago? me quedo en hovering hasta obtener datos?
-	   err_count_no_data = 0; //por ahora...
-	}
+	retval = uquad_evloop_run_once(evloop, -1);
+	if(retval != ERROR_OK)
+	   err_log_num("WARN: error en el bucle de eventos", retval);
+   } // for(;;)
 
-#if !DISABLE_IMU
-	/// Lectura de datos de la IMU
-//--------------------------------------------------------------------------------------------------------
-	leer_imu: // Vuelvo a leer si es necesario
+   return 0; //nunca llego aca
 
-	if(err_imu > 2) {
-		err_log("No hay datos nuevos de IMU, cerrando.");
-		quit(0);
-	} 
+} //FIN MAIN
 
-	// Reviso si tengo una trama de datos completa antes de leer
-	ioctl(fd_IMU, FIONREAD, &bytes_avail);
-	if(bytes_avail < 34) {
-		//puts("datos no completos IMU!"); //dbg
-		sleep_ms(5);
-		err_imu++;
-		goto leer_imu;
-	}
 
-	IMU_readOK = check_read_locks(fd_IMU);
-	if (IMU_readOK) {
 
-            // Leo datos
-	    retval = imu_comm_read(fd_IMU);            
- 	    if (retval < 0 ) {
-		puts("WARN: unable to read IMU data!");
-	    }
-            // Paso los datos del buffer RX a imu_raw.
-            imu_comm_parse_frame_binary(&imu_raw);
+// -- -- -- -- -- -- -- -- -- 
+// Callbacks del bucle de eventos
+// -- -- -- -- -- -- -- -- --
+
+#if !DISABLE_IMU
+/*********************************************/
+/************* Datos de la IMU ***************/
+/*********************************************/
+/**
+ * Se ejecuta cuando hay al menos una trama completa en el buffer RX de la
+ * IMU (ver serial_set_vmin()). Lee todo lo disponible de una vez y procesa
+ * todas las tramas en orden para no saltear muestras del filtro.
+ */
+int imu_read_cb(int fd, void *arg)
+{
+	imu_raw_t imu_batch[IMU_MAX_BATCH];
+	int i, n;
+
+	n = imu_comm_read_frames(fd, imu_batch, IMU_MAX_BATCH, false);
+	if (n < 0) {
+	    puts("WARN: unable to read IMU data!");
+	    return ERROR_OK;
+	}
+
+	for (i = 0; i < n; ++i)
+	{
+	    imu_raw = imu_batch[i];
 	    //print_imu_raw(&imu_raw); // dbg
 
 	    // Si no estoy calibrando convierto datos para usarlos
@@ -454,33 +558,183 @@ int main(int argc, char *argv[])
 		imu_raw2data(&imu_raw, &imu_data);
 		//print_imu_data(&imu_data); //dbg
 	    }
+	}
 
+	if (n > 0) {
 	    imu_updated = true;
-            IMU_readOK = false;
 	    err_imu = 0;
+	}
 
-        } else {
-	   err_log("IMU: read NOT ok");
+	return ERROR_OK;
+}
+#endif //!DISABLE_IMU
+
+#if !SIMULATE_GPS
+/*********************************************/
+/************* Datos del GPS *****************/
+/*********************************************/
+int gps_read_cb(int fd, void *arg)
+{
+	int retval = get_gps_data(&gps);
+	if (retval < 0 )
+	{
+	   //que hago si NO hay datos!?
+	   err_log("No hay datos de gps");
+	} else {
+	   //que hago si SI hay datos!?
+	   printf("%lf\t%lf\t%lf\t%lf\t%lf\n",   \
+		gps.latitude,gps.longitude,gps.altitude,gps.speed,gps.track);
+	   gps_updated = true;
 	}
 
-/*	/// Reviso si quedan datos para no atrasarme
-	IMU_readOK = check_read_locks(fd_IMU);
-	if (IMU_readOK) {
-		printf("todavia quedan datos IMU!\n");
-		IMU_readOK = false;
-		ioctl(fd_IMU, FIONREAD, &bytes_avail);
-		//printf("%d\n ",bytes_avail);
-		if(bytes_avail > 33) goto leer_imu; //continue;
-	}*/
-
-	// Reviso si tengo una trama de datos completa atrasada
-	retval = ioctl(fd_IMU, FIONREAD, &bytes_avail);
-	if (retval == ERROR_OK) {
-		if(bytes_avail > 33) {
-			//puts("todavia quedan datos IMU!"); //dbg
-			goto leer_imu;
-		}	
-	} else puts("FIONREAD failed!");
+	return ERROR_OK;
+}
+#endif //!SIMULATE_GPS
+
+#if !DISABLE_UAVTALK
+/*********************************************/
+/************* Actitud de la CC3D ************/
+/*********************************************/
+/**
+ * Se ejecuta cuando el parser avisa por el eventfd que hay muestras nuevas.
+ */
+int uavtalk_read_cb(int fd, void *arg)
+{
+	/// Leo datos de CC3D
+	if (uavtalk_read(&act) > 0) {
+	   // Calcula diferencia respecto a cero
+	   act.yaw = act.yaw - get_yaw_zero(&ctl_yaw);
+	   uavtalk_updated = true;
+
+	   // El follower arranca desde el yaw actual, ya referido al cero
+	   if (follower_sin_yaw && control_status != STARTED) {
+	      path_following_init(&follower, act.yaw);
+	      yaw_d = act.yaw;
+	      follower_sin_yaw = false;
+	   }
+	   err_uavtalk = 0;
+	   //uav_talk_print_attitude(act); //dbg
+	}
+
+	/// Estado de la CC3D - aviso solo los cambios
+	uavtalk_state_t last = cc3d_state;
+	if (uavtalk_read_state(&cc3d_state) > 0) {
+	   if (cc3d_state.armed != last.armed)
+		printf("CC3D: %s\n", (cc3d_state.armed == 2) ? "armada" : (cc3d_state.armed == 1) ? "armando" : "desarmada");
+	   if (cc3d_state.alarm_cpu > 2 && last.alarm_cpu <= 2)
+		err_log("WARN: alarma de CPU en la CC3D");
+	}
+
+	return ERROR_OK;
+}
+#endif //!DISABLE_UAVTALK
+
+/*********************************************/
+/************* Comandos de stdin *************/
+/*********************************************/
+int stdin_read_cb(int fd, void *arg)
+{
+	read_from_stdin();
+	return ERROR_OK;
+}
+
+#if WAYPOINTS_STREAM
+/*********************************************/
+/************* Way points nuevos *************/
+/*********************************************/
+int wp_stream_read_cb(int fd, void *arg)
+{
+	wp_stream_atender();
+	return ERROR_OK;
+}
+
+/**
+ * Agrega los way points que llegaron (o que esperaban lugar en el buffer)
+ * y planifica las trayectorias del horizonte.
+ *
+ * @return cantidad de trayectorias nuevas
+ */
+static int wp_stream_atender(void)
+{
+	int retval, nuevas;
+
+	if (!wp_stream_terminado(&wp_stream)) {
+	   retval = wp_stream_leer(&wp_stream, &way_points);
+	   if (retval < 0 || wp_stream_terminado(&wp_stream)) {
+	      // Se sigue con los way points que ya llegaron
+	      if (retval < 0) {
+		 err_log("Error leyendo way points, no se aceptan mas");
+	      } else
+		 printf("Mision completa: %d way points\n", way_points.tamano);
+	      if (wp_stream_registrado) {
+		 uquad_evloop_rm_fd(evloop, wp_stream.fd);
+		 wp_stream_registrado = false;
+	      }
+	      wp_stream_close(&wp_stream);
+	   }
+	}
+
+	// Descarta los way points ya usados, lo que deja lugar para leer mas
+	nuevas = path_planning_horizonte(&way_points, &paths, PATH_PLANNING_HORIZONTE);
+	wp_stream_evloop_actualizar();
+
+	return nuevas;
+}
+
+/**
+ * El fd queda en el bucle de eventos solo mientras haya lugar para los
+ * way points que lleguen, sino epoll (por nivel) avisaria en cada vuelta.
+ */
+static void wp_stream_evloop_actualizar(void)
+{
+	bool leer = !wp_stream.archivo && !wp_stream.fin && !wp_buff_lleno(&way_points);
+	int retval;
+
+	if (leer == wp_stream_registrado)
+	   return;
+	if (leer) {
+	   retval = uquad_evloop_add_fd(evloop, wp_stream.fd, wp_stream_read_cb, NULL);
+	   if (retval != ERROR_OK) {
+	      err_log("No se pudo registrar el stream de way points");
+	      return;
+	   }
+	} else
+	   uquad_evloop_rm_fd(evloop, wp_stream.fd);
+	wp_stream_registrado = leer;
+}
+#endif
+
+/*********************************************/
+/************* Loop de control 50 ms *********/
+/*********************************************/
+/**
+ * Se ejecuta una vez por periodo del timerfd, despues de atender a la IMU,
+ * GPS y stdin, por lo que siempre usa los datos mas nuevos.
+ */
+int main_loop_cb(int fd, void *arg)
+{
+	int retval;
+
+	// Para log
+	flight_rec_t rec;
+
+	//para tener tiempo de entrada en cada loop
+	gettimeofday(&tv_in_loop,NULL);
+	
+	//TODO Mejorar control de errores
+	if(err_count_no_data > 10)
+	{
+	   err_log("mas de 10 errores en recepcion de datos!");
+	   // TODO que hago? me quedo en hovering hasta obtener datos?
+	   err_count_no_data = 0; //por ahora...
+	}
+
+#if !DISABLE_IMU
+	// err_imu se resetea en imu_read_cb() con cada trama nueva
+	if(err_imu++ > 2) {
+		err_log("No hay datos nuevos de IMU, cerrando.");
+		quit(0);
+	} 
 
 	if (!baro_calibrated) {
 		if(imu_updated) {		
@@ -491,61 +745,35 @@ int main(int argc, char *argv[])
 			   baro_calibrated = true;
 			   puts("Barometro calibrado!");
 		}	}
-		goto end_loop; //si estoy calibrando no hago nada mas!
+		return ERROR_OK; //si estoy calibrando no hago nada mas!
 	}
-//--------------------------------------------------------------------------------------------------------
 #endif
 
 	/** loop 50 ms **/
 
 #if !DISABLE_UAVTALK
-	/// Leo datos de CC3D
-	retval = uavtalk_read(&act);
-	if(retval < 0) {
+	// err_uavtalk se resetea en uavtalk_read_cb() con cada muestra nueva
+	if(err_uavtalk++ > 2) {
 		err_log("No hay datos nuevos de actitud, cerrando.");
 		quit(0);
 	}
-	uavtalk_updated = true;
-	//uav_talk_print_attitude(act); //dbg
 #endif
 
-	// Calcula diferencia respecto a cero
-	act.yaw = act.yaw - get_yaw_zero();
-
 	++count_50; // control de loop 100ms
 
-	/// Check stdin
-	stdin_readOK = check_read_locks(STDIN_FILENO);
-	if (stdin_readOK) {
-	   read_from_stdin();
-	}
-
 	/** loop 100 ms **/
 	if(count_50 > 1)
 	{ 
-#if !SIMULATE_GPS
-	   /// Obener datos del GPS
-	   retval = get_gps_data(&gps);
-	   if (retval < 0 )
-	   {  
-		//que hago si NO hay datos!?
-		err_log("No hay datos de gps");
-	   } else {
-		//que hago si SI hay datos!?
-		printf("%lf\t%lf\t%lf\t%lf\t%lf\n",   \
-			gps.latitude,gps.longitude,gps.altitude,gps.speed,gps.track);
-		gps_updated = true;
-	   }
-#else //GPS SIMULADO
+#if SIMULATE_GPS
 	   if(control_status == STARTED && !first_time)
 	      gps_simulate_position(&position, &velocity, act.yaw, pitch);
 	   gps_updated = true;
-#endif //!SIMULATE_GPS
+#endif //SIMULATE_GPS
+	   // Con GPS real los datos llegan por gps_read_cb()
 
 	   count_50 = 0;
 	} /** end loop 100 ms **/
 
-
 	if(control_status == STARTED)
         {
 	   if (first_time)	
@@ -572,7 +800,16 @@ int main(int argc, char *argv[])
 #endif //!SIMULATE_GPS
 	      
 	         //carrot chase
-	         retval = path_following(wp, lista_path, &yaw_d);
+	         retval = path_following(&follower, wp, &paths, &yaw_d);
+#if WAYPOINTS_STREAM
+	         // Trayectorias nuevas a medida que se avanza
+	         if (wp_stream_atender() > 0 && retval == -1)
+		     retval = path_following(&follower, wp, &paths, &yaw_d);
+	         if (retval == -1 && !wp_stream_terminado(&wp_stream)) {
+		     // Faltan way points, mantengo el ultimo yaw_d hasta que lleguen
+		     retval = 0;
+	         }
+#endif
 	         if (retval == -1) {
 		     control_status = FINISHED;
 		     puts("¡¡ Trayectoria finalizada !!");
@@ -591,7 +828,7 @@ int main(int argc, char *argv[])
 	      }
 
 	      /// Control Yaw - necesito solo medida de yaw
-	      u_yaw = control_yaw_calc_input(yaw_d, act.yaw);
+	      u_yaw = control_yaw_calc_input(&ctl_yaw, yaw_d, act.yaw);
 	      //printf("senal de control: %lf\n", u); // dbg
 
 	      //Convertir velocidad en comando
@@ -633,9 +870,9 @@ int main(int argc, char *argv[])
 
 #if SIMULATE_ALTITUDE
 	   /// Control de Altura
-	   u_h = control_alt_calc_input(h_d, h);
+	   u_h = control_alt_calc_input(&ctl_alt, h_d, h);
 	   //U_h = u_h + 18.1485;
-	   U_h = u_h + thrust_hovering + control_alt_integral(h_d, h);
+	   U_h = u_h + thrust_hovering + control_alt_integral(&ctl_alt, h_d, h);
 
 	   //sim 
 	   imu_simulate_altitude(&h, U_h, 0, 0);
@@ -655,9 +892,9 @@ int main(int argc, char *argv[])
 
 #if !DISABLE_IMU
 	   /// Control de Altura
-	   u_h = control_alt_calc_input(h_d, imu_data.us_altitude);
+	   u_h = control_alt_calc_input(&ctl_alt, h_d, imu_data.us_altitude);
 	   //U_h = u_h + 18.1485;
-	   U_h = u_h + thrust_hovering + control_alt_integral(h_d, imu_data.us_altitude);
+	   U_h = u_h + thrust_hovering + control_alt_integral(&ctl_alt, h_d, imu_data.us_altitude);
 	   
 	   //Convertir empuje en comando
 	   if (U_h <= 0) {
@@ -677,8 +914,8 @@ int main(int argc, char *argv[])
 	} // end if(control_started)
 
 
-	// Envia actitud y throttle deseados a sbusd (a traves de mensajes de kernel)
-	retval = uquad_kmsgq_send(kmsgq, buff_out, MSGSZ);
+	// Envia actitud y throttle deseados a sbusd (a traves de memoria compartida)
+	retval = uquad_shm_cmd_send(shm_cmd, ch_buff);
 	if(retval != ERROR_OK)
 	{
 	   quit_log_if(ERROR_FAIL,"Failed to send message!");
@@ -698,63 +935,42 @@ int main(int argc, char *argv[])
 	gettimeofday(&tv_out_loop,NULL);
 	uquad_timeval_substract(&dt, tv_out_loop, tv_out_last_loop);
 
+	// Registro de vuelo: solo se copian valores, se formatea offline
+
 	//datos de CC3D para log
-	buff_log_len = uavtalk_to_str(buff_log, act);
+	rec.act_sec	= (uint32_t)act.ts.tv_sec;
+	rec.act_usec	= (uint32_t)act.ts.tv_usec;
+	rec.roll	= act.roll;
+	rec.pitch	= act.pitch;
+	rec.yaw	= act.yaw;
 
 	//otros logs
-	buff_log_len += sprintf(buff_log_aux, "%u %u %u %u %lu %lu %lf %lf %lf %lf %lf %lf %lf",
-				ch_buff[ROLL_CH_INDEX],
-				ch_buff[PITCH_CH_INDEX],
-				ch_buff[YAW_CH_INDEX],
-				ch_buff[THROTTLE_CH_INDEX],
-				tv_diff.tv_sec,
-				tv_diff.tv_usec,
-				position.x,
-				position.y,
-				position.z,
-				yaw_d,
-				u_yaw,
-				h_d,
-				U_h);
-
-	strcat(buff_log, buff_log_aux);
-	
-	//datos de IMU para log
-	buff_log_len += imu_to_str(buff_log_aux, imu_data);
-
-	strcat(buff_log, buff_log_aux);
-
-	log_writeOK = check_write_locks(log_fd);
-	if (log_writeOK) {
-	   retval = write(log_fd, buff_log, buff_log_len);
-	   if(retval < 0)
-		err_log_stderr("Failed to write to log file!");
-	}
-
-	end_loop:
-
-/*#if DEBUG 
-	// checkeo de tiempos del main
-	gettimeofday(&tv_out_loop,NULL);
-	retval = uquad_timeval_substract(&dt, tv_out_loop, tv_in_loop);
-	if(retval > 0) {
-	   if(dt.tv_usec > 50000) {
-		err_log("WARN: se atraso main");
-           }
-	} else {
-	   err_log("WARN: Main absurd timing!");
-	}
-#endif // DEBUG*/
-
-	/// Control de tiempos del loop
-	wait_loop_T_US(MAIN_LOOP_50_MS,tv_in_loop);
+	rec.ch_roll	= ch_buff[ROLL_CH_INDEX];
+	rec.ch_pitch	= ch_buff[PITCH_CH_INDEX];
+	rec.ch_yaw	= ch_buff[YAW_CH_INDEX];
+	rec.ch_throttle = ch_buff[THROTTLE_CH_INDEX];
+	rec.main_sec	= (uint32_t)tv_diff.tv_sec;
+	rec.main_usec	= (uint32_t)tv_diff.tv_usec;
+	rec.pos_x	= position.x;
+	rec.pos_y	= position.y;
+	rec.pos_z	= position.z;
+	rec.yaw_d	= yaw_d;
+	rec.u_yaw	= u_yaw;
+	rec.h_d	= h_d;
+	rec.U_h	= U_h;
 
-   } // for(;;)
+	//datos de IMU para log
+	rec.imu_sec	= (uint32_t)imu_data.ts.tv_sec;
+	rec.imu_usec	= (uint32_t)imu_data.ts.tv_usec;
+	rec.alt	= imu_data.alt;
+	rec.us_obstacle = imu_data.us_obstacle;
+	rec.us_altitude = imu_data.us_altitude;
 
-   return 0; //nunca llego aca
-
-} //FIN MAIN
+	// Lo escribe el thread del log, si la cola esta llena se descarta
+	flight_log_push(flight_log, &rec);
 
+	return ERROR_OK;
+}
 
 
 // -- -- -- -- -- -- -- -- -- 
@@ -800,11 +1016,27 @@ void quit(int Q)
    if(retval != ERROR_OK)
       err_log("Could not close IO correctly!");*/
 
-   /// Kernel Messeges Queue
-   uquad_kmsgq_deinit(kmsgq);
+   /// Bloque de comandos compartido
+   uquad_shm_cmd_deinit(shm_cmd);
+
+#if WAYPOINTS_STREAM
+   /// Way points
+   wp_stream_close(&wp_stream);
+   paths.actual = path_buff_primera(&paths); // log de las que siguen guardadas
+   log_trayectoria(&paths);    //dbg
+#endif
+   path_buff_liberar(&paths);
+   wp_buff_liberar(&way_points);
 
    /// Log
-   close(log_fd);
+   if(flight_log != NULL) {
+      flight_log_stats_t log_stats;
+      retval = flight_log_close(flight_log, &log_stats);
+      if(retval != ERROR_OK)
+         err_log("Could not close log file correctly!");
+      printf("Log: %lu registros, %lu descartados, ocupacion maxima de la cola %lu/%d\n",
+	     log_stats.written, log_stats.dropped, log_stats.high_water, FLIGHT_LOG_QUEUE_LEN);
+   }
    
 #if !SIMULATE_GPS
    if(Q != 4) {
@@ -822,6 +1054,8 @@ void quit(int Q)
       if(retval != ERROR_OK)
          err_log("Could not close Parser correctly!");
    }
+   if(uavtalk_get_lost() > 0)
+      printf("WARN: se perdieron %lu muestras de actitud\n", uavtalk_get_lost());
 #endif // !DISABLE_UAVTALK
      
    exit(0);
@@ -894,20 +1128,29 @@ void set_signals(void)
 /*********************************************/
 void read_from_stdin(void)
 {
-         int retval = fread(tmp_buff,sizeof(unsigned char),1,stdin); //TODO corregir que queda algo por leer en el buffer?
+         // read() en lugar de fread() para no dejar comandos en el buffer de
+         // stdio, epoll solo ve lo que queda en el fd
+         int retval = read(STDIN_FILENO,tmp_buff,1);
          if(retval < 0)
          {
 	    //log_n_jump(ERROR_READ, end_stdin,"No user input detected!");
             err_log_num("No user input detected!",ERROR_READ);
             return;
          }
+         if(retval == 0)
+         {
+            // EOF, dejo de escuchar stdin para no despertar en cada iteracion
+            err_log("stdin cerrado, no se aceptan mas comandos");
+            uquad_evloop_rm_fd(evloop, STDIN_FILENO);
+            return;
+         }
          
 	 //retval = 0;
          switch(tmp_buff[0])
          {
          case 'S':
             //ch_buff[THROTTLE_CH_INDEX] = throttle_inicial; //No va ahora
-	    //set_alt_zero(double alt_measured);
+	    //set_alt_zero(&ctl_alt, double alt_measured);
 	    takeoff = 1; //true
             puts("Despegando!");
             control_status = STARTED;
@@ -937,7 +1180,8 @@ void read_from_stdin(void)
          case 'A':
 #if !FAKE_YAW
 	    //yaw_zero = act.yaw;
-	    set_yaw_zero(act.yaw);
+	    set_yaw_zero(&ctl_yaw, act.yaw);
+	    follower_sin_yaw = true;	// cambio la referencia del yaw
 #endif
             ch_buff[ROLL_CH_INDEX] = ROLL_NEUTRAL;
             ch_buff[PITCH_CH_INDEX] = PITCH_NEUTRAL;
@@ -988,8 +1232,6 @@ void read_from_stdin(void)
             break;
          } //switch(tmp_buff[0])
 
-	 fflush( stdin );
-
          return;
 }
 
@@ -76,7 +76,7 @@
 
 int Doolittle_LU_Decomposition_with_Pivoting(double *A, int pivot[], int n)
 {
-   int i, j, k, p;
+   int i, j, k;
    double *p_k, *p_row, *p_col;
    double max;
 
@@ -88,6 +88,7 @@ int Doolittle_LU_Decomposition_with_Pivoting(double *A, int pivot[], int n)
 //            find the pivot row
 
       pivot[k] = k;
+      p_col = p_k;
       max = uquad_abs( *(p_k + k) );
       for (j = k + 1, p_row = p_k + n; j < n; j++, p_row += n) {
          if ( max < uquad_abs(*(p_row + k)) ) {
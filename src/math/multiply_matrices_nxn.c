@@ -0,0 +1,76 @@
+/**
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+////////////////////////////////////////////////////////////////////////////////
+// File: multiply_matrices_nxn.c                                              //
+// Routine(s):                                                                //
+//    Multiply_Matrices_2x2                                                   //
+//    Multiply_Matrices_4x4                                                   //
+//    Multiply_Matrices_6x6                                                   //
+//    Multiply_Matrices_9x9                                                   //
+//    Multiply_Matrices_12x12                                                 //
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+//  void Multiply_Matrices_NxN(double *C, double *A, double *B)               //
+//                                                                            //
+//  Description:                                                              //
+//     Post multiply the N x N matrix A by the N x N matrix B to form the     //
+//     N x N matrix C, i.e. C = A B.                                          //
+//     All matrices should be declared as double X[N][N] in the calling       //
+//     routine where X = A, B, C. C must not be A or B.                       //
+//     Loops are i-k-j with constant bounds, so the compiler unrolls them     //
+//     and vectorizes the row update. Each element is summed in k order      //
+//     starting from 0, same result as Multiply_Matrices().                   //
+//                                                                            //
+//  Arguments:                                                                //
+//     double *C    Pointer to the first element of the matrix C.             //
+//     double *A    Pointer to the first element of the matrix A.             //
+//     double *B    Pointer to the first element of the matrix B.             //
+//                                                                            //
+//  Return Values:                                                            //
+//     void                                                                   //
+//                                                                            //
+//  Example:                                                                  //
+//     double A[6][6],  B[6][6], C[6][6];                                     //
+//                                                                            //
+//     (your code to initialize the matrices A and B)                         //
+//                                                                            //
+//     Multiply_Matrices_6x6(&C[0][0], &A[0][0], &B[0][0]);                   //
+//     printf("The matrix C is \n"); ...                                      //
+////////////////////////////////////////////////////////////////////////////////
+#define MULTIPLY_MATRICES_NXN(N)                                              \
+void Multiply_Matrices_##N##x##N(double *C, double *A, double *B)             \
+{                                                                             \
+   double c[N];                                                               \
+   double a;                                                                  \
+   int i,j,k;                                                                 \
+                                                                              \
+   for (i = 0; i < N; i++) {                                                  \
+      for (j = 0; j < N; j++)                                                 \
+         c[j] = 0.0;                                                          \
+      for (k = 0; k < N; k++) {                                               \
+         a = A[i*N + k];                                                      \
+         for (j = 0; j < N; j++)                                              \
+            c[j] += a * B[k*N + j];                                           \
+      }                                                                       \
+      for (j = 0; j < N; j++)                                                 \
+         C[i*N + j] = c[j];                                                   \
+   }                                                                          \
+}
+
+MULTIPLY_MATRICES_NXN(2)
+MULTIPLY_MATRICES_NXN(4)
+MULTIPLY_MATRICES_NXN(6)
+MULTIPLY_MATRICES_NXN(9)
+MULTIPLY_MATRICES_NXN(12)
@@ -0,0 +1,86 @@
+/**
+ * Copyright (C) 2004 RLH
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+////////////////////////////////////////////////////////////////////////////////
+// File: multiply_matrix_by_vector.c                                          //
+// Routine(s):                                                                //
+//    Multiply_Matrix_by_Vector                                               //
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+//  void Multiply_Matrix_by_Vector(double u[], double *A, int nrows,          //
+//                                                   int ncols, double v[])   //
+//                                                                            //
+//  Description:                                                              //
+//     Post multiply the nrows x ncols matrix A by the column vector v to     //
+//     form the column vector u, i.e. u = A v.                                //
+//     Each element of u is the dot product of a row of A, contiguous in     //
+//     memory, with v. Rows are taken two at a time so each element of v is  //
+//     loaded once per pair. Each element is summed in k order starting from //
+//     0, as in the plain i-j-k loop, so results are the same bit for bit.   //
+//     The memory allocated to u should not include any memory allocated to  //
+//     A or v. Static inline: for 1 or 2 rows the call would cost as much as //
+//     the product.                                                           //
+//                                                                            //
+//  Arguments:                                                                //
+//     double u[]   Pointer to the first element of the vector u.             //
+//     double *A    Pointer to the first element of the matrix A.             //
+//     int    nrows The number of rows of the matrix A and the number of      //
+//                   components of the vector u.                              //
+//     int    ncols The number of columns of the matrix A and the number of   //
+//                   components of the vector v.                              //
+//     double v[]   Pointer to the first element of the vector v.             //
+//                                                                            //
+//  Return Values:                                                            //
+//     void                                                                   //
+//                                                                            //
+//  Example:                                                                  //
+//     #define N                                                              //
+//     #define M                                                              //
+//     double A[M][N],  u[M], v[N];                                           //
+//                                                                            //
+//     (your code to initialize the matrix A and the vector v)                //
+//                                                                            //
+//     Multiply_Matrix_by_Vector(u, &A[0][0], M, N, v);                       //
+//     printf("The vector u is \n"); ...                                      //
+////////////////////////////////////////////////////////////////////////////////
+static inline void Multiply_Matrix_by_Vector(double u[], double *A, int nrows,
+                                             int ncols, double v[])
+{
+   double *pA0, *pA1;
+   double u0, u1;
+   int i,k;
+
+   for (i = 0; i + 1 < nrows; i += 2) {
+      pA0 = A + i*ncols;
+      pA1 = pA0 + ncols;
+      u0 = u1 = 0.0;
+      for (k = 0; k < ncols; k++) {
+         u0 += pA0[k] * v[k];
+         u1 += pA1[k] * v[k];
+      }
+      u[i] = u0;
+      u[i+1] = u1;
+   }
+
+   // Last row, if nrows is odd
+   if (i < nrows) {
+      pA0 = A + i*ncols;
+      u0 = 0.0;
+      for (k = 0; k < ncols; k++)
+         u0 += pA0[k] * v[k];
+      u[i] = u0;
+   }
+}
@@ -0,0 +1,55 @@
+/**
+ ******************************************************************************
+ *
+ * @file       uquad_aux_angle.c
+ * @author     Federico Favaro, Joaquin Berrutti y Lucas Falkenstein
+ * @brief      Operaciones con angulos en lote, ver uquad_aux_angle.h.
+ *
+ *****************************************************************************/
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <http://www.gnu.org/licenses/> or write to the
+ * Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "uquad_aux_angle.h"
+
+void uquad_angle_wrap_2pi_n(double *a, int n)
+{
+    int i;
+    for (i = 0; i < n; ++i)
+	a[i] = uquad_angle_wrap_2pi(a[i]);
+}
+
+void uquad_angle_wrap_pi_n(double *a, int n)
+{
+    int i;
+    for (i = 0; i < n; ++i)
+	a[i] = uquad_angle_wrap_pi(a[i]);
+}
+
+void uquad_angle_diff_n(double *d, const double *a, const double *b, int n)
+{
+    int i;
+    for (i = 0; i < n; ++i)
+	d[i] = uquad_angle_diff(a[i], b[i]);
+}
+
+double uquad_angle_unwrap_n(double *a, int n, double prev)
+{
+    int i;
+    // Cada muestra depende de la anterior, no se puede vectorizar
+    for (i = 0; i < n; ++i)
+	prev = a[i] = uquad_angle_unwrap(a[i], prev);
+    return prev;
+}
@@ -0,0 +1,137 @@
+/**
+ ******************************************************************************
+ *
+ * @file       uquad_aux_angle.h
+ * @author     Federico Favaro, Joaquin Berrutti y Lucas Falkenstein
+ * @brief      Operaciones con angulos: llevar a un rango, desenrollar y
+ *             diferencia mas corta.
+ *
+ * Todas son de tiempo constante (un floor() en lugar de lazos while) y
+ * trabajan con double, sin pasar por abs() que trunca a entero.
+ * Las funciones escalares son inline para usarlas en cada ciclo de control;
+ * las versiones en lote (sufijo _n) estan en uquad_aux_angle.c.
+ *
+ * Examples:
+ *   - src/path_planning/path_planning.c
+ *   - src/path_following/path_following.c
+ *   - src/uavtalk_parser/uavtalk_parser.c
+ *
+ *****************************************************************************/
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <http://www.gnu.org/licenses/> or write to the
+ * Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+#ifndef UQUAD_AUX_ANGLE_H
+#define UQUAD_AUX_ANGLE_H
+
+#include <math.h>
+
+#define UQUAD_ANGLE_PI		3.14159265358979323846
+#define UQUAD_ANGLE_2PI		6.28318530717958647693
+
+/**
+ * Lleva el angulo a [0, 2pi).
+ *
+ * @param a angulo en radianes
+ *
+ * @return angulo equivalente en [0, 2pi)
+ */
+static inline double uquad_angle_wrap_2pi(double a)
+{
+    double r = a - UQUAD_ANGLE_2PI*floor(a/UQUAD_ANGLE_2PI);
+    // Por redondeo un negativo muy chico puede dar justo 2pi, o quedar
+    // negativo si a/2pi da -0 (subnormales)
+    if (r >= UQUAD_ANGLE_2PI)
+	return r - UQUAD_ANGLE_2PI;
+    return (r < 0) ? 0 : r;
+}
+
+/**
+ * Lleva el angulo a [-pi, pi).
+ *
+ * @param a angulo en radianes
+ *
+ * @return angulo equivalente en [-pi, pi)
+ */
+static inline double uquad_angle_wrap_pi(double a)
+{
+    return uquad_angle_wrap_2pi(a + UQUAD_ANGLE_PI) - UQUAD_ANGLE_PI;
+}
+
+/**
+ * Diferencia mas corta a - b.
+ *
+ * @param a
+ * @param b
+ *
+ * @return a - b llevado a [-pi, pi)
+ */
+static inline double uquad_angle_diff(double a, double b)
+{
+    return uquad_angle_wrap_pi(a - b);
+}
+
+/**
+ * Desenrolla un angulo: le suma el multiplo de 2pi que lo deja mas cerca
+ * de la muestra anterior, para que una serie (ej: yaw) no salte de -pi a pi.
+ * Si ya esta a menos de pi de prev se devuelve sin cambios.
+ *
+ * @param a angulo nuevo, en cualquier rango
+ * @param prev angulo anterior, ya desenrollado
+ *
+ * @return a + 2pi*k, con |resultado - prev| <= pi
+ */
+static inline double uquad_angle_unwrap(double a, double prev)
+{
+    return a - UQUAD_ANGLE_2PI*floor((a - prev)/UQUAD_ANGLE_2PI + 0.5);
+}
+
+/**
+ * uquad_angle_wrap_2pi() sobre un arreglo, en el lugar.
+ *
+ * @param a
+ * @param n
+ */
+void uquad_angle_wrap_2pi_n(double *a, int n);
+
+/**
+ * uquad_angle_wrap_pi() sobre un arreglo, en el lugar.
+ *
+ * @param a
+ * @param n
+ */
+void uquad_angle_wrap_pi_n(double *a, int n);
+
+/**
+ * d[i] = uquad_angle_diff(a[i], b[i])
+ *
+ * @param d salida
+ * @param a
+ * @param b
+ * @param n
+ */
+void uquad_angle_diff_n(double *d, const double *a, const double *b, int n);
+
+/**
+ * Desenrolla una serie en el lugar, partiendo de prev.
+ *
+ * @param a serie de angulos
+ * @param n
+ * @param prev ultimo angulo desenrollado antes de a[0]
+ *
+ * @return ultimo angulo desenrollado (prev para la serie siguiente)
+ */
+double uquad_angle_unwrap_n(double *a, int n, double prev);
+
+#endif
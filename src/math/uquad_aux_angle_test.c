@@ -0,0 +1,138 @@
+/**
+ ******************************************************************************
+ *
+ * @file       uquad_aux_angle_test.c
+ * @author     Federico Favaro, Joaquin Berrutti y Lucas Falkenstein
+ * @brief      Prueba de las operaciones con angulos de uquad_aux_angle.h:
+ *             casos borde (0, -0, valores muy chicos, +-pi, +-2pi, valores
+ *             grandes) y continuidad al desenrollar una serie.
+ *
+ * Uso: ./uquad_aux_angle_test
+ * Devuelve 0 si pasan todas las pruebas, -1 si no.
+ *
+ *****************************************************************************/
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <http://www.gnu.org/licenses/> or write to the
+ * Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "uquad_aux_angle.h"
+
+#include <stdio.h>
+#include <float.h>
+
+#define TEST_TOL	1e-12
+#define TEST_SERIE	10000	// muestras de la serie a desenrollar
+
+static int fallas = 0;
+
+static void test_verificar(int ok, const char *nombre, double a, double r)
+{
+    if (ok)
+	return;
+    printf("FALLA %-12s a = %.17g -> %.17g\n", nombre, a, r);
+    fallas++;
+}
+
+/* Mismo angulo: la diferencia es multiplo de 2pi. El error de redondeo
+ * crece con el modulo de a, por eso la tolerancia es relativa */
+static int test_equivalente(double a, double r)
+{
+    double tol = TEST_TOL + 8*DBL_EPSILON*fabs(a);
+    return fabs(uquad_angle_wrap_pi(a - r)) <= tol;
+}
+
+/* Rango y equivalencia de las funciones que llevan a un rango */
+static void test_wrap(double a)
+{
+    double r;
+
+    r = uquad_angle_wrap_2pi(a);
+    test_verificar(r >= 0 && r < UQUAD_ANGLE_2PI, "wrap_2pi", a, r);
+    test_verificar(test_equivalente(a, r), "wrap_2pi eq", a, r);
+
+    r = uquad_angle_wrap_pi(a);
+    test_verificar(r >= -UQUAD_ANGLE_PI && r < UQUAD_ANGLE_PI, "wrap_pi", a, r);
+    test_verificar(test_equivalente(a, r), "wrap_pi eq", a, r);
+}
+
+/* Valores exactos esperados */
+static void test_valor(const char *nombre, double a, double r, double esperado)
+{
+    test_verificar(fabs(r - esperado) <= TEST_TOL, nombre, a, r);
+}
+
+int main(void)
+{
+    const double casos[] = {
+	0.0, -0.0, DBL_MIN, -DBL_MIN, 4.9e-324, -4.9e-324, 1e-300, -1e-300,
+	1e-17, -1e-17, DBL_EPSILON, -DBL_EPSILON,
+	UQUAD_ANGLE_PI, -UQUAD_ANGLE_PI, UQUAD_ANGLE_2PI, -UQUAD_ANGLE_2PI,
+	nextafter(UQUAD_ANGLE_PI, 0), nextafter(-UQUAD_ANGLE_PI, 0),
+	nextafter(UQUAD_ANGLE_2PI, 0), nextafter(UQUAD_ANGLE_2PI, 10),
+	nextafter(-UQUAD_ANGLE_2PI, 0), nextafter(-UQUAD_ANGLE_2PI, -10),
+	3*UQUAD_ANGLE_PI, -3*UQUAD_ANGLE_PI, 100*UQUAD_ANGLE_2PI, -100*UQUAD_ANGLE_2PI,
+	1e3, -1e3, 1e6, -1e6, 1e9, -1e9, 1e15, -1e15, 1e20, -1e20
+    };
+    double serie[TEST_SERIE], real, prev, u;
+    int i, n = sizeof(casos)/sizeof(casos[0]);
+
+    for (i = 0; i < n; i++)
+	test_wrap(casos[i]);
+
+    // Valores conocidos
+    test_valor("wrap_2pi", 0.0, uquad_angle_wrap_2pi(0.0), 0.0);
+    test_valor("wrap_2pi", -0.0, uquad_angle_wrap_2pi(-0.0), 0.0);
+    test_valor("wrap_2pi", -1e-17, uquad_angle_wrap_2pi(-1e-17), 0.0);
+    test_valor("wrap_2pi", UQUAD_ANGLE_2PI, uquad_angle_wrap_2pi(UQUAD_ANGLE_2PI), 0.0);
+    test_valor("wrap_2pi", -UQUAD_ANGLE_2PI, uquad_angle_wrap_2pi(-UQUAD_ANGLE_2PI), 0.0);
+    test_valor("wrap_2pi", -UQUAD_ANGLE_PI/2, uquad_angle_wrap_2pi(-UQUAD_ANGLE_PI/2), 1.5*UQUAD_ANGLE_PI);
+    test_valor("wrap_pi", UQUAD_ANGLE_PI, uquad_angle_wrap_pi(UQUAD_ANGLE_PI), -UQUAD_ANGLE_PI);
+    test_valor("wrap_pi", -UQUAD_ANGLE_PI, uquad_angle_wrap_pi(-UQUAD_ANGLE_PI), -UQUAD_ANGLE_PI);
+    test_valor("wrap_pi", 3*UQUAD_ANGLE_PI/2, uquad_angle_wrap_pi(3*UQUAD_ANGLE_PI/2), -UQUAD_ANGLE_PI/2);
+    test_valor("diff", UQUAD_ANGLE_PI - 0.1, uquad_angle_diff(UQUAD_ANGLE_PI - 0.1, -UQUAD_ANGLE_PI + 0.1), -0.2);
+    test_valor("diff", -UQUAD_ANGLE_PI + 0.1, uquad_angle_diff(-UQUAD_ANGLE_PI + 0.1, UQUAD_ANGLE_PI - 0.1), 0.2);
+    test_valor("unwrap", 0.0, uquad_angle_unwrap(0.0, 0.0), 0.0);
+    test_valor("unwrap", -UQUAD_ANGLE_PI + 0.1, uquad_angle_unwrap(-UQUAD_ANGLE_PI + 0.1, UQUAD_ANGLE_PI - 0.1), UQUAD_ANGLE_PI + 0.1);
+    test_valor("unwrap", 0.5, uquad_angle_unwrap(0.5, 1e3*UQUAD_ANGLE_2PI), 1e3*UQUAD_ANGLE_2PI + 0.5);
+
+    // Yaw que gira varias vueltas en los dos sentidos, medido en [-pi, pi)
+    for (i = 0; i < TEST_SERIE; i++) {
+	real = 40*sin(i*1e-3) + 0.3*i*1e-2;
+	serie[i] = uquad_angle_wrap_pi(real);
+    }
+    prev = serie[0];
+    u = uquad_angle_unwrap_n(serie, TEST_SERIE, prev);
+    test_verificar(u == serie[TEST_SERIE - 1], "unwrap_n", prev, u);
+    for (i = 1; i < TEST_SERIE; i++) {
+	test_verificar(fabs(serie[i] - serie[i-1]) <= UQUAD_ANGLE_PI, "continuidad", serie[i-1], serie[i]);
+	real = 40*sin(i*1e-3) + 0.3*i*1e-2;
+	test_verificar(fabs(serie[i] - real) <= 1e-9, "unwrap real", real, serie[i]);
+    }
+
+    // Las versiones en lote dan lo mismo que las escalares
+    for (i = 0; i < n; i++)
+	serie[i] = casos[i];
+    uquad_angle_wrap_2pi_n(serie, n);
+    for (i = 0; i < n; i++)
+	test_verificar(serie[i] == uquad_angle_wrap_2pi(casos[i]), "wrap_2pi_n", casos[i], serie[i]);
+    for (i = 0; i < n; i++)
+	serie[i] = casos[i];
+    uquad_angle_wrap_pi_n(serie, n);
+    for (i = 0; i < n; i++)
+	test_verificar(serie[i] == uquad_angle_wrap_pi(casos[i]), "wrap_pi_n", casos[i], serie[i]);
+
+    printf("%s: %d fallas\n", (fallas == 0) ? "OK" : "ERROR", fallas);
+    return (fallas == 0) ? 0 : -1;
+}
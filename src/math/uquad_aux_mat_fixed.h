@@ -0,0 +1,400 @@
+/**
+ * uquad_aux_mat_fixed: fixed size matrices for uquad_aux_math
+ * Copyright (C) 2012  Rodrigo Rosa <rodrigorosa.lg gmail.com>, Matias Tailanian <matias tailanian.com>, Santiago Paternain <spaternain gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @file   uquad_aux_mat_fixed.h
+ *
+ * @brief  fixed size matrices, no malloc
+ *
+ * uquad_mat_t is allocated on the heap, and its size is only known at run
+ * time. The types in this file carry their size in the type, so they can
+ * live on the stack or inside other structs, and the kernels are inlined
+ * with constant loop bounds.
+ *
+ * Semantics follow the uquad_mat_* API: result first, then operands, and
+ * an int error code is returned. Dimensions are checked by the compiler,
+ * so only inv/solve can fail (singular matrix).
+ *
+ * Types: uquad_mat<r>x<c>_t, element [i][j] is M.m[i][j].
+ *
+ * Example of usage:
+ *   uquad_mat3x3_t K;
+ *   uquad_mat3x1_t v, Kv;
+ *   uquad_mat3x3_eye(&K);
+ *   uquad_mat3x1_fill(&v, 1.0);
+ *   uquad_mat_prod_3x3_3x1(&Kv, &K, &v);
+ *
+ * To use a fixed size matrix with the uquad_mat_* API, see uquad_mat_wrap().
+ */
+#ifndef UQUAD_AUX_MAT_FIXED_H
+#define UQUAD_AUX_MAT_FIXED_H
+
+#include <math.h>
+#include <uquad_aux_math.h>
+
+/// Flat access, as in uquad_mat_t.m_full
+#define uquad_matf_full(M)	(&(M)->m[0][0])
+
+/**
+ * -- -- -- -- -- -- -- -- -- -- -- --
+ * Generators
+ * -- -- -- -- -- -- -- -- -- -- -- --
+ */
+
+/**
+ * Type and element-wise kernels for RxC matrices:
+ *   zeros, fill, copy, add, sub, scalar_mul, scalar_div,
+ *   dot_product, norm.
+ *
+ * scalar_mul/scalar_div/dot_product work in place if M (A and B) is NULL,
+ * as the uquad_mat_* versions do.
+ */
+#define UQUAD_MATF_DEFINE(R,C)						\
+    typedef struct uquad_mat##R##x##C {					\
+	double m[R][C];							\
+    } uquad_mat##R##x##C##_t;						\
+									\
+    static inline int uquad_mat##R##x##C##_zeros(uquad_mat##R##x##C##_t *A) \
+    {									\
+	int i;								\
+	for(i = 0; i < R*C; ++i)					\
+	    uquad_matf_full(A)[i] = 0.0;				\
+	return ERROR_OK;						\
+    }									\
+									\
+    static inline int uquad_mat##R##x##C##_fill(uquad_mat##R##x##C##_t *A, double val) \
+    {									\
+	int i;								\
+	for(i = 0; i < R*C; ++i)					\
+	    uquad_matf_full(A)[i] = val;				\
+	return ERROR_OK;						\
+    }									\
+									\
+    static inline int uquad_mat##R##x##C##_copy(uquad_mat##R##x##C##_t *dest, \
+						 const uquad_mat##R##x##C##_t *src) \
+    {									\
+	*dest = *src;							\
+	return ERROR_OK;						\
+    }									\
+									\
+    static inline int uquad_mat##R##x##C##_add(uquad_mat##R##x##C##_t *Cm,	\
+						const uquad_mat##R##x##C##_t *A, \
+						const uquad_mat##R##x##C##_t *B) \
+    {									\
+	int i;								\
+	for(i = 0; i < R*C; ++i)					\
+	    uquad_matf_full(Cm)[i] = uquad_matf_full(A)[i] + uquad_matf_full(B)[i]; \
+	return ERROR_OK;						\
+    }									\
+									\
+    static inline int uquad_mat##R##x##C##_sub(uquad_mat##R##x##C##_t *Cm,	\
+						const uquad_mat##R##x##C##_t *A, \
+						const uquad_mat##R##x##C##_t *B) \
+    {									\
+	int i;								\
+	for(i = 0; i < R*C; ++i)					\
+	    uquad_matf_full(Cm)[i] = uquad_matf_full(A)[i] - uquad_matf_full(B)[i]; \
+	return ERROR_OK;						\
+    }									\
+									\
+    static inline int uquad_mat##R##x##C##_scalar_mul(uquad_mat##R##x##C##_t *Mk, \
+						       const uquad_mat##R##x##C##_t *M, \
+						       double k)	\
+    {									\
+	int i;								\
+	if(M == NULL)							\
+	    M = Mk;							\
+	for(i = 0; i < R*C; ++i)					\
+	    uquad_matf_full(Mk)[i] = uquad_matf_full(M)[i]*k;		\
+	return ERROR_OK;						\
+    }									\
+									\
+    static inline int uquad_mat##R##x##C##_scalar_div(uquad_mat##R##x##C##_t *Mk, \
+						       const uquad_mat##R##x##C##_t *M, \
+						       double k)	\
+    {									\
+	if(k == 0.0)							\
+	{								\
+	    err_check(ERROR_MATH_DIV_0,"Cannot divide by 0!");		\
+	}								\
+	return uquad_mat##R##x##C##_scalar_mul(Mk, M, 1.0/k);		\
+    }									\
+									\
+    static inline int uquad_mat##R##x##C##_dot_product(uquad_mat##R##x##C##_t *Cm, \
+							const uquad_mat##R##x##C##_t *A, \
+							const uquad_mat##R##x##C##_t *B) \
+    {									\
+	int i;								\
+	if(A == NULL && B == NULL)					\
+	    A = B = Cm;							\
+	for(i = 0; i < R*C; ++i)					\
+	    uquad_matf_full(Cm)[i] = uquad_matf_full(A)[i]*uquad_matf_full(B)[i]; \
+	return ERROR_OK;						\
+    }									\
+									\
+    static inline double uquad_mat##R##x##C##_norm(const uquad_mat##R##x##C##_t *A) \
+    {									\
+	int i;								\
+	double norm = 0;						\
+	for(i = 0; i < R*C; ++i)					\
+	    norm += uquad_matf_full(A)[i]*uquad_matf_full(A)[i];	\
+	return sqrt(norm);						\
+    }
+
+/**
+ * Transpose, RxC to CxR. Both types must be defined.
+ */
+#define UQUAD_MATF_DEFINE_TRANSPOSE(R,C)				\
+    static inline int uquad_mat##R##x##C##_transpose(uquad_mat##C##x##R##_t *Mt, \
+						      const uquad_mat##R##x##C##_t *M) \
+    {									\
+	int i,j;							\
+	for(i = 0; i < R; ++i)						\
+	    for(j = 0; j < C; ++j)					\
+		Mt->m[j][i] = M->m[i][j];				\
+	return ERROR_OK;						\
+    }
+
+/**
+ * Square NxN matrices, on top of UQUAD_MATF_DEFINE(N,N):
+ *   eye, diag, transpose_inplace, inv.
+ *
+ * inv uses Gauss-Jordan with partial pivoting on a copy of M, so Minv and
+ * M may be the same matrix. Returns ERROR_MATH_MAT_SING if M is singular,
+ * leaving Minv untouched.
+ */
+#define UQUAD_MATF_DEFINE_SQUARE(N)					\
+    static inline int uquad_mat##N##x##N##_eye(uquad_mat##N##x##N##_t *A) \
+    {									\
+	int i;								\
+	uquad_mat##N##x##N##_zeros(A);					\
+	for(i = 0; i < N; ++i)						\
+	    A->m[i][i] = 1.0;						\
+	return ERROR_OK;						\
+    }									\
+									\
+    static inline int uquad_mat##N##x##N##_diag(uquad_mat##N##x##N##_t *A, const double *diag) \
+    {									\
+	int i;								\
+	uquad_mat##N##x##N##_zeros(A);					\
+	for(i = 0; i < N; ++i)						\
+	    A->m[i][i] = diag[i];					\
+	return ERROR_OK;						\
+    }									\
+									\
+    static inline int uquad_mat##N##x##N##_transpose_inplace(uquad_mat##N##x##N##_t *A) \
+    {									\
+	int i,j;							\
+	double tmp;							\
+	for(i = 0; i < N; ++i)						\
+	    for(j = i + 1; j < N; ++j)					\
+	    {								\
+		tmp = A->m[i][j];					\
+		A->m[i][j] = A->m[j][i];				\
+		A->m[j][i] = tmp;					\
+	    }								\
+	return ERROR_OK;						\
+    }									\
+									\
+    static inline int uquad_mat##N##x##N##_inv(uquad_mat##N##x##N##_t *Minv, \
+						const uquad_mat##N##x##N##_t *M) \
+    {									\
+	uquad_mat##N##x##N##_t a = *M, x;				\
+	int i,j,k,p;							\
+	double tmp;							\
+	uquad_mat##N##x##N##_eye(&x);					\
+	for(k = 0; k < N; ++k)						\
+	{								\
+	    /* pivot */							\
+	    p = k;							\
+	    for(i = k + 1; i < N; ++i)					\
+		if(uquad_abs(a.m[i][k]) > uquad_abs(a.m[p][k]))		\
+		    p = i;						\
+	    if(a.m[p][k] == 0.0)					\
+	    {								\
+		err_check(ERROR_MATH_MAT_SING,"Matrix is singular!");	\
+	    }								\
+	    if(p != k)							\
+		for(j = 0; j < N; ++j)					\
+		{							\
+		    tmp = a.m[k][j]; a.m[k][j] = a.m[p][j]; a.m[p][j] = tmp; \
+		    tmp = x.m[k][j]; x.m[k][j] = x.m[p][j]; x.m[p][j] = tmp; \
+		}							\
+	    /* normalize row k, eliminate column k from the rest */	\
+	    tmp = 1.0/a.m[k][k];					\
+	    for(j = 0; j < N; ++j)					\
+	    {								\
+		a.m[k][j] *= tmp;					\
+		x.m[k][j] *= tmp;					\
+	    }								\
+	    for(i = 0; i < N; ++i)					\
+	    {								\
+		if(i == k)						\
+		    continue;						\
+		tmp = a.m[i][k];					\
+		for(j = 0; j < N; ++j)					\
+		{							\
+		    a.m[i][j] -= tmp*a.m[k][j];				\
+		    x.m[i][j] -= tmp*x.m[k][j];				\
+		}							\
+	    }								\
+	}								\
+	*Minv = x;							\
+	return ERROR_OK;						\
+    }
+
+/**
+ * Product C = A*B, A is RxK and B is KxC. The three types must be defined.
+ * C must not be A or B (same as uquad_mat_prod()).
+ */
+#define UQUAD_MATF_DEFINE_PROD(R,K,C)					\
+    static inline int uquad_mat_prod_##R##x##K##_##K##x##C(uquad_mat##R##x##C##_t *Cm, \
+							    const uquad_mat##R##x##K##_t *A, \
+							    const uquad_mat##K##x##C##_t *B) \
+    {									\
+	int i,j,k;							\
+	double acc;							\
+	for(i = 0; i < R; ++i)						\
+	    for(j = 0; j < C; ++j)					\
+	    {								\
+		acc = 0.0;						\
+		for(k = 0; k < K; ++k)					\
+		    acc += A->m[i][k]*B->m[k][j];			\
+		Cm->m[i][j] = acc;					\
+	    }								\
+	return ERROR_OK;						\
+    }
+
+/**
+ * -- -- -- -- -- -- -- -- -- -- -- --
+ * Sizes used in uQuad
+ * -- -- -- -- -- -- -- -- -- -- -- --
+ */
+UQUAD_MATF_DEFINE(1,1)
+UQUAD_MATF_DEFINE(3,1)
+UQUAD_MATF_DEFINE(1,3)
+UQUAD_MATF_DEFINE(3,3)
+UQUAD_MATF_DEFINE(4,1)
+UQUAD_MATF_DEFINE(4,4)
+UQUAD_MATF_DEFINE(6,1)
+UQUAD_MATF_DEFINE(6,6)
+UQUAD_MATF_DEFINE(9,1)
+UQUAD_MATF_DEFINE(9,9)
+
+UQUAD_MATF_DEFINE_TRANSPOSE(3,1)
+UQUAD_MATF_DEFINE_TRANSPOSE(1,3)
+
+UQUAD_MATF_DEFINE_SQUARE(3)
+UQUAD_MATF_DEFINE_SQUARE(4)
+UQUAD_MATF_DEFINE_SQUARE(6)
+UQUAD_MATF_DEFINE_SQUARE(9)
+
+UQUAD_MATF_DEFINE_PROD(3,3,1)
+UQUAD_MATF_DEFINE_PROD(3,3,3)
+UQUAD_MATF_DEFINE_PROD(3,1,3)
+UQUAD_MATF_DEFINE_PROD(1,3,1)
+UQUAD_MATF_DEFINE_PROD(4,4,1)
+UQUAD_MATF_DEFINE_PROD(4,4,4)
+UQUAD_MATF_DEFINE_PROD(6,6,1)
+UQUAD_MATF_DEFINE_PROD(6,6,6)
+UQUAD_MATF_DEFINE_PROD(9,9,1)
+UQUAD_MATF_DEFINE_PROD(9,9,9)
+
+/**
+ * Solves A*x = B for a 3x3 system, see uquad_solve_lin().
+ *
+ * @return error code, ERROR_MATH_MAT_SING if A is singular.
+ */
+static inline int uquad_solve_lin_3x3(const uquad_mat3x3_t *A, const uquad_mat3x1_t *B, uquad_mat3x1_t *x)
+{
+    uquad_mat3x3_t Ainv;
+    int retval = uquad_mat3x3_inv(&Ainv, A);
+    err_propagate(retval);
+    return uquad_mat_prod_3x3_3x1(x, &Ainv, B);
+}
+
+/**
+ * Builds the rotation matrix used by uquad_mat_rotate(), see
+ * uquad_aux_math.h for the definition.
+ *
+ * @param R answer
+ * @param from_inertial
+ * @param psi
+ * @param phi
+ * @param theta
+ *
+ * @return error code
+ */
+static inline int uquad_mat3x3_rotation(uquad_mat3x3_t *R, uquad_bool_t from_inertial,
+					double psi, double phi, double theta)
+{
+    double
+	cpsi = cos(psi), spsi = sin(psi),
+	cphi = cos(phi), sphi = sin(phi),
+	ctheta = cos(theta), stheta = sin(theta);
+    if(from_inertial)
+    {
+	R->m[0][0] = cphi*ctheta;
+	R->m[0][1] = cphi*stheta;
+	R->m[0][2] = -sphi;
+
+	R->m[1][0] = ctheta*spsi*sphi - cpsi*stheta;
+	R->m[1][1] = cpsi*ctheta + spsi*sphi*stheta;
+	R->m[1][2] = cphi*spsi;
+
+	R->m[2][0] = spsi*stheta + cpsi*ctheta*sphi;
+	R->m[2][1] = cpsi*sphi*stheta - ctheta*spsi;
+	R->m[2][2] = cpsi*cphi;
+    }
+    else
+    {
+	R->m[0][0] = cphi*ctheta;
+	R->m[0][1] = ctheta*sphi*spsi - cpsi*stheta;
+	R->m[0][2] = spsi*stheta + cpsi*ctheta*sphi;
+
+	R->m[1][0] = cphi*stheta;
+	R->m[1][1] = cpsi*ctheta + sphi*spsi*stheta;
+	R->m[1][2] = cpsi*sphi*stheta - ctheta*spsi;
+
+	R->m[2][0] = -sphi;
+	R->m[2][1] = cphi*spsi;
+	R->m[2][2] = cphi*cpsi;
+    }
+    return ERROR_OK;
+}
+
+/**
+ * Fixed size version of uquad_mat_rotate(): Vr = R*V
+ *
+ * @param from_inertial
+ * @param Vr answer
+ * @param V
+ * @param psi
+ * @param phi
+ * @param theta
+ *
+ * @return error code
+ */
+static inline int uquad_mat3x1_rotate(uquad_bool_t from_inertial,
+				      uquad_mat3x1_t *Vr, const uquad_mat3x1_t *V,
+				      double psi, double phi, double theta)
+{
+    uquad_mat3x3_t R;
+    uquad_mat3x3_rotation(&R, from_inertial, psi, phi, theta);
+    return uquad_mat_prod_3x3_3x1(Vr, &R, V);
+}
+
+#endif //UQUAD_AUX_MAT_FIXED_H
@@ -23,6 +23,7 @@
  *
  */
 #include "uquad_aux_math.h"
+#include "uquad_aux_mat_fixed.h"
 #include <stdlib.h>
 
 /**
@@ -45,7 +46,9 @@
 #include "subtract_matrices.c"
 #include "subtract_matrices_3x3.h"
 #include "multiply_matrices.c"
+#include "multiply_matrix_by_vector.c"
 #include "multiply_matrices_3x3.c"
+#include "multiply_matrices_nxn.c"
 #include "gauss_elimination.c"
 #include "gauss_aux_elimination.c"
 #include "transpose_matrix.c"
@@ -56,7 +59,34 @@
 //#include "hessenberg_orthog.c"
 //#include "qr_hessenberg_matrix.c"
 //#include "doolittle.c"
-//#include "doolittle_pivot.c"
+#include "doolittle_pivot.c"
+
+/// Arena for aux memory, see uquad_mat_set_scratch()
+static __thread uquad_mat_arena_t *scratch_arena = NULL;
+
+/**
+ * Aux matrix: from the scratch arena if there is one and it fits,
+ * otherwise malloc. Release with uquad_mat_free() in both cases.
+ */
+static uquad_mat_t *uquad_mat_scratch(int r, int c)
+{
+    uquad_mat_t *m = NULL;
+    if(scratch_arena != NULL)
+	m = uquad_mat_alloc_arena(scratch_arena, r, c);
+    if(m == NULL)
+	m = uquad_mat_alloc(r, c);
+    return m;
+}
+
+static size_t scratch_mark(void)
+{
+    return uquad_mat_arena_mark(scratch_arena);
+}
+
+static void scratch_release(size_t mark)
+{
+    uquad_mat_arena_release(scratch_arena, mark);
+}
 
 int uquad_mat_prod(uquad_mat_t *C, uquad_mat_t *A,uquad_mat_t *B)
 {
@@ -70,21 +100,104 @@ int uquad_mat_prod(uquad_mat_t *C, uquad_mat_t *A,uquad_mat_t *B)
     {
 	err_check(ERROR_MATH_MAT_DIM,"Cannot multiply matrices, dims do not match.");
     }
-    if(C->c == 3 && C->r == 3)
-	Multiply_Matrices_3x3(C->m_full,A->m_full,B->m_full);
-    else
-	Multiply_Matrices(C->m_full,A->m_full,A->r,A->c,B->m_full,B->c);
+    if(C->c == 1)
+    {
+	// matrix times vector, too thin for the 2x4 tiles
+	Multiply_Matrix_by_Vector(C->m_full,A->m_full,A->r,A->c,B->m_full);
+	return ERROR_OK;
+    }
+    if(C->c == C->r && A->c == C->c)
+    {
+	// square, unrolled versions for common sizes
+	switch(C->c)
+	{
+	case 2:
+	    Multiply_Matrices_2x2(C->m_full,A->m_full,B->m_full);
+	    return ERROR_OK;
+	case 3:
+	    Multiply_Matrices_3x3(C->m_full,A->m_full,B->m_full);
+	    return ERROR_OK;
+	case 4:
+	    Multiply_Matrices_4x4(C->m_full,A->m_full,B->m_full);
+	    return ERROR_OK;
+	case 6:
+	    Multiply_Matrices_6x6(C->m_full,A->m_full,B->m_full);
+	    return ERROR_OK;
+	case 9:
+	    Multiply_Matrices_9x9(C->m_full,A->m_full,B->m_full);
+	    return ERROR_OK;
+	case 12:
+	    Multiply_Matrices_12x12(C->m_full,A->m_full,B->m_full);
+	    return ERROR_OK;
+	default:
+	    break;
+	}
+    }
+    Multiply_Matrices(C->m_full,A->m_full,A->r,A->c,B->m_full,B->c);
     return ERROR_OK;
 }
 
 int uquad_mat_det(uquad_mat_t *m, double *res)
 {
-    //TODO use LU
+    int i, retval = ERROR_OK;
+    size_t mark = scratch_mark();
+    uquad_mat_t *LU = NULL, LU_stack;
+    double *LU_rows[UQUAD_MAT_STACK_DIM];
+    double LU_data[UQUAD_MAT_STACK_DIM*UQUAD_MAT_STACK_DIM];
+    int pivot_stack[UQUAD_MAT_STACK_DIM], *pivot = NULL;
     if(m == NULL || res == NULL)
     {
 	err_check(ERROR_NULL_POINTER,"NULL pointer is invalid arg.");
     }
-    err_check(ERROR_FAIL,"Not implemented!");
+    if(m->r != m->c)
+    {
+	err_check(ERROR_MATH_MAT_DIM,"Determinant requires a square matrix!");
+    }
+
+    if(m->r <= UQUAD_MAT_STACK_DIM)
+    {
+	// small matrix, aux mem on the stack
+	uquad_mat_wrap(&LU_stack, LU_rows, LU_data, m->r, m->c);
+	LU = &LU_stack;
+	pivot = pivot_stack;
+    }
+    else
+    {
+	LU = uquad_mat_scratch(m->r,m->c);
+	pivot = (int *)malloc(m->r*sizeof(int));
+	if(LU == NULL || pivot == NULL)
+	{
+	    retval = ERROR_MALLOC;
+	    cleanup_log_if(retval,"Could not allocate aux mem for det.");
+	}
+    }
+
+    retval = uquad_mat_copy(LU, m);
+    cleanup_if(retval);
+    if(Doolittle_LU_Decomposition_with_Pivoting(LU->m_full, pivot, LU->r) < 0)
+    {
+	*res = 0.0;
+	goto cleanup;
+    }
+
+    // det(M) = det(P')*det(L)*det(U), det(L) = 1
+    *res = 1.0;
+    for(i = 0; i < LU->r; ++i)
+    {
+	*res *= LU->m[i][i];
+	if(pivot[i] != i)
+	    *res = -*res;
+    }
+
+    cleanup:
+    if(LU != &LU_stack)
+    {
+	uquad_mat_free(LU);
+	free(pivot);
+    }
+    scratch_release(mark);
+
+    return retval;
 }
 
 int uquad_mat_scalar_mul(uquad_mat_t *Mk, uquad_mat_t *M, double k)
@@ -181,6 +294,10 @@ int uquad_solve_lin(uquad_mat_t *A, uquad_mat_t *B, uquad_mat_t *x, uquad_mat_t
 {
     int retval;
     uquad_bool_t local_mem = false;
+    size_t mark = scratch_mark();
+    uquad_mat_t maux_stack;
+    double *maux_rows[UQUAD_MAT_STACK_DIM];
+    double maux_data[UQUAD_MAT_STACK_DIM*2*UQUAD_MAT_STACK_DIM];
     if(A == NULL || B == NULL)
     {
 	err_check(ERROR_NULL_POINTER,"NULL pointer is invalid arg.");
@@ -193,10 +310,18 @@ int uquad_solve_lin(uquad_mat_t *A, uquad_mat_t *B, uquad_mat_t *x, uquad_mat_t
 	err_check(ERROR_MATH_MAT_DIM,"Dimension mismatch, cannot solve");
     }
 
-    if(maux == NULL)
+    if(maux == NULL &&
+       A->r <= UQUAD_MAT_STACK_DIM &&
+       A->r*(A->c + B->c) <= UQUAD_MAT_STACK_DIM*2*UQUAD_MAT_STACK_DIM)
+    {
+	// small system, aux matrix on the stack
+	uquad_mat_wrap(&maux_stack, maux_rows, maux_data, A->r, A->c + B->c);
+	maux = &maux_stack;
+    }
+    else if(maux == NULL)
     {
 	// create aux matrix
-	maux = uquad_mat_alloc(A->r,A->c + B->c);
+	maux = uquad_mat_scratch(A->r,A->c + B->c);
 	if(maux == NULL)
 	{
 	    err_check(ERROR_MALLOC,"Could not allocate aux mem for lin solve.");
@@ -275,6 +400,7 @@ int uquad_solve_lin(uquad_mat_t *A, uquad_mat_t *B, uquad_mat_t *x, uquad_mat_t
     if(local_mem)
 	// free tmp memory
 	uquad_mat_free(maux);
+    scratch_release(mark);
     
     return ERROR_OK;
 }
@@ -403,6 +529,11 @@ int uquad_mat_inv(uquad_mat_t *Minv, uquad_mat_t *M, uquad_mat_t *Meye, uquad_ma
 {
     int retval;
     uquad_bool_t local_Meye = false, local_Maux = false;
+    size_t mark = scratch_mark();
+    uquad_mat_t Meye_stack, Maux_stack;
+    double *Meye_rows[UQUAD_MAT_STACK_DIM], *Maux_rows[UQUAD_MAT_STACK_DIM];
+    double Meye_data[UQUAD_MAT_STACK_DIM*UQUAD_MAT_STACK_DIM];
+    double Maux_data[UQUAD_MAT_STACK_DIM*2*UQUAD_MAT_STACK_DIM];
     if(M == NULL || Minv == NULL)
     {
 	err_check(ERROR_NULL_POINTER,"NULL pointer is invalid arg.");
@@ -413,9 +544,24 @@ int uquad_mat_inv(uquad_mat_t *Minv, uquad_mat_t *M, uquad_mat_t *Meye, uquad_ma
 	err_check(ERROR_MATH_MAT_DIM,"Cannot invert non-square matrix!");
     }
 
+    if(M->r <= UQUAD_MAT_STACK_DIM)
+    {
+	// small matrix, aux mem on the stack
+	if(Meye == NULL)
+	{
+	    uquad_mat_wrap(&Meye_stack, Meye_rows, Meye_data, M->r, M->c);
+	    Meye = &Meye_stack;
+	}
+	if(Maux == NULL)
+	{
+	    uquad_mat_wrap(&Maux_stack, Maux_rows, Maux_data, M->r, (M->c)<<1);
+	    Maux = &Maux_stack;
+	}
+    }
+
     if(Meye == NULL)
     {
-	Meye = uquad_mat_alloc(M->r,M->c);
+	Meye = uquad_mat_scratch(M->r,M->c);
 	if(Meye == NULL)
 	{
 	    retval = ERROR_MALLOC;
@@ -429,7 +575,7 @@ int uquad_mat_inv(uquad_mat_t *Minv, uquad_mat_t *M, uquad_mat_t *Meye, uquad_ma
 
     if(Maux == NULL)
     {
-	Maux = uquad_mat_alloc(M->r,(M->c)<<1);
+	Maux = uquad_mat_scratch(M->r,(M->c)<<1);
 	if(Maux == NULL)
 	{
 	    retval = ERROR_MALLOC;
@@ -446,10 +592,181 @@ int uquad_mat_inv(uquad_mat_t *Minv, uquad_mat_t *M, uquad_mat_t *Meye, uquad_ma
 	uquad_mat_free(Meye);
     if(local_Maux)
 	uquad_mat_free(Maux);
+    scratch_release(mark);
+
+    return retval;
+}
+
+int uquad_mat_lu(uquad_mat_t *LU, int *pivot, uquad_mat_t *M)
+{
+    int retval;
+    if(LU == NULL || pivot == NULL || M == NULL)
+    {
+	err_check(ERROR_NULL_POINTER,"NULL pointer is invalid arg.");
+    }
+    if(M->r != M->c || LU->r != M->r || LU->c != M->c)
+    {
+	err_check(ERROR_MATH_MAT_DIM,"LU requires square matrices of the same size!");
+    }
+
+    if(LU != M)
+    {
+	retval = uquad_mat_copy(LU, M);
+	err_propagate(retval);
+    }
+    retval = Doolittle_LU_Decomposition_with_Pivoting(LU->m_full, pivot, LU->r);
+    if(retval < 0)
+    {
+	err_check(ERROR_MATH_MAT_SING,"Matrix is singular, cannot factor.");
+    }
+    return ERROR_OK;
+}
+
+int uquad_mat_lu_solve(uquad_mat_t *x, uquad_mat_t *LU, int *pivot, uquad_mat_t *B)
+{
+    int i, j, n, retval = ERROR_OK;
+    size_t mark;
+    uquad_mat_t *aux = NULL;
+    double aux_stack[UQUAD_MAT_STACK_DIM<<1];
+    double *b, *xj;
+    if(x == NULL || LU == NULL || pivot == NULL || B == NULL)
+    {
+	err_check(ERROR_NULL_POINTER,"NULL pointer is invalid arg.");
+    }
+    if(LU->r != LU->c ||
+       B->r != LU->r ||
+       x->r != B->r ||
+       x->c != B->c)
+    {
+	err_check(ERROR_MATH_MAT_DIM,"Dimension mismatch, cannot solve");
+    }
+
+    n = LU->r;
+    if(B->c == 1 && x != B)
+    {
+	// single column, B is restored after solving
+	retval = Doolittle_LU_with_Pivoting_Solve(LU->m_full, B->m_full, pivot, x->m_full, n);
+	if(retval < 0)
+	{
+	    err_check(ERROR_MATH_MAT_SING,"LU is singular, cannot solve.");
+	}
+	return ERROR_OK;
+    }
+
+    // solve column by column, using aux mem for b and x
+    mark = scratch_mark();
+    if(n <= UQUAD_MAT_STACK_DIM)
+    {
+	b = aux_stack;
+    }
+    else
+    {
+	aux = uquad_mat_scratch(n<<1,1);
+	if(aux == NULL)
+	{
+	    retval = ERROR_MALLOC;
+	    cleanup_log_if(retval,"Could not allocate aux mem for LU solve.");
+	}
+	b = aux->m_full;
+    }
+    xj = b + n;
+    for(j = 0; j < B->c; ++j)
+    {
+	for(i = 0; i < n; ++i)
+	    b[i] = B->m[i][j];
+	if(Doolittle_LU_with_Pivoting_Solve(LU->m_full, b, pivot, xj, n) < 0)
+	{
+	    retval = ERROR_MATH_MAT_SING;
+	    cleanup_log_if(retval,"LU is singular, cannot solve.");
+	}
+	for(i = 0; i < n; ++i)
+	    x->m[i][j] = xj[i];
+    }
+
+    cleanup:
+    if(aux != NULL)
+	uquad_mat_free(aux);
+    scratch_release(mark);
 
     return retval;
 }
 
+int uquad_mat_chol(uquad_mat_t *L, uquad_mat_t *M)
+{
+    int i, j, k;
+    double sum;
+    if(L == NULL || M == NULL)
+    {
+	err_check(ERROR_NULL_POINTER,"NULL pointer is invalid arg.");
+    }
+    if(M->r != M->c || L->r != M->r || L->c != M->c)
+    {
+	err_check(ERROR_MATH_MAT_DIM,"Cholesky requires square matrices of the same size!");
+    }
+
+    // column by column, only the lower triangle of M is read, so L may be M
+    for(j = 0; j < M->r; ++j)
+    {
+	sum = M->m[j][j];
+	for(k = 0; k < j; ++k)
+	    sum -= L->m[j][k]*L->m[j][k];
+	if(sum <= 0.0)
+	{
+	    err_check(ERROR_MATH_MAT_SING,"Matrix is not positive definite!");
+	}
+	L->m[j][j] = sqrt(sum);
+	for(i = j + 1; i < M->r; ++i)
+	{
+	    sum = M->m[i][j];
+	    for(k = 0; k < j; ++k)
+		sum -= L->m[i][k]*L->m[j][k];
+	    L->m[i][j] = sum/L->m[j][j];
+	}
+	for(i = 0; i < j; ++i)
+	    L->m[i][j] = 0.0;
+    }
+    return ERROR_OK;
+}
+
+int uquad_mat_chol_solve(uquad_mat_t *x, uquad_mat_t *L, uquad_mat_t *B)
+{
+    int i, j, k, n;
+    double sum;
+    if(x == NULL || L == NULL || B == NULL)
+    {
+	err_check(ERROR_NULL_POINTER,"NULL pointer is invalid arg.");
+    }
+    if(L->r != L->c ||
+       B->r != L->r ||
+       x->r != B->r ||
+       x->c != B->c)
+    {
+	err_check(ERROR_MATH_MAT_DIM,"Dimension mismatch, cannot solve");
+    }
+
+    n = L->r;
+    for(j = 0; j < B->c; ++j)
+    {
+	// L*y = b
+	for(i = 0; i < n; ++i)
+	{
+	    sum = B->m[i][j];
+	    for(k = 0; k < i; ++k)
+		sum -= L->m[i][k]*x->m[k][j];
+	    x->m[i][j] = sum/L->m[i][i];
+	}
+	// L'*x = y
+	for(i = n - 1; i >= 0; --i)
+	{
+	    sum = x->m[i][j];
+	    for(k = i + 1; k < n; ++k)
+		sum -= L->m[k][i]*x->m[k][j];
+	    x->m[i][j] = sum/L->m[i][i];
+	}
+    }
+    return ERROR_OK;
+}
+
 int uquad_mat_transpose(uquad_mat_t *Mt, uquad_mat_t *M)
 {
     if(Mt == NULL || M == NULL)
@@ -507,68 +824,305 @@ int uquad_mat_dot_product(uquad_mat_t *C, uquad_mat_t *A, uquad_mat_t *B)
     return ERROR_OK;
 }
 
+/// Matrices of aux mem used by uquad_mat_exp()
+#define UQUAD_MAT_EXP_AUX 7
+
+/// Padé degrees used by uquad_mat_exp(), and max 1-norm for each degree
+static const int exp_pade_m[] = {3, 5, 7, 9, 13};
+static const double exp_pade_theta[] = {1.495585217958292e-2,
+					2.539398330063230e-1,
+					9.504178996162932e-1,
+					2.097847961257068e0,
+					5.371920351148152e0};
+/// Padé coefficients b_0..b_m for each degree
+static const double exp_pade_b3[] = {120.0, 60.0, 12.0, 1.0};
+static const double exp_pade_b5[] = {30240.0, 15120.0, 3360.0, 420.0, 30.0, 1.0};
+static const double exp_pade_b7[] = {17297280.0, 8648640.0, 1995840.0, 277200.0,
+				     25200.0, 1512.0, 56.0, 1.0};
+static const double exp_pade_b9[] = {17643225600.0, 8821612800.0, 2075673600.0,
+				     302702400.0, 30270240.0, 2162160.0, 110880.0,
+				     3960.0, 90.0, 1.0};
+static const double exp_pade_b13[] = {64764752532480000.0, 32382376266240000.0,
+				      7771770303897600.0, 1187353796428800.0,
+				      129060195264000.0, 10559470521600.0,
+				      670442572800.0, 33522128640.0, 1323241920.0,
+				      40840800.0, 960960.0, 16380.0, 182.0, 1.0};
+
+/**
+ * 1-norm of a matrix: max over columns of sum(abs(m[i][j]))
+ */
+static double uquad_mat_norm1(uquad_mat_t *m)
+{
+    int i, j;
+    double sum, norm = 0.0;
+    for(j = 0; j < m->c; ++j)
+    {
+	sum = 0.0;
+	for(i = 0; i < m->r; ++i)
+	    sum += uquad_abs(m->m[i][j]);
+	if(sum > norm)
+	    norm = sum;
+    }
+    return norm;
+}
+
 int uquad_mat_exp(uquad_mat_t *expA, uquad_mat_t *A)
 {
-    if(A == NULL)
+    int i, k, m, s = 0, n, len, retval = ERROR_OK;
+    size_t mark;
+    double norm, scale;
+    const double *b;
+    uquad_mat_t *aux[UQUAD_MAT_EXP_AUX] = {NULL};
+    uquad_mat_t aux_stack[UQUAD_MAT_EXP_AUX];
+    double *aux_rows[UQUAD_MAT_EXP_AUX][UQUAD_MAT_STACK_DIM];
+    double aux_data[UQUAD_MAT_EXP_AUX][UQUAD_MAT_STACK_DIM*UQUAD_MAT_STACK_DIM];
+    int pivot_stack[UQUAD_MAT_STACK_DIM], *pivot = NULL;
+    uquad_mat_t *P[5], *W, *U, *V;
+    if(A == NULL || expA == NULL)
     {
 	err_check(ERROR_NULL_POINTER, "Cannot load, must allocate memory previously.");
     }
-    if(A->r !=A->c)
+    if(A->r != A->c || expA->r != A->r || expA->c != A->c)
     {
 	err_check(ERROR_MATH_MAT_DIM,"A is not a square matrix");
     }
+    if(expA == A)
+    {
+	err_check(ERROR_INVALID_ARG,"In place exp is not supported.");
+    }
 
-    int i=1;
-    uquad_mat_t *aux0 = NULL;
-    uquad_mat_t *aux1 = NULL;
-    uquad_mat_t *aux2 = NULL;
-    double factor=1;
-    int n=A->r;
-    double norm = 1;
-    
-    aux0 = uquad_mat_alloc(n,n);   //aux0 is used to compute A^k in every step
-    aux1 = uquad_mat_alloc(n,n);   //aux1 is used to compare the exponential matrix in k                                       step with the exponential matrix in the k+1 step
-    aux2 = uquad_mat_alloc(n,n);   //aux2 is for general purpose;
-
-
-    uquad_mat_eye(expA);
-    uquad_mat_eye(aux0);
-    //    uquad_mat_copy(aux0,A);
-    //uquad_mat_sub(aux1,aux0,expA);
-    //    uquad_mat_zeros(aux1
-    //norm = uquad_mat_norm(aux1);
-
-
-    while (norm > 1e-5)
-	{
-	    //Set aux1=expA 
-	    uquad_mat_copy(aux1,expA); // save the value of expA in k step
-	    
-	    //Performs A^k
-	    uquad_mat_prod(aux2,aux0,A);
-	    uquad_mat_copy(aux0,aux2);
-	    
-	    //Adds A^k/k! to expA
-	    uquad_mat_scalar_div(aux2,aux2,factor);
-	    uquad_mat_add(expA,expA,aux2);
-	    
-	    i++;
-	    factor*=i;
-	    
-	    //Performs the norm of expAk-expA(k+1)
-	    uquad_mat_sub(aux2,expA,aux1);
-	    norm =  uquad_mat_norm(aux2);
+    n = A->r;
+    len = n*n;
+    mark = scratch_mark();
+    for(i = 0; i < UQUAD_MAT_EXP_AUX; ++i)
+    {
+	if(n <= UQUAD_MAT_STACK_DIM)
+	{
+	    // small matrix, aux mem on the stack
+	    uquad_mat_wrap(&aux_stack[i], aux_rows[i], aux_data[i], n, n);
+	    aux[i] = &aux_stack[i];
 	}
-    
-   
-    //Cleaning
-    
-    uquad_mat_free(aux0);
-    uquad_mat_free(aux1);
-    uquad_mat_free(aux2);      
-    
+	else
+	{
+	    aux[i] = uquad_mat_scratch(n,n);
+	    if(aux[i] == NULL)
+	    {
+		retval = ERROR_MALLOC;
+		cleanup_log_if(retval,"Failed to allocate matrix!");
+	    }
+	}
+    }
+    if(n <= UQUAD_MAT_STACK_DIM)
+    {
+	pivot = pivot_stack;
+    }
+    else
+    {
+	pivot = (int *)malloc(n*sizeof(int));
+	if(pivot == NULL)
+	{
+	    retval = ERROR_MALLOC;
+	    cleanup_log_if(retval,"Failed to allocate pivot!");
+	}
+    }
+    // P[k] = A^(2k), P[0] = I is never built
+    P[0] = NULL;
+    P[1] = aux[0];
+    P[2] = aux[1];
+    P[3] = aux[2];
+    P[4] = aux[3];
+    W = aux[4];
+    U = aux[5];
+    V = aux[6];
+
+    /**
+     * Scaling and squaring with Padé approximants, see:
+     *   N. J. Higham, "The scaling and squaring method for the matrix
+     *   exponential revisited", SIAM J. Matrix Anal. Appl., 2005.
+     * Lowest degree m such that |A|_1 <= theta_m, or m = 13 with A scaled
+     * by 2^-s. The cost is bounded by 6 products, 1 LU and s squarings.
+     */
+    norm = uquad_mat_norm1(A);
+    for(k = 0; k < 4; ++k)
+	if(norm <= exp_pade_theta[k])
+	    break;
+    m = exp_pade_m[k];
+
+    retval = uquad_mat_prod(P[1],A,A);
+    cleanup_if(retval);
+    if(m >= 5)
+    {
+	retval = uquad_mat_prod(P[2],P[1],P[1]);
+	cleanup_if(retval);
+    }
+    if(m >= 7)
+    {
+	retval = uquad_mat_prod(P[3],P[2],P[1]);
+	cleanup_if(retval);
+    }
 
-    return ERROR_OK;
+    if(m < 13)
+    {
+	if(m == 9)
+	{
+	    retval = uquad_mat_prod(P[4],P[2],P[2]);
+	    cleanup_if(retval);
+	}
+	b = (m == 3) ? exp_pade_b3 : (m == 5) ? exp_pade_b5 :
+	    (m == 7) ? exp_pade_b7 : exp_pade_b9;
+	// U = A*sum(b[2k+1]*A^2k), V = sum(b[2k]*A^2k)
+	for(i = 0; i < len; ++i)
+	{
+	    W->m_full[i] = 0.0;
+	    V->m_full[i] = 0.0;
+	    for(k = 1; 2*k <= m; ++k)
+	    {
+		W->m_full[i] += b[2*k+1]*P[k]->m_full[i];
+		V->m_full[i] += b[2*k]*P[k]->m_full[i];
+	    }
+	}
+	for(i = 0; i < n; ++i)
+	{
+	    W->m[i][i] += b[1];
+	    V->m[i][i] += b[0];
+	}
+	retval = uquad_mat_prod(U,A,W);
+	cleanup_if(retval);
+    }
+    else
+    {
+	// scale A^2k by 2^-2ks
+	s = (int)ceil(log2(norm/exp_pade_theta[4]));
+	if(s < 0)
+	    s = 0;
+	for(k = 1; k <= 3; ++k)
+	{
+	    scale = ldexp(1.0, -2*k*s);
+	    for(i = 0; i < len; ++i)
+		P[k]->m_full[i] *= scale;
+	}
+	b = exp_pade_b13;
+	// U = A*(A6*(b13*A6 + b11*A4 + b9*A2) + b7*A6 + b5*A4 + b3*A2 + b1*I)
+	for(i = 0; i < len; ++i)
+	    W->m_full[i] = b[13]*P[3]->m_full[i] + b[11]*P[2]->m_full[i] + b[9]*P[1]->m_full[i];
+	retval = uquad_mat_prod(V,P[3],W);
+	cleanup_if(retval);
+	for(i = 0; i < len; ++i)
+	    W->m_full[i] = V->m_full[i] +
+		b[7]*P[3]->m_full[i] + b[5]*P[2]->m_full[i] + b[3]*P[1]->m_full[i];
+	for(i = 0; i < n; ++i)
+	    W->m[i][i] += b[1];
+	retval = uquad_mat_prod(U,A,W);
+	cleanup_if(retval);
+	scale = ldexp(1.0, -s);
+	for(i = 0; i < len; ++i)
+	    U->m_full[i] *= scale;
+	// V = A6*(b12*A6 + b10*A4 + b8*A2) + b6*A6 + b4*A4 + b2*A2 + b0*I
+	for(i = 0; i < len; ++i)
+	    W->m_full[i] = b[12]*P[3]->m_full[i] + b[10]*P[2]->m_full[i] + b[8]*P[1]->m_full[i];
+	retval = uquad_mat_prod(V,P[3],W);
+	cleanup_if(retval);
+	for(i = 0; i < len; ++i)
+	    V->m_full[i] +=
+		b[6]*P[3]->m_full[i] + b[4]*P[2]->m_full[i] + b[2]*P[1]->m_full[i];
+	for(i = 0; i < n; ++i)
+	    V->m[i][i] += b[0];
+    }
+
+    // (V-U)*expA = (V+U)
+    for(i = 0; i < len; ++i)
+    {
+	W->m_full[i] = V->m_full[i] - U->m_full[i];
+	expA->m_full[i] = V->m_full[i] + U->m_full[i];
+    }
+    retval = uquad_mat_lu(W,pivot,W);
+    cleanup_if(retval);
+    retval = uquad_mat_lu_solve(expA,W,pivot,expA);
+    cleanup_if(retval);
+
+    // undo scaling, e^A = (e^(A/2^s))^(2^s)
+    for(k = 0; k < s; ++k)
+    {
+	retval = uquad_mat_prod(W,expA,expA);
+	cleanup_if(retval);
+	retval = uquad_mat_copy(expA,W);
+	cleanup_if(retval);
+    }
+
+    cleanup:
+    for(i = 0; i < UQUAD_MAT_EXP_AUX; ++i)
+	uquad_mat_free(aux[i]);
+    if(pivot != pivot_stack)
+	free(pivot);
+    scratch_release(mark);
+
+    return retval;
+}
+
+int uquad_mat_discretize(uquad_mat_t *Ad, uquad_mat_t *Bd, uquad_mat_t *A, uquad_mat_t *B, double T)
+{
+    int i, n, len, retval = ERROR_OK;
+    size_t mark = scratch_mark();
+    uquad_mat_t *M = NULL, *expM = NULL, M_stack, expM_stack;
+    double *M_rows[UQUAD_MAT_STACK_DIM], *expM_rows[UQUAD_MAT_STACK_DIM];
+    double M_data[UQUAD_MAT_STACK_DIM*UQUAD_MAT_STACK_DIM];
+    double expM_data[UQUAD_MAT_STACK_DIM*UQUAD_MAT_STACK_DIM];
+    if(Ad == NULL || Bd == NULL || A == NULL || B == NULL)
+    {
+	err_check(ERROR_NULL_POINTER,"NULL pointer is invalid arg.");
+    }
+    if(A->r != A->c ||
+       B->r != A->r ||
+       Ad->r != A->r || Ad->c != A->c ||
+       Bd->r != B->r || Bd->c != B->c)
+    {
+	err_check(ERROR_MATH_MAT_DIM,"Dimension mismatch, cannot discretize");
+    }
+
+    n = A->r + B->c;
+    if(n <= UQUAD_MAT_STACK_DIM)
+    {
+	// small system, aux mem on the stack
+	uquad_mat_wrap(&M_stack, M_rows, M_data, n, n);
+	uquad_mat_wrap(&expM_stack, expM_rows, expM_data, n, n);
+	M = &M_stack;
+	expM = &expM_stack;
+    }
+    else
+    {
+	M = uquad_mat_scratch(n,n);
+	expM = uquad_mat_scratch(n,n);
+    }
+    if(M == NULL || expM == NULL)
+    {
+	retval = ERROR_MALLOC;
+	cleanup_log_if(retval,"Could not allocate aux mem for discretize.");
+    }
+
+    // M = [A B;0 0]*T
+    uquad_mat_zeros(M);
+    retval = uquad_mat_set_subm(M,0,0,A);
+    cleanup_if(retval);
+    retval = uquad_mat_set_subm(M,0,A->c,B);
+    cleanup_if(retval);
+    len = M->r*M->c;
+    for(i = 0; i < len; ++i)
+	M->m_full[i] *= T;
+
+    // e^M = [Ad Bd;0 I]
+    retval = uquad_mat_exp(expM,M);
+    cleanup_if(retval);
+    retval = uquad_mat_get_subm(Ad,0,0,expM);
+    cleanup_if(retval);
+    retval = uquad_mat_get_subm(Bd,0,A->c,expM);
+    cleanup_if(retval);
+
+    cleanup:
+    uquad_mat_free(M);
+    uquad_mat_free(expM);
+    scratch_release(mark);
+
+    return retval;
 }
 
 double uquad_mat_norm(uquad_mat_t *A)
@@ -598,9 +1152,10 @@ int uquad_mat_int(uquad_mat_t *B, uquad_mat_t *A, double ti, double tf, double s
 	retval;
     double t=ti;
     uquad_mat_t* aux0;
+    size_t mark = scratch_mark();
     
     uquad_mat_zeros(B);
-    aux0 = uquad_mat_alloc(A->r,A->c);
+    aux0 = uquad_mat_scratch(A->r,A->c);
     if(aux0 == NULL)
     {
 	err_check(ERROR_MALLOC, "Failed to allocate matrix!");
@@ -620,6 +1175,7 @@ int uquad_mat_int(uquad_mat_t *B, uquad_mat_t *A, double ti, double tf, double s
     }
 
     uquad_mat_free(aux0);
+    scratch_release(mark);
     return ERROR_OK;
 }
 
@@ -629,51 +1185,26 @@ int uquad_mat_rotate(uquad_bool_t from_inertial,
 		     uquad_mat_t *R)
 {
     int retval;
-    uquad_bool_t local_mem = false;
+    uquad_mat3x3_t Rf;
+    uquad_mat_t R_stack;
+    double *R_rows[3];
+
+    // rotation matrix is built on the stack
+    uquad_mat3x3_rotation(&Rf, from_inertial, psi, phi, theta);
+    uquad_mat_wrap(&R_stack, R_rows, uquad_matf_full(&Rf), 3, 3);
     if(R == NULL)
     {
-	local_mem = true;
-	R = uquad_mat_alloc(3,3);
-	if(R == NULL)
-	{
-	    cleanup_log_if(ERROR_MALLOC,"Failed to allocate rotation matrix");
-	}
-    }
-    if(from_inertial)
-    {
-	R->m[0][0] = cos(phi)*cos(theta);
-	R->m[0][1] = cos(phi)*sin(theta);
-	R->m[0][2] = -sin(phi);
-
-	R->m[1][0] = cos(theta)*sin(psi)*sin(phi) - cos(psi)*sin(theta);
-	R->m[1][1] = cos(psi)*cos(theta) + sin(psi)*sin(phi)*sin(theta);
-	R->m[1][2] = cos(phi)*sin(psi);
-
-	R->m[2][0] = sin(psi)*sin(theta) + cos(psi)*cos(theta)*sin(phi);
-	R->m[2][1] = cos(psi)*sin(phi)*sin(theta) - cos(theta)*sin(psi);
-	R->m[2][2] = cos(psi)*cos(phi);
+	R = &R_stack;
     }
     else
     {
-	R->m[0][0] = cos(phi)*cos(theta); 
-	R->m[0][1] = cos(theta)*sin(phi)*sin(psi) - cos(psi)*sin(theta);
-	R->m[0][2] = sin(psi)*sin(theta) + cos(psi)*cos(theta)*sin(phi);
-
-	R->m[1][0] = cos(phi)*sin(theta);
-	R->m[1][1] = cos(psi)*cos(theta) + sin(phi)*sin(psi)*sin(theta);
-	R->m[1][2] = cos(psi)*sin(phi)*sin(theta) - cos(theta)*sin(psi);
-
-	R->m[2][0] = -sin(phi);
-	R->m[2][1] = cos(phi)*sin(psi);
-	R->m[2][2] = cos(phi)*cos(psi);
+	// caller wants R
+	retval = uquad_mat_copy(R, &R_stack);
+	err_propagate(retval);
     }
 
     retval = uquad_mat_prod(Vr,R,V);
-    cleanup_log_if(retval,"Failed to rotate vector!");
-
-    cleanup:
-    if(local_mem)
-	uquad_mat_free(R);
+    err_propagate(retval);
     return retval;
 }
 
@@ -800,6 +1331,7 @@ uquad_mat_t *uquad_mat_alloc(int r, int c)
     mem_alloc_check(m);
     m->r = r;
     m->c = c;
+    m->from_arena = false;
     m->m = (double **)malloc(sizeof(double *)*m->r);
     mem_alloc_check(m->m);
     // consecutive data
@@ -811,11 +1343,141 @@ uquad_mat_t *uquad_mat_alloc(int r, int c)
     return m;
 }
 
+int uquad_mat_wrap(uquad_mat_t *m, double **rows, double *data, int r, int c)
+{
+    int i;
+    if(m == NULL || rows == NULL || data == NULL)
+    {
+	err_check(ERROR_NULL_POINTER,"NULL pointer is invalid arg.");
+    }
+    if(!((r < UQUAD_MAT_MAX_DIM) && (c < UQUAD_MAT_MAX_DIM)))
+    {
+	err_check(ERROR_MATH_MAX_DIM,"Invalid matrix size!");
+    }
+    m->r = r;
+    m->c = c;
+    m->from_arena = true; // not ours, uquad_mat_free() must ignore it
+    m->m = rows;
+    m->m_full = data;
+    for (i=1, m->m[0] = m->m_full; i < m->r; ++i)
+    {
+	m->m[i] = m->m[i-1] + m->c;
+    }
+    return ERROR_OK;
+}
+
 void uquad_mat_free(uquad_mat_t *m)
 {
-    if(m == NULL)
+    if(m == NULL || m->from_arena)
 	return;
     free(m->m_full);
     free(m->m);
     free(m);
 }
+
+/// Rounds up to UQUAD_MAT_ARENA_ALIGN
+#define arena_align(n) (((n) + UQUAD_MAT_ARENA_ALIGN - 1) & ~((size_t)UQUAD_MAT_ARENA_ALIGN - 1))
+
+uquad_mat_arena_t *uquad_mat_arena_alloc(size_t size)
+{
+    uquad_mat_arena_t *arena;
+    arena = (uquad_mat_arena_t *)malloc(sizeof(struct uquad_mat_arena));
+    mem_alloc_check(arena);
+    size = arena_align(size);
+    arena->mem = NULL;
+    if(posix_memalign((void **)&arena->mem, UQUAD_MAT_ARENA_ALIGN, size) != 0)
+    {
+	free(arena);
+	err_log("malloc failed!");
+	return NULL;
+    }
+    arena->size = size;
+    arena->used = 0;
+    arena->high_water = 0;
+    arena->allocs = 0;
+    arena->fails = 0;
+    arena->resets = 0;
+    return arena;
+}
+
+void uquad_mat_arena_free(uquad_mat_arena_t *arena)
+{
+    if(arena == NULL)
+	return;
+    free(arena->mem);
+    free(arena);
+}
+
+void uquad_mat_arena_reset(uquad_mat_arena_t *arena)
+{
+    if(arena == NULL)
+	return;
+    arena->used = 0;
+    arena->resets++;
+}
+
+uquad_mat_t *uquad_mat_alloc_arena(uquad_mat_arena_t *arena, int r, int c)
+{
+    uquad_mat_t *m;
+    size_t
+	sz_head = arena_align(sizeof(struct uquad_mat)),
+	sz_rows = arena_align(sizeof(double *)*r),
+	sz_data = arena_align(sizeof(double)*r*c);
+    if(arena == NULL)
+    {
+	err_log("NULL pointer is invalid arg.");
+	return NULL;
+    }
+    if(!((r < UQUAD_MAT_MAX_DIM) && (c < UQUAD_MAT_MAX_DIM)))
+    {
+	err_log("Invalid matrix size!");
+	return NULL;
+    }
+    if(arena->size - arena->used < sz_head + sz_rows + sz_data)
+    {
+	// caller decides what to do, no log: this is checked every cycle
+	arena->fails++;
+	return NULL;
+    }
+    m = (uquad_mat_t *)(arena->mem + arena->used);
+    uquad_mat_wrap(m,
+		   (double **)(arena->mem + arena->used + sz_head),
+		   (double *)(arena->mem + arena->used + sz_head + sz_rows),
+		   r, c);
+    arena->used += sz_head + sz_rows + sz_data;
+    if(arena->used > arena->high_water)
+	arena->high_water = arena->used;
+    arena->allocs++;
+    return m;
+}
+
+size_t uquad_mat_arena_mark(uquad_mat_arena_t *arena)
+{
+    return (arena == NULL) ? 0 : arena->used;
+}
+
+void uquad_mat_arena_release(uquad_mat_arena_t *arena, size_t mark)
+{
+    if(arena == NULL || mark > arena->used)
+	return;
+    arena->used = mark;
+}
+
+void uquad_mat_arena_dump(uquad_mat_arena_t *arena, FILE *output)
+{
+    if(arena == NULL)
+    {
+	err_log("Cannot dump.");
+	return;
+    }
+    if(output == NULL)
+	output = stdout;
+    fprintf(output,"arena: size %zu used %zu high water %zu allocs %lu fails %lu resets %lu\n",
+	    arena->size, arena->used, arena->high_water,
+	    arena->allocs, arena->fails, arena->resets);
+}
+
+void uquad_mat_set_scratch(uquad_mat_arena_t *arena)
+{
+    scratch_arena = arena;
+}
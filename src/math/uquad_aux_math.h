@@ -40,6 +40,7 @@
 
 #define UQUAD_MATH_MAX_DIM 256
 #define UQUAD_MAT_MAX_DIM 64
+#define UQUAD_MAT_STACK_DIM 9 // aux mem for matrices up to this size goes on the stack
 
 #define USE_EQUILIBRATE 0
 
@@ -93,6 +94,8 @@
  *   uquad_mat_free(B);
  *   uquad_mat_free(C);
  *   exit(0);
+ *
+ * For small matrices of known size, see uquad_aux_mat_fixed.h
  * -- -- -- -- -- -- -- -- -- -- -- --
  */
 struct uquad_mat {
@@ -100,9 +103,47 @@ struct uquad_mat {
     double * m_full; // elements as [er,ec]: m[m->c*er + ec]
     int r;           // rows
     int c;           // columns
+    uquad_bool_t from_arena; // memory not owned by the matrix, see uquad_mat_free()
 };
 typedef struct uquad_mat uquad_mat_t;
 
+/**
+ * -- -- -- -- -- -- -- -- -- -- -- --
+ * Matrix arena
+ *
+ * Bump allocator for uquad_mat_t. A region is allocated once, matrices are
+ * carved from it with uquad_mat_alloc_arena(), and everything is released
+ * at once with uquad_mat_arena_reset(), typically once per control cycle.
+ * uquad_mat_free() on a matrix from an arena does nothing.
+ *
+ * Example of usage:
+ *   uquad_mat_arena_t *arena = uquad_mat_arena_alloc(UQUAD_MAT_ARENA_DEFAULT_SIZE);
+ *   uquad_mat_set_scratch(arena); // aux mem for exp, inv, etc.
+ *   while(control_loop)
+ *   {
+ *     uquad_mat_t *x = uquad_mat_alloc_arena(arena,12,1);
+ *     ...
+ *     uquad_mat_arena_reset(arena);
+ *   }
+ *   uquad_mat_arena_dump(arena, stdout); // size the arena with high_water
+ *   uquad_mat_set_scratch(NULL);
+ *   uquad_mat_arena_free(arena);
+ * -- -- -- -- -- -- -- -- -- -- -- --
+ */
+#define UQUAD_MAT_ARENA_ALIGN 16
+#define UQUAD_MAT_ARENA_DEFAULT_SIZE (64*1024)
+
+struct uquad_mat_arena {
+    unsigned char *mem;         // region
+    size_t size;                // bytes in region
+    size_t used;                // bytes currently allocated
+    size_t high_water;          // max used since alloc (not cleared by reset)
+    unsigned long allocs;       // matrices allocated since alloc
+    unsigned long fails;        // allocations that did not fit
+    unsigned long resets;       // calls to uquad_mat_arena_reset()
+};
+typedef struct uquad_mat_arena uquad_mat_arena_t;
+
 /**
  * -- -- -- -- -- -- -- -- -- -- -- --
  * Matrix
@@ -115,8 +156,11 @@ typedef struct uquad_mat uquad_mat_t;
  *
  * Checks dimensions before performing operation.
  * Memory for C,A and B must have been previously allocated.
+ * C must not be A or B.
  *
- * If matrices are 3x3, a macro is used (+ efficiency).
+ * If matrices are 2x2, 3x3, 4x4, 6x6, 9x9 or 12x12, an unrolled version is
+ * used (+ efficiency). If B is a column vector, one dot product per row.
+ * Other sizes use a register blocked kernel.
  *
  * @param C Result.
  * @param A First operand.
@@ -126,8 +170,6 @@ typedef struct uquad_mat uquad_mat_t;
  */
 int uquad_mat_prod(uquad_mat_t *C, uquad_mat_t *A,uquad_mat_t *B);
 
-int uquad_mat_det(uquad_mat_t *m, double *res);
-
 /**
  * Multiplies(divides) matrix m by scalar value k.
  * If only one matrix is supplied, will multiply(divide) in place.
@@ -168,7 +210,8 @@ int uquad_mat_add(uquad_mat_t *C, uquad_mat_t *A, uquad_mat_t *B);
  *
  * Checks dimensions before operating.
  * Requires aux matrix to build [A:B]. If none is supplied, will
- * allocate required memory, and then free it.
+ * use the stack for systems up to UQUAD_MAT_STACK_DIM, and allocate
+ * (and then free) required memory for bigger ones.
  *
  * @param A
  * @param B
@@ -195,8 +238,8 @@ int uquad_solve_pol2(double *xp, double *xm, double a, double b, double c);
 /**
  * Inverts matrix.
  * Assumes memory was previously allocated for minv.
- * Requires aux memory, two matrices. If not supplied, will allocate and
- * free after finishing.
+ * Requires aux memory, two matrices. If not supplied, will use the stack
+ * up to UQUAD_MAT_STACK_DIM, or allocate and free after finishing.
  *
  * @param Minv Result.
  * @param M Input.
@@ -207,6 +250,78 @@ int uquad_solve_pol2(double *xp, double *xm, double a, double b, double c);
  */
 int uquad_mat_inv(uquad_mat_t *Minv, uquad_mat_t *M, uquad_mat_t *Meye, uquad_mat_t *Maux);
 
+/**
+ * LU decomposition with partial pivoting (Doolittle):
+ *   P*M = L*U
+ * L (unit diagonal, not stored) and U are returned in LU. Factor once and
+ * then use uquad_mat_lu_solve() for every right hand side, instead of
+ * inverting M.
+ *
+ * Example:
+ *   int pivot[N];
+ *   retval = uquad_mat_lu(LU, pivot, S);
+ *   err_propagate(retval);
+ *   retval = uquad_mat_lu_solve(x, LU, pivot, b);
+ *
+ * @param LU Result, size of M. May be M, for in place factorization.
+ * @param pivot Array of M->r elements, i-th element is the row interchanged with row i.
+ * @param M Input, square. Unmodified unless M == LU.
+ *
+ * @return Error code, ERROR_MATH_MAT_SING if M is singular.
+ */
+int uquad_mat_lu(uquad_mat_t *LU, int *pivot, uquad_mat_t *M);
+
+/**
+ * Solves A*x = B, where LU and pivot are the result of uquad_mat_lu(A).
+ * B may have more than one column. If B is a column, no aux memory
+ * is required.
+ *
+ * @param x Result, size of B. May be B.
+ * @param LU
+ * @param pivot
+ * @param B
+ *
+ * @return Error code.
+ */
+int uquad_mat_lu_solve(uquad_mat_t *x, uquad_mat_t *LU, int *pivot, uquad_mat_t *B);
+
+/**
+ * Determinant of a square matrix, using its LU decomposition.
+ * A singular matrix returns det = 0.
+ * Uses the stack as aux memory up to UQUAD_MAT_STACK_DIM.
+ *
+ * @param m Input, unmodified.
+ * @param res Determinant.
+ *
+ * @return Error code.
+ */
+int uquad_mat_det(uquad_mat_t *m, double *res);
+
+/**
+ * Cholesky decomposition of a symmetric positive definite matrix:
+ *   M = L*L'
+ * Only the lower triangle of M is used. Takes half the work of
+ * uquad_mat_lu() and needs no pivoting, ex: covariance matrices.
+ *
+ * @param L Result, lower triangular (upper triangle is set to 0). May be M.
+ * @param M Input, symmetric positive definite.
+ *
+ * @return Error code, ERROR_MATH_MAT_SING if M is not positive definite.
+ */
+int uquad_mat_chol(uquad_mat_t *L, uquad_mat_t *M);
+
+/**
+ * Solves A*x = B, where L is the result of uquad_mat_chol(A).
+ * B may have more than one column.
+ *
+ * @param x Result, size of B. May be B.
+ * @param L
+ * @param B
+ *
+ * @return Error code.
+ */
+int uquad_mat_chol_solve(uquad_mat_t *x, uquad_mat_t *L, uquad_mat_t *B);
+
 /**
  * Transposes a matrix
  *
@@ -366,14 +481,37 @@ int uquad_mat_copy(uquad_mat_t *dest, uquad_mat_t *src);
 /**
  * Computes matrix exponencial:
  *   expA = e^(A)
- * 
- * @param expA 
- * @param A 
- * 
- * @return 
+ *
+ * Uses scaling and squaring with Padé approximants of degree 3 to 13,
+ * chosen from the 1-norm of A. The cost is bounded (at most 6 products,
+ * one LU and log2(|A|_1) squarings) and accurate to double precision.
+ * Uses the stack as aux memory up to UQUAD_MAT_STACK_DIM.
+ *
+ * @param expA Result, must not be A.
+ * @param A
+ *
+ * @return error code
  */
 int uquad_mat_exp(uquad_mat_t *expA, uquad_mat_t *A);
 
+/**
+ * Discretizes the continuous system x' = A*x + B*u with zero order hold
+ * and sampling time T:
+ *   x[k+1] = Ad*x[k] + Bd*u[k]
+ *   Ad = e^(A*T), Bd = int(e^(A*t),t=0..T)*B
+ * Both are computed with a single exponential:
+ *   e^([A B;0 0]*T) = [Ad Bd;0 I]
+ *
+ * @param Ad Result, size of A.
+ * @param Bd Result, size of B.
+ * @param A
+ * @param B
+ * @param T Sampling time.
+ *
+ * @return error code
+ */
+int uquad_mat_discretize(uquad_mat_t *Ad, uquad_mat_t *Bd, uquad_mat_t *A, uquad_mat_t *B, double T);
+
 /**
  * Performs the euclidean norm of a matrix:
  *  sqrt(sum(a[0]*a[0]+a[1]*a[1]...)
@@ -452,7 +590,7 @@ int uquad_mat_int(uquad_mat_t *B, uquad_mat_t *A, double ti, double tf, double s
  * @param phi
  * @param psi
  * @param theta
- * @param R NULL or aux mem for rotation, avoids malloc/free
+ * @param R NULL or aux mem for rotation. If NULL, the stack is used.
  *
  * @return
  */
@@ -471,12 +609,99 @@ int uquad_mat_rotate(uquad_bool_t from_inertial,
  */
 uquad_mat_t *uquad_mat_alloc(int r, int c);
 
+/**
+ * Builds a matrix on top of memory owned by the caller, no malloc.
+ * Useful to pass stack memory or fixed size matrices
+ * (uquad_aux_mat_fixed.h) to the rest of the API:
+ *   uquad_mat3x3_t Kf;
+ *   double *rows[3];
+ *   uquad_mat_t K;
+ *   uquad_mat_wrap(&K, rows, uquad_matf_full(&Kf), 3, 3);
+ * Must NOT be freed with uquad_mat_free().
+ *
+ * @param m answer
+ * @param rows mem for r row pointers
+ * @param data mem for r*c elements, row-wise
+ * @param r Rows.
+ * @param c Columns.
+ *
+ * @return error code
+ */
+int uquad_mat_wrap(uquad_mat_t *m, double **rows, double *data, int r, int c);
+
 /**
  * Free memory allocated my uquad_mat_alloc()
  * Will check if NULL argument is supplied.
+ * Matrices from an arena (or uquad_mat_wrap()) are ignored.
  *
  * @param m
  */
 void uquad_mat_free(uquad_mat_t *m);
 
+/**
+ * Allocates an arena of size bytes.
+ *
+ * @param size bytes, including matrix headers and row pointers.
+ *
+ * @return NULL or pointer to arena.
+ */
+uquad_mat_arena_t *uquad_mat_arena_alloc(size_t size);
+
+/**
+ * Free arena. All matrices allocated from it become invalid.
+ *
+ * @param arena
+ */
+void uquad_mat_arena_free(uquad_mat_arena_t *arena);
+
+/**
+ * Releases all the matrices of the arena, O(1).
+ *
+ * @param arena
+ */
+void uquad_mat_arena_reset(uquad_mat_arena_t *arena);
+
+/**
+ * Allocates matrix of size r rows and c columns from arena.
+ * Same as uquad_mat_alloc(), but no malloc.
+ *
+ * @param arena
+ * @param r Rows.
+ * @param c Columns.
+ *
+ * @return NULL (arena full) or pointer to matrix.
+ */
+uquad_mat_t *uquad_mat_alloc_arena(uquad_mat_arena_t *arena, int r, int c);
+
+/**
+ * Current position of the arena, to release what is allocated after it
+ * with uquad_mat_arena_release(). Allows nested scratch memory.
+ *
+ * @param arena
+ *
+ * @return mark
+ */
+size_t uquad_mat_arena_mark(uquad_mat_arena_t *arena);
+void uquad_mat_arena_release(uquad_mat_arena_t *arena, size_t mark);
+
+/**
+ * Prints arena statistics: size, used, high water mark, allocs, fails.
+ *
+ * @param arena
+ * @param output
+ */
+void uquad_mat_arena_dump(uquad_mat_arena_t *arena, FILE *output);
+
+/**
+ * Sets arena used for aux memory by uquad_mat_exp(), uquad_mat_discretize(),
+ * uquad_mat_int(), uquad_solve_lin(), uquad_mat_inv(), uquad_mat_det() and
+ * uquad_mat_lu_solve(), instead of malloc/free.
+ * Scratch memory is released before returning, so the arena is not
+ * consumed. If the arena is full, malloc is used.
+ * The setting is per thread.
+ *
+ * @param arena NULL to go back to malloc/free.
+ */
+void uquad_mat_set_scratch(uquad_mat_arena_t *arena);
+
 #endif //UQUAD_AUX_MATH_H
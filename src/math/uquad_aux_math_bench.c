@@ -0,0 +1,198 @@
+/**
+ * uquad_aux_math_bench: matrix product vs the original i-j-k loop
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @file   uquad_aux_math_bench.c
+ *
+ * @brief  Checks uquad_mat_prod() against the original i-j-k kernel and
+ *         times both, for square products and matrix-vector products of
+ *         every size uquad_mat_alloc() accepts (below UQUAD_MAT_MAX_DIM).
+ *
+ *         The reference is timed the way the original uquad_mat_prod() ran:
+ *         an out of line call that checks the arguments, then the i-j-k loop.
+ *         The original already had an unrolled 3x3, so the 3x3 speedup is
+ *         against i-j-k, not against the original.
+ *
+ * Usage: ./uquad_aux_math_bench [flops per size]
+ * Returns 0 if every result matches, -1 otherwise.
+ */
+#include "uquad_aux_math.h"
+#include <uquad_aux_time.h>
+#include <uquad_error_codes.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#define HOW_TO		"./uquad_aux_math_bench [flops per size]"
+#define BENCH_FLOPS	20000000	// multiply-adds per size and kernel
+#define BENCH_SEED	1234
+#define BENCH_TOL	1e-12		// relative, unrolled sizes may round differently
+
+static volatile double bench_sink;	// keeps the loops from being dropped
+
+/**
+ * Original Multiply_Matrices() (mymathlib), before register blocking.
+ */
+static void mat_prod_ijk(double *C, double *A, int nrows, int ncols,
+			 double *B, int mcols)
+{
+    double *pA;
+    double *pB;
+    double *p_B;
+    int i,j,k;
+
+    for (i = 0; i < nrows; A += ncols, i++)
+	for (p_B = B, j = 0; j < mcols; C++, p_B++, j++) {
+	    pB = p_B;
+	    pA = A;
+	    *C = 0.0;
+	    for (k = 0; k < ncols; pA++, pB += mcols, k++)
+		*C += *pA * *pB;
+	}
+}
+
+/**
+ * Original uquad_mat_prod(), argument checks included. Kept out of line so
+ * the call costs the same as the library call it is compared with.
+ */
+static __attribute__((noinline)) int mat_prod_old(uquad_mat_t *C, uquad_mat_t *A,
+						  uquad_mat_t *B)
+{
+    if(A == NULL || B == NULL || C == NULL)
+    {
+	err_check(ERROR_NULL_POINTER,"NULL pointer is invalid arg.");
+    }
+    if((A->c != B->r) || !((C->r == A->r) && (C->c == B->c)))
+    {
+	err_check(ERROR_MATH_MAT_DIM,"Cannot multiply matrices, dims do not match.");
+    }
+    mat_prod_ijk(C->m_full,A->m_full,A->r,A->c,B->m_full,B->c);
+    return ERROR_OK;
+}
+
+static void mat_rand(uquad_mat_t *m)
+{
+    int i;
+    for (i = 0; i < m->r*m->c; ++i)
+	m->m_full[i] = 2*drand48() - 1;
+}
+
+/**
+ * Compares and times C = A*B, with A (r x n) and B (n x c).
+ *
+ * @return number of elements that differ by more than BENCH_TOL
+ */
+static int bench_size(int r, int n, int c, long flops)
+{
+    uquad_mat_t *A = uquad_mat_alloc(r,n);
+    uquad_mat_t *B = uquad_mat_alloc(n,c);
+    uquad_mat_t *C = uquad_mat_alloc(r,c);
+    uquad_mat_t *R = uquad_mat_alloc(r,c);
+    struct timespec t0, t1;
+    double ns_new, ns_old, err, err_max = 0;
+    long it, iters = flops/((long)r*n*c);
+    int i, bad = 0, exact = 0;
+
+    if(A == NULL || B == NULL || C == NULL || R == NULL)
+    {
+	err_log("Could not allocate matrices!");
+	bad = -1;
+	goto cleanup;
+    }
+    if(iters < 1)
+	iters = 1;
+
+    mat_rand(A);
+    mat_rand(B);
+    mat_prod_old(R,A,B);
+    uquad_mat_prod(C,A,B);
+    for (i = 0; i < r*c; ++i)
+    {
+	err = fabs(C->m_full[i] - R->m_full[i]);
+	exact += (err == 0);
+	if(err > BENCH_TOL*(1 + fabs(R->m_full[i])))
+	    bad++;
+	if(err > err_max)
+	    err_max = err;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (it = 0; it < iters; ++it)
+    {
+	uquad_mat_prod(C,A,B);
+	bench_sink = C->m_full[it % (r*c)];
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    ns_new = (double)uquad_timespec_diff_ns(&t1, &t0)/iters;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (it = 0; it < iters; ++it)
+    {
+	mat_prod_old(R,A,B);
+	bench_sink = R->m_full[it % (r*c)];
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    ns_old = (double)uquad_timespec_diff_ns(&t1, &t0)/iters;
+
+    printf("%3dx%-3d * %3dx%-3d %10.1f %10.1f %8.2f %6d/%-6d %9.2e\n",
+	   r, n, n, c, ns_old, ns_new, ns_old/ns_new, exact, r*c, err_max);
+
+    cleanup:
+    uquad_mat_free(A);
+    uquad_mat_free(B);
+    uquad_mat_free(C);
+    uquad_mat_free(R);
+    return bad;
+}
+
+int main(int argc, char *argv[])
+{
+    long flops = BENCH_FLOPS;
+    int n, retval, bad = 0;
+
+    if(argc > 1)
+    {
+	flops = atol(argv[1]);
+	if(flops <= 0)
+	{
+	    err_log(HOW_TO);
+	    return -1;
+	}
+    }
+    srand48(BENCH_SEED);
+
+    printf("     product        ijk [ns]   new [ns]  speedup  exact      max err\n");
+    // Square products, every size (2, 3, 4, 6, 9 and 12 use the unrolled kernels)
+    for (n = 1; n < UQUAD_MAT_MAX_DIM; ++n)
+    {
+	retval = bench_size(n,n,n,flops);
+	if(retval < 0)
+	    return -1;
+	bad += retval;
+    }
+    // Matrix times vector, as in the Kalman filter updates
+    for (n = 1; n < UQUAD_MAT_MAX_DIM; n *= 2)
+    {
+	retval = bench_size(n,n,1,flops);
+	if(retval < 0)
+	    return -1;
+	bad += retval;
+    }
+
+    printf("mismatches: %d\n", bad);
+    return (bad == 0) ? 0 : -1;
+}
@@ -0,0 +1,283 @@
+/**
+ ******************************************************************************
+ *
+ * @file       uquad_aux_math_test.c
+ * @author     Federico Favaro, Joaquin Berrutti y Lucas Falkenstein
+ * @brief      Prueba de la factorizacion LU (solve y det) y de Cholesky de
+ *             uquad_aux_math.h con matrices conocidas, incluyendo singulares
+ *             y que requieren pivoteo. Prueba uquad_mat_exp() en cada grado
+ *             de Pade y con escalado, y uquad_mat_discretize() con dobles
+ *             integradores.
+ *
+ * Uso: ./uquad_aux_math_test
+ * Devuelve 0 si pasan todas las pruebas, -1 si no.
+ *
+ *****************************************************************************/
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <http://www.gnu.org/licenses/> or write to the
+ * Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "uquad_aux_math.h"
+#include <uquad_error_codes.h>
+
+#include <stdio.h>
+#include <math.h>
+
+#define TEST_TOL	1e-12
+#define TEST_N_GRANDE	(UQUAD_MAT_STACK_DIM + 3)	// usa memoria auxiliar del heap
+#define TEST_TOL_EXP	1e-13	// por elemento, el escalado suma redondeo
+#define TEST_T		0.05	// periodo de muestreo para discretizar
+
+static int fallas = 0;
+
+static void test_verificar(int ok, const char *nombre)
+{
+    if (ok)
+	return;
+    printf("FALLA %s\n", nombre);
+    fallas++;
+}
+
+/* Tolerancia relativa al valor esperado */
+static int test_cerca(double v, double esperado, double tol)
+{
+    return fabs(v - esperado) <= tol*(1 + fabs(esperado));
+}
+
+/* Matriz r x c cargada por filas desde v */
+static uquad_mat_t *test_mat(int r, int c, const double *v)
+{
+    uquad_mat_t *m = uquad_mat_alloc(r, c);
+    int i;
+
+    if (m != NULL && v != NULL)
+	for (i = 0; i < r*c; i++)
+	    m->m_full[i] = v[i];
+    return m;
+}
+
+static int test_mat_cerca(const uquad_mat_t *m, const double *esperado, double tol)
+{
+    int i;
+
+    for (i = 0; i < m->r*m->c; i++)
+	if (!test_cerca(m->m_full[i], esperado[i], tol))
+	    return 0;
+    return 1;
+}
+
+/* Tridiagonal (-1, 2, -1) de n x n, det = n + 1 */
+static uquad_mat_t *test_tridiag(int n)
+{
+    uquad_mat_t *m = uquad_mat_alloc(n, n);
+    int i;
+
+    if (m == NULL)
+	return NULL;
+    uquad_mat_zeros(m);
+    for (i = 0; i < n; i++) {
+	m->m[i][i] = 2;
+	if (i > 0)
+	    m->m[i][i-1] = m->m[i-1][i] = -1;
+    }
+    return m;
+}
+
+/* A*x = b con A de 3 x 3, x conocido */
+static void test_lu_caso(const char *nombre, const double *a, const double *x,
+			 const double *b, double det)
+{
+    uquad_mat_t *A = test_mat(3, 3, a), *LU = uquad_mat_alloc(3, 3);
+    uquad_mat_t *B = test_mat(3, 1, b), *X = uquad_mat_alloc(3, 1);
+    int pivot[3], retval;
+    double d;
+
+    retval = uquad_mat_lu(LU, pivot, A);
+    test_verificar(retval == ERROR_OK, nombre);
+    retval = uquad_mat_lu_solve(X, LU, pivot, B);
+    test_verificar(retval == ERROR_OK && test_mat_cerca(X, x, TEST_TOL), nombre);
+    retval = uquad_mat_det(A, &d);
+    test_verificar(retval == ERROR_OK && test_cerca(d, det, TEST_TOL), nombre);
+
+    // En el lugar, x = B
+    retval = uquad_mat_lu(A, pivot, A);
+    if (retval == ERROR_OK)
+	retval = uquad_mat_lu_solve(B, A, pivot, B);
+    test_verificar(retval == ERROR_OK && test_mat_cerca(B, x, TEST_TOL), nombre);
+
+    uquad_mat_free(A);
+    uquad_mat_free(LU);
+    uquad_mat_free(B);
+    uquad_mat_free(X);
+}
+
+static void test_lu(void)
+{
+    const double a[] = {2, 1, 1,  4, -6, 0,  -2, 7, 2};
+    const double a_x[] = {1, 2, 3}, a_b[] = {7, -8, 18};
+    // a[0][0] = 0, sin pivoteo no se puede factorizar
+    const double p[] = {0, 2, 1,  1, 1, 1,  3, 0, 2};
+    const double p_x[] = {1, -1, 2}, p_b[] = {0, 2, 7};
+    const double perm[] = {0, 1, 0,  0, 0, 1,  1, 0, 0};
+    const double perm_x[] = {5, -3, 4}, perm_b[] = {-3, 4, 5};
+    const double sing[] = {1, 2, 3,  2, 4, 6,  1, 0, 1};
+    uquad_mat_t *S = test_mat(3, 3, sing), *LU = uquad_mat_alloc(3, 3), *T;
+    int pivot[3], n;
+    double d;
+
+    test_lu_caso("lu", a, a_x, a_b, -16);
+    test_lu_caso("lu pivoteo", p, p_x, p_b, -1);
+    test_lu_caso("lu permutacion", perm, perm_x, perm_b, 1);
+
+    // Singular: lu lo reporta, det da 0
+    test_verificar(uquad_mat_lu(LU, pivot, S) == ERROR_MATH_MAT_SING, "lu singular");
+    test_verificar(uquad_mat_det(S, &d) == ERROR_OK && d == 0.0, "det singular");
+    uquad_mat_free(S);
+    uquad_mat_free(LU);
+
+    // Del lado del stack y del heap en det()
+    for (n = UQUAD_MAT_STACK_DIM; n <= TEST_N_GRANDE; n++) {
+	T = test_tridiag(n);
+	test_verificar(uquad_mat_det(T, &d) == ERROR_OK && test_cerca(d, n + 1, TEST_TOL),
+		       "det tridiagonal");
+	uquad_mat_free(T);
+    }
+}
+
+static void test_chol(void)
+{
+    const double spd[] = {4, 12, -16,  12, 37, -43,  -16, -43, 98};
+    const double l[] = {2, 0, 0,  6, 1, 0,  -8, 5, 3};
+    const double x[] = {1, -2, 0.5}, b[] = {-28, -83.5, 119};
+    const double indef[] = {1, 2,  2, 1};
+    const double neg[] = {-1, 0,  0, 1};
+    uquad_mat_t *M = test_mat(3, 3, spd), *L = uquad_mat_alloc(3, 3);
+    uquad_mat_t *B = test_mat(3, 1, b), *X = uquad_mat_alloc(3, 1);
+    uquad_mat_t *I = test_mat(2, 2, indef), *N = test_mat(2, 2, neg), *L2 = uquad_mat_alloc(2, 2);
+
+    test_verificar(uquad_mat_chol(L, M) == ERROR_OK && test_mat_cerca(L, l, TEST_TOL), "chol");
+    test_verificar(uquad_mat_chol_solve(X, L, B) == ERROR_OK && test_mat_cerca(X, x, TEST_TOL),
+		   "chol solve");
+    // En el lugar
+    test_verificar(uquad_mat_chol(M, M) == ERROR_OK && test_mat_cerca(M, l, TEST_TOL), "chol en el lugar");
+
+    // Simetricas no definidas positivas
+    test_verificar(uquad_mat_chol(L2, I) == ERROR_MATH_MAT_SING, "chol indefinida");
+    test_verificar(uquad_mat_chol(L2, N) == ERROR_MATH_MAT_SING, "chol negativa");
+
+    uquad_mat_free(M);
+    uquad_mat_free(L);
+    uquad_mat_free(B);
+    uquad_mat_free(X);
+    uquad_mat_free(I);
+    uquad_mat_free(N);
+    uquad_mat_free(L2);
+}
+
+/* e^(a*[0 1;-1 0]) = [cos a sin a;-sin a cos a], |A|_1 = |a| */
+static void test_exp_rotacion(double a, const char *nombre)
+{
+    const double g[] = {0, a,  -a, 0};
+    const double r[] = {cos(a), sin(a),  -sin(a), cos(a)};
+    uquad_mat_t *A = test_mat(2, 2, g), *E = uquad_mat_alloc(2, 2);
+
+    test_verificar(uquad_mat_exp(E, A) == ERROR_OK && test_mat_cerca(E, r, TEST_TOL_EXP*(1 + fabs(a))),
+		   nombre);
+    uquad_mat_free(A);
+    uquad_mat_free(E);
+}
+
+static void test_exp(void)
+{
+    const double nil[] = {0, 1, 0,  0, 0, 1,  0, 0, 0};
+    const double nil_e[] = {1, 1, 0.5,  0, 1, 1,  0, 0, 1};
+    uquad_mat_t *A, *E;
+    int i, n;
+
+    // |A|_1 en el rango de cada grado (3, 5, 7, 9, 13) y por encima (13 con escalado)
+    test_exp_rotacion(0.01, "exp pade 3");
+    test_exp_rotacion(0.2, "exp pade 5");
+    test_exp_rotacion(0.9, "exp pade 7");
+    test_exp_rotacion(2.0, "exp pade 9");
+    test_exp_rotacion(5.0, "exp pade 13");
+    test_exp_rotacion(40.0, "exp escalado");
+    test_exp_rotacion(-300.0, "exp escalado");
+
+    // Nilpotente: la serie es exacta
+    A = test_mat(3, 3, nil);
+    E = uquad_mat_alloc(3, 3);
+    test_verificar(uquad_mat_exp(E, A) == ERROR_OK && test_mat_cerca(E, nil_e, TEST_TOL_EXP), "exp nilpotente");
+    uquad_mat_free(A);
+    uquad_mat_free(E);
+
+    // Diagonal, del lado del heap, con escalado
+    n = TEST_N_GRANDE;
+    A = uquad_mat_alloc(n, n);
+    E = uquad_mat_alloc(n, n);
+    uquad_mat_zeros(A);
+    for (i = 0; i < n; i++)
+	A->m[i][i] = 0.7*i - 3;
+    test_verificar(uquad_mat_exp(E, A) == ERROR_OK, "exp diagonal");
+    for (i = 0; i < n*n; i++)
+	test_verificar(test_cerca(E->m_full[i], (i % (n + 1) == 0) ? exp(0.7*(i/(n + 1)) - 3) : 0.0,
+				  TEST_TOL_EXP), "exp diagonal");
+    uquad_mat_free(A);
+    uquad_mat_free(E);
+}
+
+/* k dobles integradores x'' = u: Ad = [1 T;0 1], Bd = [T^2/2;T] por bloque */
+static void test_discretize(int k)
+{
+    uquad_mat_t *A = uquad_mat_alloc(2*k, 2*k), *B = uquad_mat_alloc(2*k, k);
+    uquad_mat_t *Ad = uquad_mat_alloc(2*k, 2*k), *Bd = uquad_mat_alloc(2*k, k);
+    int i, j, ok;
+
+    uquad_mat_zeros(A);
+    uquad_mat_zeros(B);
+    for (i = 0; i < k; i++) {
+	A->m[2*i][2*i+1] = 1;
+	B->m[2*i+1][i] = 1;
+    }
+
+    ok = uquad_mat_discretize(Ad, Bd, A, B, TEST_T) == ERROR_OK;
+    for (i = 0; ok && i < 2*k; i++) {
+	for (j = 0; j < 2*k; j++)
+	    ok = ok && test_cerca(Ad->m[i][j], (i == j) ? 1 : (j == i + 1 && i % 2 == 0) ? TEST_T : 0,
+				  TEST_TOL);
+	for (j = 0; j < k; j++)
+	    ok = ok && test_cerca(Bd->m[i][j], (j != i/2) ? 0 : (i % 2 == 0) ? TEST_T*TEST_T/2 : TEST_T,
+				  TEST_TOL);
+    }
+    test_verificar(ok, "discretize doble integrador");
+
+    uquad_mat_free(A);
+    uquad_mat_free(B);
+    uquad_mat_free(Ad);
+    uquad_mat_free(Bd);
+}
+
+int main(void)
+{
+    test_lu();
+    test_chol();
+    test_exp();
+    // 3k de orden del exponencial: 3 y 9 en el stack, 12 en el heap
+    test_discretize(1);
+    test_discretize(3);
+    test_discretize(4);
+
+    printf("%s: %d fallas\n", (fallas == 0) ? "OK" : "ERROR", fallas);
+    return (fallas == 0) ? 0 : -1;
+}
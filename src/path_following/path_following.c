@@ -2,152 +2,107 @@
 
 #include <stdlib.h>
 #include <math.h>
+#include <uquad_aux_angle.h>
 
-#define fix(a)                    ((a>0)?floor(a):ceil(a))
-#define sign(a)                   ((a < 0.0)?-1.0:1.0)
-
-static estado_t estado = CFA_i;
-static double last_yaw_d = 0; //TODO primer caso me preocupa, como inicializo esta variable
-
-double carrotChase_Line(way_point_t wp_i, way_point_t wp_f, way_point_t p)
+void path_following_init(path_following_t *pf, double yaw)
 {
-    // Paso 2
-    double Ru = sqrt(pow(wp_i.x - p.x, 2) + pow(wp_i.y - p.y, 2));
-    double theta = atan2(wp_f.y - wp_i.y, wp_f.x - wp_i.x);
-
-    // Paso 3
-    double theta_u = atan2(p.y - wp_i.y, p.x - wp_i.x);
-    double beta = theta - theta_u;
-
-    // Paso 4
-    double R = sqrt(pow(Ru, 2) - pow(Ru*sin(beta), 2));
-
-    // Paso 5
-    double x = wp_i.x + (R+DELTA)*cos(theta);
-    double y = wp_i.y + (R+DELTA)*sin(theta);
-
-    // Paso 6
-    double yaw_d = -atan2(y - p.y, x - p.x); //El signo negativo es para que sea coherente con el sentido de giro de la cc3d (angulo positivo = giro horario)
-    
-    //Correccion de discontinuidad de atan2
-    double dyaw_d = yaw_d - last_yaw_d;
-    if (abs(dyaw_d) >= M_PI)
-	yaw_d -= 2.0*M_PI*fix((dyaw_d+M_PI*sign(dyaw_d))/(2.0*M_PI));
-    last_yaw_d = yaw_d;
-
-    return yaw_d;
+    pf->estado = CFA_i;
+    pf->tramo_nuevo = true;
+    pf->avance = 0;
+    pf->phi_ant = 0;
+    pf->last_yaw_d = yaw;
+    pf->cos_lambda = cos(LAMBDA);
+    pf->sin_lambda = sin(LAMBDA);
 }
 
-double carrotChase_Circle(way_point_t wp_c, int r, way_point_t p, char sentido)
+/* Yaw hacia el carrot, sin la discontinuidad de atan2 */
+static double yaw_hacia(path_following_t *pf, double x, double y, way_point_t p)
 {
-    // Paso 2
-    double d = sqrt(pow(wp_c.x - p.x, 2) + pow(wp_c.y - p.y, 2)) - r;
-
-    // Paso 3
-    double theta = atan2(p.y - wp_c.y, p.x - wp_c.x);
-
-    // Paso 4
-    double x, y;
-    // Depende el sentido de giro el signo que uso para el angulo lambda
-    if (sentido == 'L') {
-        x = wp_c.x + r*cos(theta + LAMBDA);
-        y = wp_c.y + r*sin(theta + LAMBDA);
-    } else {
-        x = wp_c.x + r*cos(theta - LAMBDA);
-        y = wp_c.y + r*sin(theta - LAMBDA);
-    }
-
-    // Paso 5
     double yaw_d = -atan2(y - p.y, x - p.x); //El signo negativo es para que sea coherente con el sentido de giro de la cc3d (angulo positivo = giro horario)
-    
+
     //Correccion de discontinuidad de atan2
-    double dyaw_d = yaw_d - last_yaw_d;
-    if (abs(dyaw_d) >= M_PI)
-	yaw_d -= 2.0*M_PI*fix((dyaw_d+M_PI*sign(dyaw_d))/(2.0*M_PI));
-    last_yaw_d = yaw_d;
+    yaw_d = uquad_angle_unwrap(yaw_d, pf->last_yaw_d);
+    pf->last_yaw_d = yaw_d;
 
     return yaw_d;
 }
 
-int path_following(way_point_t p, Lista_path *lista_path, double *yaw_d)
+double segmento_avance(path_following_t *pf, const segmento_t *seg, way_point_t p)
 {
-    int a,b,c;
+    double rx = p.x - seg->x0, ry = p.y - seg->y0;
+    double phi;
 
-    way_point_t centro, pi, pf;
-    trayectoria_t path;
+    // Recta: proyeccion sobre la direccion
+    if (seg->giro == 'S')
+        return rx*seg->ux + ry*seg->uy;
 
-    inicioPathFollowing:;// printf("   ");    // TODO: Hacer que esto ande sin el printf()
-
-    if (lista_path->tamano == 0)
-        return -1;
+    // Cfa: angulo desde el radio inicial, acumulado para no saltar en +-pi
+    phi = atan2(seg->ux*ry - seg->uy*rx, seg->ux*rx + seg->uy*ry);
+    if (pf->tramo_nuevo)
+        pf->avance = phi;
     else
-        path = *lista_path->inicio->dato;
-
-    // Verifico si llegue al final de alguna subtrayectoria
-    switch(estado) {
-
-    case CFA_i:
-        if (sqrt(pow(p.x - path.xri, 2) + pow(p.y - path.yri, 2)) < ERROR_ACEPTABLE)
-            estado = RECTA;
-        a=1;
-        break;
-
-    case RECTA:
-        if (sqrt(pow(p.x - path.xrf, 2) + pow(p.y - path.yrf, 2)) < ERROR_ACEPTABLE) {
-            estado = CFA_f;
-            goto inicioPathFollowing;
-        }
-        a=2;
-        break;
-
-    case CFA_f:
-        if (sqrt(pow(p.x - path.xf, 2) + pow(p.y - path.yf, 2)) < ERROR_ACEPTABLE) {
-            BorrarEnLista_path(lista_path);
-            estado = CFA_i;
-            goto inicioPathFollowing;
-        }
-        a=3;
-        break;
+        pf->avance += uquad_angle_diff(phi, pf->phi_ant);
+    pf->phi_ant = phi;
 
-    }
+    return (seg->giro == 'L') ? pf->avance : -pf->avance;
+}
+
+double carrotChase_Line(path_following_t *pf, const segmento_t *seg, way_point_t p, double s)
+{
+    // Carrot a DELTA por delante de la proyeccion
+    return yaw_hacia(pf, seg->x0 + (s + DELTA)*seg->ux, seg->y0 + (s + DELTA)*seg->uy, p);
+}
 
-    // dependiendo del caso hago el procedimiento de carrot chase
-    switch(estado) {
-
-    case CFA_i:
-        centro.x = path.xci;
-        centro.y = path.yci;
-        if ((path.tipo == RSR) || (path.tipo == RSL) || (path.tipo == RLR)) {  // si empieza hacia la derecha
-            *yaw_d = carrotChase_Circle(centro, RADIO, p, 'R');
-        } else {    // si empieza hacia la izquierda
-            *yaw_d = carrotChase_Circle(centro, RADIO, p, 'L');
-        }
-        b=1;
-        break;
-
-    case RECTA:
-        pi.x = path.xri;
-        pi.y = path.yri;
-        pf.x = path.xrf;
-        pf.y = path.yrf;
-        *yaw_d = carrotChase_Line(pi, pf, p);
-        b=2;
-        break;
-
-    case CFA_f:
-        centro.x = path.xcf;
-        centro.y = path.ycf;
-        if ((path.tipo == RSR) || (path.tipo == LSR) || (path.tipo == RLR)) {  // si termina hacia la derecha
-            *yaw_d = carrotChase_Circle(centro, RADIO, p, 'R');
-        } else {    // si termina hacia la izquierda
-            *yaw_d = carrotChase_Circle(centro, RADIO, p, 'L');
-        }
-        b=3;
-        break;
+double carrotChase_Circle(path_following_t *pf, const segmento_t *seg, way_point_t p)
+{
+    double rx = p.x - seg->x0, ry = p.y - seg->y0;
+    double r = sqrt(rx*rx + ry*ry);
+    double ex, ey, sl;
+
+    // Radio unitario hacia la posicion (en el centro uso el radio inicial)
+    ex = (r > 0) ? rx/r : seg->ux;
+    ey = (r > 0) ? ry/r : seg->uy;
+
+    // Carrot: el radio rotado LAMBDA en el sentido de giro
+    sl = (seg->giro == 'L') ? pf->sin_lambda : -pf->sin_lambda;
+    return yaw_hacia(pf, seg->x0 + RADIO*(ex*pf->cos_lambda - ey*sl),
+                     seg->y0 + RADIO*(ex*sl + ey*pf->cos_lambda), p);
+}
 
+int path_following(path_following_t *pf, way_point_t p, path_buff_t *paths, double *yaw_d)
+{
+    const trayectoria_t *path;
+    const segmento_t *seg;
+    double s;
+
+    // Avanzo de tramo mientras la proyeccion este mas alla de su final, o
+    // si el tramo es nulo (ej: recta de largo 0, donde la proyeccion puede
+    // quedar atras por el error de posicion). Cada vuelta consume un tramo,
+    // asi que termina.
+    while (1) {
+        path = path_buff_actual(paths);
+        if (path == NULL)
+            return -1;
+
+        seg = &path->seg[pf->estado];
+        s = segmento_avance(pf, seg, p);
+        pf->tramo_nuevo = false;
+        if (seg->largo > TRAMO_MIN && s < seg->largo)
+            break;
+
+        if (pf->estado == CFA_f) {
+            path_buff_avanzar(paths);
+            pf->estado = CFA_i;
+        } else
+            pf->estado++;
+        pf->tramo_nuevo = true;
     }
 
-//    printf("\n %i   %i\n",a,b);
-    return 0;
+    // Carrot chase sobre el tramo actual
+    if (seg->giro == 'S')
+        *yaw_d = carrotChase_Line(pf, seg, p, s);
+    else
+        *yaw_d = carrotChase_Circle(pf, seg, p);
 
+    return 0;
 }
@@ -1,44 +1,95 @@
 #ifndef PATH_FOLLOWING_H
 #define PATH_FOLLOWING_H
 
+#include <stdbool.h>
 #include <path_planning.h>
 
 #define DELTA               3.4        // Parametro seguimiento rectas [m]
 #define LAMBDA              1.2      // Parametro seguimiento circunferencias [rad]
-#define ERROR_ACEPTABLE     4        // Distancia minima para determinar si se logro el objetivo [m]
+#define TRAMO_MIN           1e-6     // Tramos mas cortos se dan por recorridos [m o rad]
 
 typedef enum estado {
-    CFA_i,
-    RECTA,
-    CFA_f
+    CFA_i,          // primer tramo (seg[0])
+    RECTA,          // tramo intermedio, recta o cfa en RLR/LRL (seg[1])
+    CFA_f           // ultimo tramo (seg[2])
 } estado_t;
 
+/**
+ * Estado del seguidor de trayectorias. Cada seguidor tiene el suyo, por
+ * lo que se pueden seguir varias trayectorias a la vez (p.ej. simulaciones
+ * en paralelo).
+ */
+typedef struct path_following {
+    estado_t estado;        // tramo actual
+    bool tramo_nuevo;       // recien se entro al tramo actual
+    double avance;          // angulo recorrido en la cfa actual [rad]
+    double phi_ant;         // angulo anterior respecto al radio inicial (cfa)
+    double last_yaw_d;      // ultimo yaw deseado, para corregir la discontinuidad de atan2
+    double cos_lambda;      // rotacion del carrot en las cfa
+    double sin_lambda;
+} path_following_t;
+
+/**
+ * Inicializa el seguidor al principio de la trayectoria actual.
+ *
+ * @param pf seguidor
+ * @param yaw yaw inicial, para que el primer yaw deseado quede cerca
+ */
+void path_following_init(path_following_t *pf, double yaw);
+
+/**
+ * Avance sobre el tramo, por proyeccion: en una recta la distancia
+ * recorrida sobre la direccion [m], en una cfa el angulo recorrido desde
+ * el radio inicial [rad], acumulado entre llamadas.
+ *
+ * @param pf seguidor, acumula el avance en las cfa
+ * @param seg tramo actual
+ * @param p posicion actual
+ *
+ * @return avance, el tramo termina cuando llega a seg->largo
+ */
+double segmento_avance(path_following_t *pf, const segmento_t *seg, way_point_t p);
+
 /**
  * Ejecuta el seguimiento de trayectorias
  * rectilineas, devolviendo el angulo yaw
  * deseado
  *
- * @param wp_i extremo inicial de la recta
- * @param wp_f extremo final de la recta
- * @param p way point de partida
+ * @param pf seguidor
+ * @param seg recta a seguir
+ * @param p posicion actual
+ * @param s avance sobre la recta, ver segmento_avance()
  *
  * @return yaw deseado a seguir
  */
-double carrotChase_Line(way_point_t wp_i, way_point_t wp_f, way_point_t p);
+double carrotChase_Line(path_following_t *pf, const segmento_t *seg, way_point_t p, double s);
 
 /**
  * Ejecuta el seguimiento de trayectorias
  * circulares, devolviendo el angulo yaw
  * deseado
  *
- * @param wp_c centro de la cfa
- * @param p way point de partida
- * @param sentido de giro en que recorre la cfa (izq o der)
+ * @param pf seguidor
+ * @param seg cfa a seguir (centro y sentido de giro)
+ * @param p posicion actual
  *
  * @return yaw deseado a seguir
  */
-double carrotChase_Circle(way_point_t wp_c, int r, way_point_t p, char sentido);
+double carrotChase_Circle(path_following_t *pf, const segmento_t *seg, way_point_t p);
 
-int path_following(way_point_t p, Lista_path *lista_path, double *yaw_d);
+/**
+ * Sigue la trayectoria actual del buffer. Los cambios de tramo se deciden
+ * por el avance proyectado sobre cada tramo, no por distancia a sus
+ * extremos, por lo que un punto de cambio no se puede "saltear". Al
+ * terminar el ultimo tramo avanza el cursor del buffer a la siguiente.
+ *
+ * @param pf seguidor
+ * @param p posicion actual
+ * @param paths buffer de trayectorias
+ * @param yaw_d yaw deseado a seguir
+ *
+ * @return 0 si ok, -1 si ya se recorrieron todas las trayectorias
+ */
+int path_following(path_following_t *pf, way_point_t p, path_buff_t *paths, double *yaw_d);
 
 #endif
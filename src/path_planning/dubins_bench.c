@@ -0,0 +1,359 @@
+/**
+ * Mediciones del planificador de Dubins sobre pares de way points al azar.
+ *
+ * palabras: dubins_palabras() contra las 18 funciones t_*, p_* y q_*
+ *           (mismos valores, terminos comunes calculados una vez), y
+ *           pares por microsegundo de path_planning_par().
+ * heuristica: largo y tiempo de la tabla de cuadrantes (DUBINS_HEURISTICA 1)
+ *           contra la palabra mas corta (DUBINS_HEURISTICA 0). La mas corta
+ *           nunca puede ser mas larga.
+ * lote:     dubins_largos_lote() contra las funciones t_*, p_* y q_* par
+ *           por par, y path_planning_lote() contra path_planning_par() en
+ *           un lazo. Las trayectorias tienen que tener el mismo largo.
+ * hilos:    path_planning_hilos() con 1 a PATH_PLANNING_HILOS_MAX hilos.
+ *           El resultado tiene que ser identico (memcmp) al de un hilo.
+ *
+ * Uso: ./dubins_bench [pares] [semilla]
+ * Devuelve 0 si todas las verificaciones dan bien, -1 si no.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include "path_planning.h"
+#include "dubins_lote.h"
+#include "path_planning_hilos.h"
+#include <uquad_aux_time.h>
+#include <uquad_error_codes.h>
+
+#define HOW_TO		"./dubins_bench [pares] [semilla]"
+#define BENCH_PARES	100000
+#define BENCH_LADO	500.0	// los way points caen en un cuadrado de 2*BENCH_LADO
+#define BENCH_TOL	1e-6	// [m] tolerancia al comparar largos
+#define BENCH_REPETIR	3	// se toma el mejor tiempo de las repeticiones
+
+typedef double (*tramo_f)(double a, double b, double d);
+
+/* Funciones t/p/q originales, indexadas por tipo_trayectoria_t */
+static const tramo_f bench_t[DUBINS_PALABRAS] = { t_lsl, t_lsr, t_rsr, t_rsl, t_rlr, t_lrl };
+static const tramo_f bench_p[DUBINS_PALABRAS] = { p_lsl, p_lsr, p_rsr, p_rsl, p_rlr, p_lrl };
+static const tramo_f bench_q[DUBINS_PALABRAS] = { q_lsl, q_lsr, q_rsr, q_rsl, q_rlr, q_lrl };
+
+static struct timespec bench_t0;
+static volatile double bench_sumidero;  // para que no se descarten los lazos
+
+static void bench_inicio(void)
+{
+    clock_gettime(CLOCK_MONOTONIC, &bench_t0);
+}
+
+/* Microsegundos desde bench_inicio() */
+static double bench_us(void)
+{
+    struct timespec t1;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    return uquad_timespec_diff_ns(&t1, &bench_t0)*1e-3;
+}
+
+/* Iguales, o los dos NaN (palabra no factible) */
+static int bench_iguales(double x, double y)
+{
+    return x == y || (isnan(x) && isnan(y));
+}
+
+/* Way points al azar; cada par consecutivo es un caso */
+static void bench_way_points(way_point_t *wp, int n)
+{
+    int i;
+    for (i = 0; i < n; i++) {
+        wp[i].x = BENCH_LADO*(2*drand48() - 1);
+        wp[i].y = BENCH_LADO*(2*drand48() - 1);
+        wp[i].z = 0;
+        wp[i].angulo = 2*pii*drand48();
+    }
+}
+
+/* Angulos y distancia de cada par en el sistema de path_planning_par() */
+static void bench_terna(const way_point_t *wp, int i, double *a, double *b, double *d)
+{
+    way_point_t pi, pf;
+    conversion_eje_coordenadas(&wp[i], &wp[i+1], &pi, &pf);
+    *a = pi.angulo;
+    *b = pf.angulo;
+    *d = pf.x/RADIO;
+}
+
+/* Largo que se recorre, sumando los tramos de trayectoria_segmentos() */
+static double bench_largo(const trayectoria_t *path)
+{
+    double largo = 0;
+    int k;
+    for (k = 0; k < 3; k++)
+        largo += (path->seg[k].giro == 'S') ? path->seg[k].largo : RADIO*path->seg[k].largo;
+    return largo;
+}
+
+static int bench_palabras(const way_point_t *wp, int pares, trayectoria_t *paths)
+{
+    dubins_palabra_t w[DUBINS_PALABRAS];
+    double a, b, d, sum = 0, us_tpq, us_palabras, us_par;
+    int i, k, distintos = 0;
+
+    // Mismos valores que las funciones originales
+    for (i = 0; i < pares; i++) {
+        bench_terna(wp, i, &a, &b, &d);
+        dubins_palabras(a, b, d, w);
+        for (k = 0; k < DUBINS_PALABRAS; k++)
+            if (!bench_iguales(w[k].t, bench_t[k](a, b, d)) ||
+                !bench_iguales(w[k].p, bench_p[k](a, b, d)) ||
+                !bench_iguales(w[k].q, bench_q[k](a, b, d)))
+                distintos++;
+    }
+
+    bench_inicio();
+    for (i = 0; i < pares; i++) {
+        bench_terna(wp, i, &a, &b, &d);
+        for (k = 0; k < DUBINS_PALABRAS; k++)
+            sum += bench_t[k](a, b, d) + bench_p[k](a, b, d) + bench_q[k](a, b, d);
+    }
+    us_tpq = bench_us();
+
+    bench_inicio();
+    for (i = 0; i < pares; i++) {
+        bench_terna(wp, i, &a, &b, &d);
+        dubins_palabras(a, b, d, w);
+        for (k = 0; k < DUBINS_PALABRAS; k++)
+            sum += w[k].t + w[k].p + w[k].q;
+    }
+    us_palabras = bench_us();
+
+    bench_inicio();
+    for (i = 0; i < pares; i++)
+        path_planning_par(&wp[i], &wp[i+1], &paths[i]);
+    us_par = bench_us();
+
+    printf("palabras\n");
+    printf("  palabras distintas a t/p/q: %d\n", distintos);
+    printf("  t_*/p_*/q_*:        %8.3f pares/us\n", pares/us_tpq);
+    printf("  dubins_palabras():  %8.3f pares/us (x%.2f)\n", pares/us_palabras, us_tpq/us_palabras);
+    printf("  path_planning_par(): %7.3f pares/us\n", pares/us_par);
+    bench_sumidero = sum;
+
+    return (distintos == 0) ? 0 : -1;
+}
+
+static int bench_heuristica(const way_point_t *wp, int pares, trayectoria_t *paths)
+{
+    trayectoria_t h;
+    double lh, lm, suma_h = 0, suma_m = 0, max_delta = 0, us_h, us_m;
+    int i, mas_cortas = 0, peores = 0, sin_solucion = 0, validos = 0;
+
+    for (i = 0; i < pares; i++) {
+        path_planning_par_heuristica(&wp[i], &wp[i+1], &h);
+        path_planning_par_minima(&wp[i], &wp[i+1], &paths[i]);
+        lh = bench_largo(&h);
+        lm = bench_largo(&paths[i]);
+        if (isnan(lm)) {
+            peores++;
+            continue;
+        }
+        if (isnan(lh)) {
+            // La tabla eligio una palabra no factible
+            sin_solucion++;
+            continue;
+        }
+        validos++;
+        suma_h += lh;
+        suma_m += lm;
+        if (lm < lh - BENCH_TOL)
+            mas_cortas++;
+        if (lm > lh + BENCH_TOL)
+            peores++;
+        if (lh - lm > max_delta)
+            max_delta = lh - lm;
+    }
+
+    bench_inicio();
+    for (i = 0; i < pares; i++)
+        path_planning_par_heuristica(&wp[i], &wp[i+1], &paths[i]);
+    us_h = bench_us();
+
+    bench_inicio();
+    for (i = 0; i < pares; i++)
+        path_planning_par_minima(&wp[i], &wp[i+1], &paths[i]);
+    us_m = bench_us();
+
+    printf("heuristica\n");
+    printf("  cuadrantes sin solucion: %d (%.2f%%, palabra no factible)\n",
+           sin_solucion, 100.0*sin_solucion/pares);
+    printf("  largo medio cuadrantes: %9.3f m\n", suma_h/validos);
+    printf("  largo medio minima:     %9.3f m (%.2f%% menos)\n", suma_m/validos, 100*(suma_h - suma_m)/suma_h);
+    printf("  pares mas cortos:       %d (%.1f%%), diferencia maxima %.3f m\n",
+           mas_cortas, 100.0*mas_cortas/pares, max_delta);
+    printf("  pares mas largos o sin solucion: %d\n", peores);
+    printf("  cuadrantes: %8.3f pares/us\n", pares/us_h);
+    printf("  minima:     %8.3f pares/us\n", pares/us_m);
+
+    return (peores == 0) ? 0 : -1;
+}
+
+static int bench_lote(const way_point_t *wp, int pares, trayectoria_t *paths)
+{
+    dubins_palabra_t w[DUBINS_PALABRAS];
+    trayectoria_t *escalar;
+    double *a, *b, *d, *largo;
+    double sum = 0, error, error_max = 0, us_tpq, us_lote, us_par, us_plote;
+    int i, k, factibles, fuera = 0, distintos = 0;
+
+    a = (double *)malloc(pares*sizeof(double));
+    b = (double *)malloc(pares*sizeof(double));
+    d = (double *)malloc(pares*sizeof(double));
+    largo = (double *)malloc(DUBINS_PALABRAS*pares*sizeof(double));
+    escalar = (trayectoria_t *)malloc(pares*sizeof(trayectoria_t));
+    if (a == NULL || b == NULL || d == NULL || largo == NULL || escalar == NULL) {
+        err_log_stderr("malloc()");
+        free(a); free(b); free(d); free(largo); free(escalar);
+        return -1;
+    }
+    for (i = 0; i < pares; i++)
+        bench_terna(wp, i, &a[i], &b[i], &d[i]);
+
+    // Largos de las seis palabras
+    bench_inicio();
+    for (i = 0; i < pares; i++)
+        for (k = 0; k < DUBINS_PALABRAS; k++)
+            sum += bench_t[k](a[i], b[i], d[i]) + bench_p[k](a[i], b[i], d[i]) + bench_q[k](a[i], b[i], d[i]);
+    us_tpq = bench_us();
+
+    bench_inicio();
+    dubins_largos_lote(pares, a, b, d, largo);
+    us_lote = bench_us();
+    bench_sumidero = sum + largo[0];
+
+    // Error de las aproximaciones, contra los tramos exactos
+    for (i = 0; i < pares; i++) {
+        factibles = dubins_palabras_exactas(a[i], b[i], d[i], w);
+        for (k = 0; k < DUBINS_PALABRAS; k++) {
+            if (!(factibles & (1 << k)))
+                continue;
+            error = fabs(w[k].t + w[k].p + w[k].q - largo[k*pares + i]);
+            if (error > DUBINS_LOTE_ERROR)
+                fuera++;        // tramos cerca de 0 o 2pi, path_planning_lote() los recalcula
+            else if (error > error_max)
+                error_max = error;
+        }
+    }
+
+    // Trayectorias completas
+    bench_inicio();
+    for (i = 0; i < pares; i++)
+        path_planning_par_minima(&wp[i], &wp[i+1], &escalar[i]);
+    us_par = bench_us();
+
+    bench_inicio();
+    path_planning_lote(wp, pares + 1, paths);
+    us_plote = bench_us();
+
+    for (i = 0; i < pares; i++)
+        if (!(fabs(bench_largo(&paths[i]) - bench_largo(&escalar[i])) <= BENCH_TOL))
+            distintos++;
+
+    printf("lote\n");
+    printf("  t_*/p_*/q_*:            %8.3f pares/us\n", pares/us_tpq);
+    printf("  dubins_largos_lote():   %8.3f pares/us (x%.2f)\n", pares/us_lote, us_tpq/us_lote);
+    printf("  error maximo:           %.2e (%d largos cerca de 0 o 2pi)\n", error_max, fuera);
+    printf("  path_planning_par():    %8.3f pares/us\n", pares/us_par);
+    printf("  path_planning_lote():   %8.3f pares/us (x%.2f)\n", pares/us_plote, us_par/us_plote);
+    printf("  trayectorias de distinto largo: %d\n", distintos);
+
+    free(a);
+    free(b);
+    free(d);
+    free(largo);
+    free(escalar);
+    return (distintos == 0) ? 0 : -1;
+}
+
+static int bench_hilos(const way_point_t *wp, int pares, trayectoria_t *paths)
+{
+    trayectoria_t *otro;
+    double us, us_min, us_1 = 0;
+    int hilos, r, igual, distintos = 0;
+
+    otro = (trayectoria_t *)malloc(pares*sizeof(trayectoria_t));
+    if (otro == NULL) {
+        err_log_stderr("malloc()");
+        return -1;
+    }
+
+    printf("hilos (%ld CPUs)\n", sysconf(_SC_NPROCESSORS_ONLN));
+    for (hilos = 1; hilos <= PATH_PLANNING_HILOS_MAX; hilos++) {
+        us_min = 0;
+        for (r = 0; r < BENCH_REPETIR; r++) {
+            memset(otro, 0, pares*sizeof(trayectoria_t));
+            bench_inicio();
+            if (path_planning_hilos(wp, pares + 1, otro, hilos) < 0) {
+                free(otro);
+                return -1;
+            }
+            us = bench_us();
+            if (r == 0 || us < us_min)
+                us_min = us;
+        }
+        igual = 1;
+        if (hilos == 1) {
+            us_1 = us_min;
+            memcpy(paths, otro, pares*sizeof(trayectoria_t));
+        } else if (memcmp(paths, otro, pares*sizeof(trayectoria_t)) != 0) {
+            igual = 0;
+            distintos++;
+        }
+        printf("  %d hilos: %8.3f pares/us, speedup %.2f%s\n", hilos, pares/us_min, us_1/us_min,
+               igual ? "" : " DISTINTO");
+    }
+
+    free(otro);
+    return (distintos == 0) ? 0 : -1;
+}
+
+int main(int argc, char *argv[])
+{
+    way_point_t *wp;
+    trayectoria_t *paths;
+    int pares = BENCH_PARES, retval = 0;
+    long semilla = 1;
+
+    if (argc > 1)
+        pares = atoi(argv[1]);
+    if (argc > 2)
+        semilla = atol(argv[2]);
+    if (pares < 1) {
+        err_log(HOW_TO);
+        return -1;
+    }
+
+    wp = (way_point_t *)malloc((pares + 1)*sizeof(way_point_t));
+    paths = (trayectoria_t *)malloc(pares*sizeof(trayectoria_t));
+    if (wp == NULL || paths == NULL) {
+        err_log_stderr("malloc()");
+        return -1;
+    }
+    srand48(semilla);
+    bench_way_points(wp, pares + 1);
+    printf("%d pares, semilla %ld\n", pares, semilla);
+
+    if (bench_palabras(wp, pares, paths) < 0)
+        retval = -1;
+    if (bench_heuristica(wp, pares, paths) < 0)
+        retval = -1;
+    if (bench_lote(wp, pares, paths) < 0)
+        retval = -1;
+    if (bench_hilos(wp, pares, paths) < 0)
+        retval = -1;
+
+    free(paths);
+    free(wp);
+    return retval;
+}
@@ -0,0 +1,205 @@
+#include <math.h>
+#include "dubins_lote.h"
+
+#define PIO2_HI 1.57079632679489655800e+00  // pi/2 en dos partes, para reducir
+#define PIO2_LO 6.12323399573676603587e-17  // el argumento sin perder precision
+#define PIO4    0.78539816339744830962
+#define TAN_PIO8 0.41421356237309504880
+
+/* floor() con una conversion a entero, que se vectoriza sin SSE4.1 */
+static inline double dl_floor(double x)
+{
+    double t = (double)(int)x;
+    return t - (double)(x < t);
+}
+
+static inline double dl_mod2pi(double x)
+{
+    return x - 2*pii*dl_floor(x/(2*pii));
+}
+
+/*
+ * sin y cos: reduccion a |r| <= pi/4 y serie de Taylor hasta r^11 y r^12.
+ * Error menor a 1e-11 para |x| < 1e6.
+ */
+static inline void dl_sincos(double x, double *s, double *c)
+{
+    double k = dl_floor(x*(1/PIO2_HI) + 0.5);
+    int q = (int)k;
+    double r = (x - k*PIO2_HI) - k*PIO2_LO;
+    double r2 = r*r;
+    double sr, cr, aux;
+
+    sr = r + r*r2*(-1.0/6 + r2*(1.0/120 + r2*(-1.0/5040 + r2*(1.0/362880 +
+         r2*(-1.0/39916800)))));
+    cr = 1 + r2*(-1.0/2 + r2*(1.0/24 + r2*(-1.0/720 + r2*(1.0/40320 +
+         r2*(-1.0/3628800 + r2*(1.0/479001600))))));
+
+    // Cuadrante
+    aux = (q & 1) ? cr : sr;
+    cr = (q & 1) ? -sr : cr;
+    *s = (q & 2) ? -aux : aux;
+    *c = (q & 2) ? -cr : cr;
+}
+
+/*
+ * atan2: reduccion a |z| <= tan(pi/8) y serie de Taylor hasta z^19.
+ * Error menor a 5e-10.
+ */
+static inline double dl_atan2(double y, double x)
+{
+    double ax = fabs(x), ay = fabs(y);
+    double mx = (ax > ay) ? ax : ay;
+    double mn = (ax > ay) ? ay : ax;
+    double z = (mx > 0) ? mn/mx : 0;
+    double off = (z > TAN_PIO8) ? PIO4 : 0;
+    double z2, r;
+
+    z = (z > TAN_PIO8) ? (z - 1)/(z + 1) : z;
+    z2 = z*z;
+    r = off + z + z*z2*(-1.0/3 + z2*(1.0/5 + z2*(-1.0/7 + z2*(1.0/9 +
+        z2*(-1.0/11 + z2*(1.0/13 + z2*(-1.0/15 + z2*(1.0/17 + z2*(-1.0/19)))))))));
+
+    r = (ay > ax) ? 2*PIO4 - r : r;
+    r = (x < 0) ? 4*PIO4 - r : r;
+    return (y < 0) ? -r : r;
+}
+
+/* Largos de un bloque de hasta DUBINS_LOTE_BLOQUE ternas */
+static void dubins_largos_bloque(int n, int stride, const double *a, const double *b, const double *d, double *largo)
+{
+    double sa[DUBINS_LOTE_BLOQUE], ca[DUBINS_LOTE_BLOQUE];
+    double sb[DUBINS_LOTE_BLOQUE], cb[DUBINS_LOTE_BLOQUE];
+    double cab[DUBINS_LOTE_BLOQUE], d2[DUBINS_LOTE_BLOQUE];
+    double * __restrict lsl = largo + LSL*stride;
+    double * __restrict lsr = largo + LSR*stride;
+    double * __restrict rsr = largo + RSR*stride;
+    double * __restrict rsl = largo + RSL*stride;
+    double * __restrict rlr = largo + RLR*stride;
+    double * __restrict lrl = largo + LRL*stride;
+    double p_sq, p, aux, phi, x, l;
+    int i;
+
+    // Un lazo corto por palabra, para que cada uno se pueda vectorizar.
+    // El largo se calcula siempre y despues se descarta si no es factible.
+    for (i = 0; i < n; i++) {
+        dl_sincos(a[i], &sa[i], &ca[i]);
+        dl_sincos(b[i], &sb[i], &cb[i]);
+        cab[i] = ca[i]*cb[i] + sa[i]*sb[i];
+        d2[i] = d[i]*d[i];
+    }
+
+    /** LSL, siempre factible */
+    for (i = 0; i < n; i++) {
+        p_sq = 2 + d2[i] - (2*cab[i]) + (2*d[i]*(sa[i] - sb[i]));
+        aux = dl_atan2(cb[i] - ca[i], d[i] + sa[i] - sb[i]);
+        lsl[i] = dl_mod2pi(aux - a[i]) + sqrt(fabs(p_sq)) + dl_mod2pi(b[i] - aux);
+    }
+
+    /** RSR, siempre factible */
+    for (i = 0; i < n; i++) {
+        p_sq = 2 + d2[i] - (2*cab[i]) + (2*d[i]*(sb[i] - sa[i]));
+        aux = dl_atan2(ca[i] - cb[i], d[i] - sa[i] + sb[i]);
+        rsr[i] = dl_mod2pi(a[i] - aux) + sqrt(fabs(p_sq)) + dl_mod2pi(aux - b[i]);
+    }
+
+    /** LSR */
+    for (i = 0; i < n; i++) {
+        p_sq = -2 + d2[i] + (2*cab[i]) + (2*d[i]*(sa[i] + sb[i]));
+        p = sqrt(fabs(p_sq));
+        aux = dl_atan2(-ca[i] - cb[i], d[i] + sa[i] + sb[i]) - dl_atan2(-2, p);
+        l = dl_mod2pi(aux - a[i]) + p + dl_mod2pi(aux - b[i]);
+        lsr[i] = (p_sq >= 0) ? l : HUGE_VAL;
+    }
+
+    /** RSL */
+    for (i = 0; i < n; i++) {
+        p_sq = -2 + d2[i] + (2*cab[i]) - (2*d[i]*(sa[i] + sb[i]));
+        p = sqrt(fabs(p_sq));
+        aux = dl_atan2(ca[i] + cb[i], d[i] - sa[i] - sb[i]) - dl_atan2(2, p);
+        l = dl_mod2pi(a[i] - aux) + p + dl_mod2pi(b[i] - aux);
+        rsl[i] = (p_sq >= 0) ? l : HUGE_VAL;
+    }
+
+    /** RLR, acos(x) = atan2(sqrt(1 - x^2), x) */
+    for (i = 0; i < n; i++) {
+        x = (6 - d2[i] + (2*cab[i]) + (2*d[i]*(sa[i] - sb[i])))/8;
+        phi = dl_atan2(ca[i] - cb[i], d[i] - sa[i] + sb[i]);
+        p = dl_mod2pi(4*PIO2_HI - dl_atan2(sqrt(fabs(1 - x*x)), x));
+        aux = dl_mod2pi(a[i] - phi + dl_mod2pi(p/2));
+        l = aux + p + dl_mod2pi(a[i] - b[i] - aux + p);
+        rlr[i] = (fabs(x) <= 1) ? l : HUGE_VAL;
+    }
+
+    /** LRL */
+    for (i = 0; i < n; i++) {
+        x = (6 - d2[i] + (2*cab[i]) + (2*d[i]*(sb[i] - sa[i])))/8;
+        phi = dl_atan2(ca[i] - cb[i], d[i] + sa[i] - sb[i]);
+        p = dl_mod2pi(4*PIO2_HI - dl_atan2(sqrt(fabs(1 - x*x)), x));
+        aux = dl_mod2pi(-a[i] - phi + p/2);
+        l = aux + p + dl_mod2pi(b[i] - a[i] - aux + p);
+        lrl[i] = (fabs(x) <= 1) ? l : HUGE_VAL;
+    }
+}
+
+void dubins_largos_lote(int n, const double *a, const double *b, const double *d, double *largo)
+{
+    int base, m;
+
+    for (base = 0; base < n; base += m) {
+        m = (n - base < DUBINS_LOTE_BLOQUE) ? n - base : DUBINS_LOTE_BLOQUE;
+        dubins_largos_bloque(m, n, a + base, b + base, d + base, largo + base);
+    }
+}
+
+void dubins_minima_lote(int n, const double *largo, tipo_trayectoria_t *tipo)
+{
+    int i, w;
+
+    for (i = 0; i < n; i++) {
+        double minimo = largo[i];
+        int mejor = LSL;
+        for (w = LSL + 1; w <= LRL; w++) {
+            mejor = (largo[w*n + i] < minimo) ? w : mejor;
+            minimo = (largo[w*n + i] < minimo) ? largo[w*n + i] : minimo;
+        }
+        tipo[i] = (tipo_trayectoria_t)mejor;
+    }
+}
+
+void path_planning_lote(const way_point_t *wp, int n, trayectoria_t *paths)
+{
+    double a[DUBINS_LOTE_BLOQUE], b[DUBINS_LOTE_BLOQUE], d[DUBINS_LOTE_BLOQUE];
+    double largo[DUBINS_PALABRAS*DUBINS_LOTE_BLOQUE];
+    tipo_trayectoria_t tipo[DUBINS_LOTE_BLOQUE];
+    dubins_palabra_t w[DUBINS_PALABRAS];
+    way_point_t p_inicial_conv, p_final_conv;
+    int base, m, i, factibles;
+
+    for (base = 0; base < n - 1; base += m) {
+        m = n - 1 - base;
+        if (m > DUBINS_LOTE_BLOQUE)
+            m = DUBINS_LOTE_BLOQUE;
+
+        // Paso cada par al sistema de coordenadas de Dubins
+        for (i = 0; i < m; i++) {
+            conversion_eje_coordenadas(&wp[base + i], &wp[base + i + 1], &p_inicial_conv, &p_final_conv);
+            a[i] = p_inicial_conv.angulo;
+            b[i] = p_final_conv.angulo;
+            d[i] = p_final_conv.x/RADIO;
+        }
+
+        dubins_largos_lote(m, a, b, d, largo);
+        dubins_minima_lote(m, largo, tipo);
+
+        // Tramos exactos solo de la palabra elegida
+        for (i = 0; i < m; i++) {
+            if (!dubins_palabra_exacta(tipo[i], a[i], b[i], d[i], w) ||
+                fabs(w[tipo[i]].t + w[tipo[i]].p + w[tipo[i]].q - largo[tipo[i]*m + i]) > 1e3*DUBINS_LOTE_ERROR) {
+                factibles = dubins_palabras_exactas(a[i], b[i], d[i], w);
+                tipo[i] = eleccion_curva_dubins_minima(w, factibles);
+            }
+            find_path_dubins(tipo[i], &wp[base + i], &wp[base + i + 1], w, &paths[base + i]);
+        }
+    }
+}
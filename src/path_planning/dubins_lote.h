@@ -0,0 +1,53 @@
+#ifndef DUBINS_LOTE_H
+#define DUBINS_LOTE_H
+
+#include "path_planning.h"
+
+/**
+ * Evaluacion en lote de las palabras de Dubins, pensada para misiones con
+ * muchos way points. Las entradas y salidas son arreglos separados (SoA)
+ * y el lazo no tiene saltos, para que el compilador lo vectorice.
+ *
+ * Se usan aproximaciones de sin, cos y atan2 con error absoluto menor a
+ * DUBINS_LOTE_ERROR (en radianes). Sirven para elegir la palabra; la
+ * geometria se calcula despues con dubins_palabras_exactas().
+ */
+
+#define DUBINS_LOTE_ERROR 1e-8  // cota del error de cada largo (dividido el RADIO)
+#define DUBINS_LOTE_BLOQUE 64   // pares de way points evaluados por bloque (en el stack)
+
+/**
+ * Largo (dividido el RADIO) de las seis palabras para n ternas (a, b, d).
+ *
+ * @param n cantidad de ternas
+ * @param a angulos alpha
+ * @param b angulos beta
+ * @param d distancias (divididas el RADIO)
+ * @param largo salida, largo[tipo*n + i] es el largo de la palabra tipo
+ *        para la terna i. HUGE_VAL si la palabra no es factible.
+ */
+void dubins_largos_lote(int n, const double *a, const double *b, const double *d, double *largo);
+
+/**
+ * Palabra de menor largo para cada terna.
+ *
+ * @param n cantidad de ternas
+ * @param largo salida de dubins_largos_lote()
+ * @param tipo salida, palabra elegida para cada terna
+ */
+void dubins_minima_lote(int n, const double *largo, tipo_trayectoria_t *tipo);
+
+/**
+ * Trayectorias para los n-1 pares consecutivos de wp, sin malloc.
+ * Los pares se procesan en bloques de DUBINS_LOTE_BLOQUE: se eligen las
+ * palabras con dubins_largos_lote() y se calculan en forma exacta solo
+ * las elegidas. Si la palabra elegida no coincide con su largo exacto
+ * (empates o tramos cerca de 0 o 2pi) se evaluan las seis en forma exacta.
+ *
+ * @param wp way points
+ * @param n cantidad de way points
+ * @param paths salida, n-1 trayectorias
+ */
+void path_planning_lote(const way_point_t *wp, int n, trayectoria_t *paths);
+
+#endif
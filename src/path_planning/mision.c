@@ -0,0 +1,322 @@
+#define _GNU_SOURCE     // strtod_l()
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <locale.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "mision.h"
+#include <uquad_error_codes.h>
+
+#define MANTISA_MAX	1000000000000000000ULL	// 10^18, por encima no entra otro digito
+#define DOS_53		9007199254740992ULL	// enteros representables en un double
+#define TOKEN_MAX	64			// largo de la copia para strtod_l()
+
+/* Potencias de 10 exactas en double */
+static const double pot10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static inline int es_digito(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+static inline int es_blanco(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+/* Casos que no resuelve el camino rapido: strtod_l() sobre una copia del
+ * numero (el texto no termina en '\0'), siempre con el locale "C" */
+static double mision_strtod(const char *p, const char *fin)
+{
+    static locale_t loc_c = (locale_t)0;
+    char tmp[TOKEN_MAX], *s = tmp;
+    size_t len = fin - p;
+    double r;
+
+    if (loc_c == (locale_t)0)
+        loc_c = newlocale(LC_NUMERIC_MASK, "C", (locale_t)0);
+
+    if (len >= sizeof(tmp)) {
+        s = (char *)malloc(len + 1);
+        if (s == NULL)
+            return NAN;
+    }
+    memcpy(s, p, len);
+    s[len] = '\0';
+
+    r = (loc_c != (locale_t)0) ? strtod_l(s, NULL, loc_c) : strtod(s, NULL);
+
+    if (s != tmp)
+        free(s);
+    return r;
+}
+
+const char *mision_parse_double(const char *p, const char *fin, double *v)
+{
+    uint64_t m = 0;
+    int e10 = 0, exp = 0, digitos = 0, neg = 0, exp_neg = 0, truncado = 0;
+    const char *q, *inicio = p;
+    double r;
+
+    if (p < fin && (*p == '+' || *p == '-'))
+        neg = (*p++ == '-');
+
+    for (; p < fin && es_digito(*p); p++, digitos++) {
+        if (m < MANTISA_MAX)
+            m = m*10 + (*p - '0');
+        else {
+            e10++;              // digito que no entra, cuenta como escala
+            truncado |= (*p != '0');
+        }
+    }
+    if (p < fin && *p == '.') {
+        for (p++; p < fin && es_digito(*p); p++, digitos++) {
+            if (m < MANTISA_MAX) {
+                m = m*10 + (*p - '0');
+                e10--;
+            } else
+                truncado |= (*p != '0');
+        }
+    }
+    if (digitos == 0)
+        return NULL;
+
+    if (p < fin && (*p == 'e' || *p == 'E')) {
+        q = p + 1;
+        if (q < fin && (*q == '+' || *q == '-'))
+            exp_neg = (*q++ == '-');
+        if (q < fin && es_digito(*q)) {
+            for (; q < fin && es_digito(*q); q++)
+                if (exp < 10000)
+                    exp = exp*10 + (*q - '0');
+            e10 += exp_neg ? -exp : exp;
+            p = q;
+        }
+    }
+
+    // Camino rapido exacto (Clinger): mantisa y potencia de 10 exactas, una
+    // sola operacion redondeada. Con e10 > 22 se pasan ceros a la mantisa
+    // mientras siga siendo exacta (ej: 415e24 = 415000e21)
+    if (!truncado && e10 > 22 && e10 <= 22 + 15)
+        for (; e10 > 22 && m*10 <= DOS_53; e10--)
+            m *= 10;
+
+    if (m == 0)
+        r = 0;
+    else if (!truncado && m <= DOS_53 && e10 >= -22 && e10 <= 22)
+        r = (e10 < 0) ? (double)m/pot10[-e10] : (double)m*pot10[e10];
+    else {
+        *v = mision_strtod(inicio, p);      // incluye el signo
+        return p;
+    }
+
+    *v = neg ? -r : r;
+    return p;
+}
+
+int mision_parse_txt(const char *txt, size_t len, way_point_t *wp, int max)
+{
+    const char *p = txt, *fin = txt + len, *inicio_linea = txt, *q;
+    double campos[4];
+    int n = 0, n_campos = 0, linea = 1;
+
+    while (1) {
+        // Salteo blancos
+        while (p < fin && es_blanco(*p)) {
+            if (*p == '\n') {
+                linea++;
+                inicio_linea = p + 1;
+            }
+            p++;
+        }
+        if (p == fin)
+            break;
+
+        q = mision_parse_double(p, fin, &campos[n_campos]);
+        if (q == NULL || (q < fin && !es_blanco(*q))) {
+            if (q != NULL)
+                p = q;
+            err_log_num_num("Valor invalido en linea/columna", linea, (int)(p - inicio_linea) + 1);
+            return -1;
+        }
+        p = q;
+
+        if (++n_campos == 4) {
+            n_campos = 0;
+            if (wp == NULL) {
+                n++;            // solo se cuentan
+                continue;
+            }
+            if (n >= max) {
+                err_log("Demasiados way points");
+                return -1;
+            }
+            wp[n].x = campos[0];
+            wp[n].y = campos[1];
+            wp[n].z = campos[2];
+            wp[n].angulo = conversion_grados2rad(campos[3]);
+            n++;
+        }
+    }
+
+    if (n_campos != 0 && wp != NULL)
+        err_log("WARN: el ultimo way point esta incompleto, se descarta");
+
+    return n;
+}
+
+/* Mapea el archivo entero, solo lectura */
+static int mapear(const char *path, void **base, size_t *len)
+{
+    struct stat st;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        err_log_stderr("open()");
+        return -1;
+    }
+    if (fstat(fd, &st) < 0) {
+        err_log_stderr("fstat()");
+        close(fd);
+        return -1;
+    }
+
+    *len = (size_t)st.st_size;
+    *base = NULL;
+    if (*len > 0) {
+        *base = mmap(NULL, *len, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (*base == MAP_FAILED) {
+            err_log_stderr("mmap()");
+            close(fd);
+            return -1;
+        }
+    }
+
+    // El mapeo sigue valido despues de cerrar el fd
+    close(fd);
+    return 0;
+}
+
+/* Verifica el encabezado de una mision binaria ya mapeada */
+static int mision_bin_valida(const void *base, size_t len)
+{
+    const mision_hdr_t *hdr = (const mision_hdr_t *)base;
+
+    if (len < MISION_HDR_SIZE || memcmp(hdr->magic, MISION_MAGIC, sizeof(MISION_MAGIC)) != 0)
+        return 0;
+    if (hdr->version != MISION_VERSION || hdr->wp_size != sizeof(way_point_t)) {
+        err_log("Version de mision binaria no soportada");
+        return 0;
+    }
+    if (hdr->n > (len - MISION_HDR_SIZE)/sizeof(way_point_t)) {
+        err_log("Mision binaria truncada");
+        return 0;
+    }
+    return 1;
+}
+
+int mision_map_abrir(const char *path, mision_map_t *m)
+{
+    if (mapear(path, &m->base, &m->len) < 0)
+        return -1;
+
+    if (m->base == NULL || !mision_bin_valida(m->base, m->len)) {
+        err_log("No es una mision binaria");
+        mision_map_cerrar(m);
+        return -1;
+    }
+
+    m->wp = (const way_point_t *)((const char *)m->base + MISION_HDR_SIZE);
+    m->n = (int)((const mision_hdr_t *)m->base)->n;
+    return 0;
+}
+
+void mision_map_cerrar(mision_map_t *m)
+{
+    if (m->base != NULL)
+        munmap(m->base, m->len);
+    m->base = NULL;
+    m->wp = NULL;
+    m->n = 0;
+}
+
+int mision_guardar_bin(const char *path, const way_point_t *wp, int n)
+{
+    mision_hdr_t hdr;
+    FILE *file;
+    int ok;
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, MISION_MAGIC, sizeof(MISION_MAGIC));
+    hdr.version = MISION_VERSION;
+    hdr.wp_size = sizeof(way_point_t);
+    hdr.n = (uint64_t)n;
+
+    file = fopen(path, "wb");
+    if (file == NULL) {
+        err_log_stderr("fopen()");
+        return -1;
+    }
+    ok = fwrite(&hdr, sizeof(hdr), 1, file) == 1 &&
+         (n == 0 || fwrite(wp, sizeof(way_point_t), n, file) == (size_t)n);
+    if (fclose(file) != 0)
+        ok = 0;
+    if (!ok) {
+        err_log("No se pudo escribir la mision");
+        return -1;
+    }
+    return 0;
+}
+
+int mision_cargar(const char *path, wp_buff_t *wp_buff)
+{
+    const mision_hdr_t *hdr;
+    void *base;
+    size_t len;
+    int n, retval = 0;
+
+    if (mapear(path, &base, &len) < 0)
+        return -1;
+    if (base == NULL)
+        return 0;               // archivo vacio, sin way points
+
+    // El buffer se reserva con la cantidad de way points de la mision.
+    // wp_buff_reservar() falla si ya se reciclaron lugares, asi que a partir
+    // de wp[tamano] el arreglo es plano y se escribe directo
+    if (mision_bin_valida(base, len)) {
+        hdr = (const mision_hdr_t *)base;
+        if (hdr->n > (uint64_t)(INT_MAX - wp_buff->tamano)) {
+            err_log("Demasiados way points");
+            retval = -1;
+        } else if (wp_buff_reservar(wp_buff, wp_buff->tamano + (int)hdr->n) < 0) {
+            retval = -1;
+        } else {
+            memcpy(&wp_buff->wp[wp_buff->tamano], (const char *)base + MISION_HDR_SIZE,
+                   hdr->n*sizeof(way_point_t));
+            wp_buff->tamano += (int)hdr->n;
+        }
+    } else {
+        n = mision_parse_txt((const char *)base, len, NULL, 0);
+        if (n < 0 || wp_buff_reservar(wp_buff, wp_buff->tamano + n) < 0)
+            retval = -1;
+        else {
+            n = mision_parse_txt((const char *)base, len, &wp_buff->wp[wp_buff->tamano],
+                                 wp_buff->capacidad - wp_buff->tamano);
+            if (n < 0)
+                retval = -1;
+            else
+                wp_buff->tamano += n;
+        }
+    }
+
+    munmap(base, len);
+    return retval;
+}
@@ -0,0 +1,108 @@
+#ifndef MISION_H
+#define MISION_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "path_planning.h"
+
+/**
+ * Carga de misiones (listas de way points).
+ *
+ * Formato de texto: cuatro numeros por way point separados por blancos
+ * (x y z angulo, angulo en grados), como lo leia way_points_input() con
+ * fscanf. Se lee con mmap y un parser propio que no depende del locale y
+ * reporta linea y columna de los errores.
+ *
+ * Formato binario: mision_hdr_t seguido de n way_point_t (angulo en
+ * radianes), en el orden de bytes de la maquina. Se carga con mmap sin
+ * procesar nada. Se genera con mision2bin.
+ */
+
+#define MISION_MAGIC	"UQMIS01"	// 8 bytes con el '\0'
+#define MISION_VERSION	1
+#define MISION_HDR_SIZE	32		// los way points arrancan alineados
+
+typedef struct mision_hdr {
+    char magic[8];
+    uint32_t version;
+    uint32_t wp_size;           // sizeof(way_point_t)
+    uint64_t n;                 // cantidad de way points
+    uint64_t reservado;
+} mision_hdr_t;
+
+/**
+ * Mision binaria mapeada en memoria.
+ */
+typedef struct mision_map {
+    void *base;
+    size_t len;
+    const way_point_t *wp;      // apunta dentro del archivo
+    int n;
+} mision_map_t;
+
+/**
+ * Lee un numero en formato decimal ([+-]digitos[.digitos][(e|E)[+-]digitos]),
+ * siempre con '.' como separador. El resultado es el double mas cercano,
+ * igual que strtod: los casos que no se resuelven con una sola operacion
+ * exacta se pasan a strtod_l() con el locale "C".
+ *
+ * @param p comienzo del numero
+ * @param fin fin del texto
+ * @param v valor leido
+ *
+ * @return puntero al caracter siguiente al numero, NULL si no hay un numero
+ */
+const char *mision_parse_double(const char *p, const char *fin, double *v);
+
+/**
+ * Lee way points de un texto en memoria.
+ *
+ * @param txt
+ * @param len
+ * @param wp salida (angulos en radianes), NULL para solo contarlos
+ * @param max lugares en wp
+ *
+ * @return cantidad de way points, -1 si hay un valor invalido (se reporta
+ *         linea y columna) o no entran en wp
+ */
+int mision_parse_txt(const char *txt, size_t len, way_point_t *wp, int max);
+
+/**
+ * Mapea una mision binaria.
+ *
+ * @param path
+ * @param m
+ *
+ * @return 0 si OK, -1 si no se puede abrir o no es una mision valida
+ */
+int mision_map_abrir(const char *path, mision_map_t *m);
+
+/**
+ * @param m
+ */
+void mision_map_cerrar(mision_map_t *m);
+
+/**
+ * Guarda una mision en formato binario.
+ *
+ * @param path
+ * @param wp
+ * @param n
+ *
+ * @return 0 si OK, -1 si no
+ */
+int mision_guardar_bin(const char *path, const way_point_t *wp, int n);
+
+/**
+ * Carga una mision de texto o binaria (se reconoce por MISION_MAGIC) y
+ * agrega sus way points al buffer. El buffer se agranda con
+ * wp_buff_reservar() segun la cantidad de way points de la mision.
+ *
+ * @param path
+ * @param wp_buff
+ *
+ * @return 0 si OK, -1 si no
+ */
+int mision_cargar(const char *path, wp_buff_t *wp_buff);
+
+#endif
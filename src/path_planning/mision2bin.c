@@ -0,0 +1,60 @@
+/**
+ * Convierte una mision de texto (x y z angulo[grados] por way point) al
+ * formato binario de mision.h, que se carga al arrancar sin procesar.
+ *
+ * Uso: ./mision2bin <mision de texto> <mision binaria>
+ */
+
+#include <stdlib.h>
+#include <sys/stat.h>
+#include "mision.h"
+#include <uquad_error_codes.h>
+
+#define HOW_TO	"./mision2bin <mision de texto> <mision binaria>"
+
+int main(int argc, char *argv[])
+{
+    way_point_t *wp;
+    FILE *in;
+    char *txt;
+    struct stat st;
+    size_t len;
+    int n, max;
+
+    if (argc < 3) {
+        err_log(HOW_TO);
+        return -1;
+    }
+
+    in = fopen(argv[1], "r");
+    if (in == NULL || fstat(fileno(in), &st) < 0) {
+        err_log_stderr("fopen()");
+        return -1;
+    }
+    len = (size_t)st.st_size;
+    txt = (char *)malloc(len + 1);
+    if (txt == NULL || fread(txt, 1, len, in) != len) {
+        err_log("No se pudo leer la mision");
+        return -1;
+    }
+    fclose(in);
+
+    // Cada way point ocupa al menos 8 caracteres ("0 0 0 0\n")
+    max = (int)(len/8) + 1;
+    wp = (way_point_t *)malloc(max*sizeof(way_point_t));
+    if (wp == NULL) {
+        err_log_stderr("malloc()");
+        return -1;
+    }
+
+    n = mision_parse_txt(txt, len, wp, max);
+    if (n < 0)
+        return -1;
+    if (mision_guardar_bin(argv[2], wp, n) < 0)
+        return -1;
+
+    printf("%d way points\n", n);
+    free(wp);
+    free(txt);
+    return 0;
+}
@@ -3,7 +3,11 @@
 #include <math.h>
 #include <complex.h>
 #include "path_planning.h"
+#include "dubins_lote.h"
+#include "path_planning_hilos.h"
+#include "mision.h"
 #include <uquad_error_codes.h>
+#include <uquad_aux_angle.h>
 
 double conversion_grados2rad(double grados)
 {
@@ -12,50 +16,32 @@ double conversion_grados2rad(double grados)
 
 double mod2pi(double angulo)
 {
-    double retval = angulo;
-    while (retval >= 2*pii)
-        retval = retval - 2*pii;
-    while (retval < 0)
-        retval = retval + 2*pii;
-
-    return retval;
+    return uquad_angle_wrap_2pi(angulo);
 }
 
-int way_points_input(Lista_wp *wp_lista)
+int way_points_input(wp_buff_t *wp_buff)
 {
-    int retval;
-    way_point_t wp;
-
-    FILE *file;
-    file = fopen(WAYPOINTS_FILE, "r");
-    if (file == NULL) {
-        err_log("No se pudo abrir el archivo");
-	return -1;
-    }
-
-    while(1) {
-        retval = fscanf(file, "%lf%lf%lf%lf", &wp.x,&wp.y,&wp.z,&wp.angulo);
-        if (retval <= 0)
-            break;
-        wp.angulo = conversion_grados2rad(wp.angulo);
-        InsercionEnLista_wp(wp_lista, wp);
+    // Texto o binario, ver mision.h
+    if (mision_cargar(WAYPOINTS_FILE, wp_buff) < 0) {
+        err_log("No se pudo cargar el archivo");
+        return -1;
     }
 
-    fclose(file);
-
     return 0;
 }
 
-void conversion_eje_coordenadas(way_point_t *p_inicial_src, way_point_t *p_final_src, way_point_t *p_inicial_dest, way_point_t *p_final_dest)
+void conversion_eje_coordenadas(const way_point_t *p_inicial_src, const way_point_t *p_final_src, way_point_t *p_inicial_dest, way_point_t *p_final_dest)
 {
-    double aux = atan2(p_final_src->y - p_inicial_src->y, p_final_src->x - p_inicial_src->x);
+    double dx = p_final_src->x - p_inicial_src->x;
+    double dy = p_final_src->y - p_inicial_src->y;
+    double aux = atan2(dy, dx);
 
     p_inicial_dest->x = 0;
     p_inicial_dest->y = 0;
     p_inicial_dest->z = 0;
     p_inicial_dest->angulo = mod2pi(p_inicial_src->angulo - aux);
 
-    p_final_dest->x = sqrt(pow(p_final_src->x - p_inicial_src->x, 2) + pow(p_final_src->y - p_inicial_src->y, 2));
+    p_final_dest->x = sqrt(dx*dx + dy*dy);
     p_final_dest->y = 0;
     p_final_dest->z = 0;
     p_final_dest->angulo = mod2pi(p_final_src->angulo - aux);
@@ -63,7 +49,7 @@ void conversion_eje_coordenadas(way_point_t *p_inicial_src, way_point_t *p_final
     return;
 }
 
-cuadrantes_t determinacion_cuadrantes(way_point_t *p_inicial, way_point_t *p_final)
+cuadrantes_t determinacion_cuadrantes(const way_point_t *p_inicial, const way_point_t *p_final)
 {
     cuadrantes_t cuad;
 
@@ -121,7 +107,7 @@ double t_lsl(double a, double b, double d)
 }
 double p_lsl(double a, double b, double d)
 {
-    return sqrt(2 + pow(d,2) - (2*cos(a - b)) + (2*d*(sin(a) - sin(b))));
+    return sqrt(2 + d*d - (2*cos(a - b)) + (2*d*(sin(a) - sin(b))));
 }
 double q_lsl(double a, double b, double d)
 {
@@ -135,7 +121,7 @@ double t_rsr(double a, double b, double d)
 }
 double p_rsr(double a, double b, double d)
 {
-    return sqrt(2 + pow(d,2) - (2*cos(a - b)) + (2*d*(sin(b) - sin(a))));
+    return sqrt(2 + d*d - (2*cos(a - b)) + (2*d*(sin(b) - sin(a))));
 }
 double q_rsr(double a, double b, double d)
 {
@@ -149,7 +135,7 @@ double t_lsr(double a, double b, double d)
 }
 double p_lsr(double a, double b, double d)
 {
-    return sqrt(-2 + pow(d,2) + (2*cos(a - b)) + (2*d*(sin(a) + sin(b))));
+    return sqrt(-2 + d*d + (2*cos(a - b)) + (2*d*(sin(a) + sin(b))));
 }
 double q_lsr(double a, double b, double d)
 {
@@ -163,7 +149,7 @@ double t_rsl(double a, double b, double d)
 }
 double p_rsl(double a, double b, double d)
 {
-    return sqrt(pow(d,2) -2 + (2*cos(a - b)) - (2*d*(sin(a) + sin(b))));
+    return sqrt(d*d -2 + (2*cos(a - b)) - (2*d*(sin(a) + sin(b))));
 }
 double q_rsl(double a, double b, double d)
 {
@@ -177,7 +163,7 @@ double t_rlr(double a, double b, double d)
 }
 double p_rlr(double a, double b, double d)
 {
-    return acos((6 - pow(d,2) + (2*cos(a - b)) + (2*d*(sin(a) - sin(b))))/8);
+    return acos((6 - d*d + (2*cos(a - b)) + (2*d*(sin(a) - sin(b))))/8);
 }
 double q_rlr(double a, double b, double d)
 {
@@ -191,13 +177,193 @@ double t_lrl(double a, double b, double d)
 }
 double p_lrl(double a, double b, double d)
 {
-    return mod2pi(acos((6 - pow(d,2) + (2*cos(a - b)) + (2*d*(sin(a) - sin(b))))/8));
+    return mod2pi(acos((6 - d*d + (2*cos(a - b)) + (2*d*(sin(a) - sin(b))))/8));
 }
 double q_lrl(double a, double b, double d)
 {
     return mod2pi(b) - a + (2*mod2pi(p_lrl(a,b,d)));
 }
 
+void dubins_palabras(double a, double b, double d, dubins_palabra_t w[DUBINS_PALABRAS])
+{
+    // Terminos comunes a todas las palabras
+    double sa = sin(a), ca = cos(a);
+    double sb = sin(b), cb = cos(b);
+    double cab = cos(a - b);
+    double d2 = d*d;
+    double mb = mod2pi(b);
+    double aux;
+
+    /** LSL */
+    aux = mod2pi(atan2(cb - ca, d + sa - sb));
+    w[LSL].t = -a + aux;
+    w[LSL].p = sqrt(2 + d2 - (2*cab) + (2*d*(sa - sb)));
+    w[LSL].q = b - aux;
+
+    /** RSR */
+    aux = mod2pi(atan2(ca - cb, d - sa + sb));
+    w[RSR].t = a - aux;
+    w[RSR].p = sqrt(2 + d2 - (2*cab) + (2*d*(sb - sa)));
+    w[RSR].q = -mb + aux;
+
+    /** LSR */
+    w[LSR].p = sqrt(-2 + d2 + (2*cab) + (2*d*(sa + sb)));
+    aux = atan2(-ca - cb, d + sa + sb);
+    w[LSR].t = mod2pi(-a + aux - atan2(-2, w[LSR].p));
+    w[LSR].q = -mb + aux - mod2pi(atan2(-2, w[LSR].p));
+
+    /** RSL */
+    w[RSL].p = sqrt(d2 -2 + (2*cab) - (2*d*(sa + sb)));
+    aux = atan2(ca + cb, d - sa - sb);
+    w[RSL].t = a - aux + mod2pi(atan2(2, w[RSL].p));
+    w[RSL].q = mb - aux + mod2pi(atan2(2, w[RSL].p));
+
+    /** RLR */
+    aux = acos((6 - d2 + (2*cab) + (2*d*(sa - sb)))/8);
+    w[RLR].p = aux;
+    w[RLR].t = a - atan2(ca - cb, d - sa + sb) + mod2pi(aux);
+    w[RLR].q = a - b - w[RLR].t + mod2pi(aux);
+
+    /** LRL */
+    w[LRL].p = mod2pi(aux);
+    w[LRL].t = mod2pi(-a + atan2(-ca + cb, d + sa - sb) + (w[LRL].p/2));
+    w[LRL].q = mb - a + (2*mod2pi(w[LRL].p));
+
+    return;
+}
+
+/* Terminos comunes a las seis palabras */
+typedef struct dubins_terminos {
+    double a, b, d;
+    double sa, ca, sb, cb, cab, d2;
+} dubins_terminos_t;
+
+static void dubins_terminos(double a, double b, double d, dubins_terminos_t *k)
+{
+    k->a = a;
+    k->b = b;
+    k->d = d;
+    k->sa = sin(a);
+    k->ca = cos(a);
+    k->sb = sin(b);
+    k->cb = cos(b);
+    k->cab = cos(a - b);
+    k->d2 = d*d;
+}
+
+/* Tramos de una palabra, devuelve 0 si no es factible */
+static int dubins_palabra(tipo_trayectoria_t tipo, const dubins_terminos_t *k, dubins_palabra_t *w)
+{
+    double a = k->a, b = k->b, d = k->d;
+    double sa = k->sa, ca = k->ca, sb = k->sb, cb = k->cb;
+    double p_sq, aux, phi;
+
+    switch (tipo) {
+    case LSL:
+        p_sq = 2 + k->d2 - (2*k->cab) + (2*d*(sa - sb));
+        if (p_sq < 0)
+            return 0;
+        aux = atan2(cb - ca, d + sa - sb);
+        w->t = mod2pi(aux - a);
+        w->p = sqrt(p_sq);
+        w->q = mod2pi(b - aux);
+        return 1;
+
+    case RSR:
+        p_sq = 2 + k->d2 - (2*k->cab) + (2*d*(sb - sa));
+        if (p_sq < 0)
+            return 0;
+        aux = atan2(ca - cb, d - sa + sb);
+        w->t = mod2pi(a - aux);
+        w->p = sqrt(p_sq);
+        w->q = mod2pi(aux - b);
+        return 1;
+
+    case LSR:
+        p_sq = -2 + k->d2 + (2*k->cab) + (2*d*(sa + sb));
+        if (p_sq < 0)
+            return 0;
+        w->p = sqrt(p_sq);
+        aux = atan2(-ca - cb, d + sa + sb) - atan2(-2, w->p);
+        w->t = mod2pi(aux - a);
+        w->q = mod2pi(aux - b);
+        return 1;
+
+    case RSL:
+        p_sq = -2 + k->d2 + (2*k->cab) - (2*d*(sa + sb));
+        if (p_sq < 0)
+            return 0;
+        w->p = sqrt(p_sq);
+        aux = atan2(ca + cb, d - sa - sb) - atan2(2, w->p);
+        w->t = mod2pi(a - aux);
+        w->q = mod2pi(b - aux);
+        return 1;
+
+    case RLR:
+        aux = (6 - k->d2 + (2*k->cab) + (2*d*(sa - sb)))/8;
+        if (fabs(aux) > 1)
+            return 0;
+        phi = atan2(ca - cb, d - sa + sb);
+        w->p = mod2pi(2*pii - acos(aux));
+        w->t = mod2pi(a - phi + mod2pi(w->p/2));
+        w->q = mod2pi(a - b - w->t + w->p);
+        return 1;
+
+    case LRL:
+        aux = (6 - k->d2 + (2*k->cab) + (2*d*(sb - sa)))/8;
+        if (fabs(aux) > 1)
+            return 0;
+        phi = atan2(ca - cb, d + sa - sb);
+        w->p = mod2pi(2*pii - acos(aux));
+        w->t = mod2pi(-a - phi + w->p/2);
+        w->q = mod2pi(b - a - w->t + w->p);
+        return 1;
+    }
+
+    return 0;
+}
+
+int dubins_palabras_exactas(double a, double b, double d, dubins_palabra_t w[DUBINS_PALABRAS])
+{
+    dubins_terminos_t k;
+    tipo_trayectoria_t tipo;
+    int factibles = 0;
+
+    dubins_terminos(a, b, d, &k);
+    for (tipo = LSL; tipo <= LRL; tipo++)
+        if (dubins_palabra(tipo, &k, &w[tipo]))
+            factibles |= 1 << tipo;
+
+    return factibles;
+}
+
+int dubins_palabra_exacta(tipo_trayectoria_t tipo, double a, double b, double d, dubins_palabra_t w[DUBINS_PALABRAS])
+{
+    dubins_terminos_t k;
+
+    dubins_terminos(a, b, d, &k);
+    return dubins_palabra(tipo, &k, &w[tipo]);
+}
+
+tipo_trayectoria_t eleccion_curva_dubins_minima(const dubins_palabra_t w[DUBINS_PALABRAS], int factibles)
+{
+    // LSL y RSR son siempre factibles (p_sq es una suma de cuadrados)
+    tipo_trayectoria_t tipo, mejor = LSL;
+    double largo, minimo = -1;
+
+    for (tipo = LSL; tipo <= LRL; tipo++) {
+        if (!(factibles & (1 << tipo)))
+            continue;
+        largo = w[tipo].t + w[tipo].p + w[tipo].q;
+        if (minimo < 0 || largo < minimo) {
+            minimo = largo;
+            mejor = tipo;
+        }
+    }
+
+    return mejor;
+}
+
 double fun_f(double i, double j, double k)
 {
     return i - j - (2*(k - pii));
@@ -207,11 +373,10 @@ double fun_g(double i)
     return i- pii;
 }
 
-void eleccion_curva_dubins(cuadrantes_t cuad, way_point_t *p_inicial, way_point_t *p_final, tipo_trayectoria_t *path_type)
+void eleccion_curva_dubins(cuadrantes_t cuad, const way_point_t *p_inicial, const way_point_t *p_final, const dubins_palabra_t w[DUBINS_PALABRAS], tipo_trayectoria_t *path_type)
 {
     double a = p_inicial->angulo;
     double b = p_final->angulo;
-    double d = p_final->x/RADIO;
 
     switch (cuad) {
 
@@ -220,30 +385,30 @@ void eleccion_curva_dubins(cuadrantes_t cuad, way_point_t *p_inicial, way_point_
             break;
 
         case uno_dos:
-            if (fun_f(p_rsr(a,b,d), p_rsl(a,b,d), q_rsl(a,b,d)) < 0)
+            if (fun_f(w[RSR].p, w[RSL].p, w[RSL].q) < 0)
                 *path_type = RSR;
             else
                 *path_type = RSL;
             break;
 
         case uno_tres:
-            if (fun_g(t_rsr(a,b,d)) < 0)
+            if (fun_g(w[RSR].t) < 0)
                 *path_type = RSR;
             else
                 *path_type = LSR;
             break;
 
         case uno_cuatro:
-            if (fun_g(t_rsr(a,b,d)) > 0)
+            if (fun_g(w[RSR].t) > 0)
                 *path_type = LSR;
-            else if (fun_g(q_rsr(a,b,d)) > 0)
+            else if (fun_g(w[RSR].q) > 0)
                 *path_type = RSL;
             else
                 *path_type = RSR;
             break;
 
         case dos_uno:
-            if (fun_f(p_lsl(a,b,d), p_rsl(a,b,d), t_rsl(a,b,d)) < 0)
+            if (fun_f(w[LSL].p, w[RSL].p, w[RSL].t) < 0)
                 *path_type = LSL;
             else
                 *path_type = RSL;
@@ -251,12 +416,12 @@ void eleccion_curva_dubins(cuadrantes_t cuad, way_point_t *p_inicial, way_point_
 
         case dos_dos:
             if (a > b) {
-                if (fun_f(p_lsl(a,b,d), p_rsl(a,b,d), t_rsl(a,b,d)) < 0)
+                if (fun_f(w[LSL].p, w[RSL].p, w[RSL].t) < 0)
                     *path_type = LSL;
                 else
                     *path_type = RSL;
             } else {
-                if (fun_f(p_rsr(a,b,d), p_rsl(a,b,d), q_rsl(a,b,d)) < 0)
+                if (fun_f(w[RSR].p, w[RSL].p, w[RSL].q) < 0)
                     *path_type = RSR;
                 else
                     *path_type = RSL;
@@ -268,14 +433,14 @@ void eleccion_curva_dubins(cuadrantes_t cuad, way_point_t *p_inicial, way_point_
             break;
 
         case dos_cuatro:
-            if (fun_g(q_rsr(a,b,d)) < 0)
+            if (fun_g(w[RSR].q) < 0)
                 *path_type = RSR;
             else
                 *path_type = RSL;
             break;
 
         case tres_uno:
-            if (fun_g(q_lsl(a,b,d)) < 0)
+            if (fun_g(w[LSL].q) < 0)
                 *path_type = LSL;
             else
                 *path_type = LSR;
@@ -287,12 +452,12 @@ void eleccion_curva_dubins(cuadrantes_t cuad, way_point_t *p_inicial, way_point_
 
         case tres_tres:
             if (a < b) {
-                if (fun_f(p_rsr(a,b,d), p_lsr(a,b,d), t_lsr(a,b,d)) < 0)
+                if (fun_f(w[RSR].p, w[LSR].p, w[LSR].t) < 0)
                     *path_type = RSR;
                 else
                     *path_type = LSR;
             } else {
-                if (fun_f(p_lsl(a,b,d), p_lsr(a,b,d), q_lsr(a,b,d)) < 0)
+                if (fun_f(w[LSL].p, w[LSR].p, w[LSR].q) < 0)
                     *path_type = LSL;
                 else
                     *path_type = LSR;
@@ -300,30 +465,30 @@ void eleccion_curva_dubins(cuadrantes_t cuad, way_point_t *p_inicial, way_point_
             break;
 
         case tres_cuatro:
-            if (fun_f(p_rsr(a,b,d), p_lsr(a,b,d), t_lsr(a,b,d)) < 0)
+            if (fun_f(w[RSR].p, w[LSR].p, w[LSR].t) < 0)
                 *path_type = RSR;
             else
                 *path_type = LSR;
             break;
 
         case cuatro_uno:
-            if (fun_g(t_lsl(a,b,d)) > 0)
+            if (fun_g(w[LSL].t) > 0)
                 *path_type = RSL;
-            else if (fun_g(q_lsl(a,b,d)) > 0)
+            else if (fun_g(w[LSL].q) > 0)
                 *path_type = LSR;
             else
                 *path_type = LSL;
             break;
 
         case cuatro_dos:
-            if (fun_g(t_lsl(a,b,d)) < 0)
+            if (fun_g(w[LSL].t) < 0)
                 *path_type = LSL;
             else
                 *path_type = RSL;
             break;
 
         case cuatro_tres:
-            if (fun_f(p_lsl(a,b,d), p_lsr(a,b,d), q_lsr(a,b,d)) < 0)
+            if (fun_f(w[LSL].p, w[LSR].p, w[LSR].q) < 0)
                 *path_type = LSL;
             else
                 *path_type = LSR;
@@ -341,7 +506,7 @@ void eleccion_curva_dubins(cuadrantes_t cuad, way_point_t *p_inicial, way_point_
     return;
 }
 
-void find_path(tipo_trayectoria_t tipo, way_point_t *p_inicial, way_point_t *p_final, way_point_t *p_inicial_conv, way_point_t *p_final_conv, trayectoria_t *path)
+void find_path(tipo_trayectoria_t tipo, const way_point_t *p_inicial, const way_point_t *p_final, const dubins_palabra_t w[DUBINS_PALABRAS], trayectoria_t *path)
 {
 
     path->xi = p_inicial->x;
@@ -354,10 +519,6 @@ void find_path(tipo_trayectoria_t tipo, way_point_t *p_inicial, way_point_t *p_f
     path->angulof = p_final->angulo;
     path->tipo = tipo;
 
-    double a = p_inicial_conv->angulo;
-    double b = p_final_conv->angulo;
-    double d = p_final_conv->x/RADIO;
-
     // Cfa inicial
     double theta_inicial;
     if ((tipo == RSR) || (tipo == RSL) || (tipo == RLR))  // Si empieza hacia la derecha
@@ -376,28 +537,9 @@ void find_path(tipo_trayectoria_t tipo, way_point_t *p_inicial, way_point_t *p_f
     path->xcf = p_final->x + (RADIO*cos(theta_final));
     path->ycf = p_final->y + (RADIO*sin(theta_final));
 
-    switch (tipo) {
-        case LSL:
-            path->Ci = t_lsl(a,b,d);
-            path->S = p_lsl(a,b,d);
-            path->Cf = q_lsl(a,b,d);
-            break;
-        case LSR:
-            path->Ci = t_lsr(a,b,d);
-            path->S = p_lsr(a,b,d);
-            path->Cf = q_lsr(a,b,d);
-            break;
-        case RSR:
-            path->Ci = t_rsr(a,b,d);
-            path->S = p_rsr(a,b,d);
-            path->Cf = q_rsr(a,b,d);
-            break;
-        case RSL:
-            path->Ci = t_rsl(a,b,d);
-            path->S = p_rsl(a,b,d);
-            path->Cf = q_rsl(a,b,d);
-            break;
-    }
+    path->Ci = w[tipo].t;
+    path->S = w[tipo].p;
+    path->Cf = w[tipo].q;
 
     if ((tipo == RSR) || (tipo == RSL) || (tipo == RLR)) {  // Si empieza hacia la derecha
         path->xri = path->xci + RADIO*cos(theta_inicial + pii - mod2pi(path->Ci));
@@ -415,11 +557,15 @@ void find_path(tipo_trayectoria_t tipo, way_point_t *p_inicial, way_point_t *p_f
         path->yrf = path->ycf + RADIO*sin(p_final->angulo +(3*pii/2) - mod2pi(path->Cf));
     }
 
+    path->xcm = 0;
+    path->ycm = 0;
+    trayectoria_segmentos(path);
+
     return;
 }
 
 /* discretiza la trayectoria */
-//int path_discreto(trayectoria_t trayectoria, Lista_wp *lista)
+//int path_discreto(trayectoria_t trayectoria, wp_buff_t *lista)
 //{
 //    int i;
 //    double delta_ang = DISTANCIA_WP/RADIO;
@@ -512,7 +658,7 @@ void find_path(tipo_trayectoria_t tipo, way_point_t *p_inicial, way_point_t *p_f
 //    return 0;
 //}
 
-//int log_trayectoria_discreta(Lista_wp *lista)
+//int log_trayectoria_discreta(wp_buff_t *lista)
 //{
 //    Elemento_wp *elemento = lista->inicio;
 //
@@ -543,9 +689,10 @@ void find_path(tipo_trayectoria_t tipo, way_point_t *p_inicial, way_point_t *p_f
 //}
 
 
-int log_trayectoria(Lista_path *lista)
+int log_trayectoria(path_buff_t *buff)
 {
-    Elemento_path *elemento = lista->inicio;
+    const trayectoria_t *path;
+    int i;
 
     // Creo archivo log file
     FILE *output_file;
@@ -555,50 +702,30 @@ int log_trayectoria(Lista_path *lista)
         return -1;
     }
 
-    fprintf(output_file, "%i \n",  lista->tamano);
-
-    fprintf(output_file, "%lf \n",  RADIO);
-    fprintf(output_file, "%lf \n", elemento->dato->xi);		// x waypoint inicial
-    fprintf(output_file, "%lf \n", elemento->dato->yi);		// y inicial
-    fprintf(output_file, "%lf \n", elemento->dato->anguloi);	// angulo YAW inicial
-    fprintf(output_file, "%lf \n", elemento->dato->xf);		// x final
-    fprintf(output_file, "%lf \n", elemento->dato->yf);
-    fprintf(output_file, "%lf \n", elemento->dato->angulof);
-    fprintf(output_file, "%d \n",  elemento->dato->tipo);
-    fprintf(output_file, "%lf \n", elemento->dato->xci);
-    fprintf(output_file, "%lf \n", elemento->dato->yci);
-    fprintf(output_file, "%lf \n", elemento->dato->xri);	// x inicio recta
-    fprintf(output_file, "%lf \n", elemento->dato->yri);	// y inicio recta
-    fprintf(output_file, "%lf \n", elemento->dato->xrf);	// x final recta
-    fprintf(output_file, "%lf \n", elemento->dato->yrf);	// y final recta
-    fprintf(output_file, "%lf \n", elemento->dato->xcf);
-    fprintf(output_file, "%lf \n", elemento->dato->ycf);
-    fprintf(output_file, "%lf \n", elemento->dato->Ci);
-    fprintf(output_file, "%lf \n", elemento->dato->S);
-    fprintf(output_file, "%lf \n", elemento->dato->Cf);
+    fprintf(output_file, "%i \n",  path_buff_restantes(buff));
 
     // Guardo resultados en log file
-     while (elemento->siguiente != NULL) {
-	elemento = elemento->siguiente;
+    for (i = buff->actual; i < buff->tamano; i++) {
+	path = path_buff_get(buff, i);
 	fprintf(output_file, "%lf \n",  RADIO);
-	fprintf(output_file, "%lf \n", elemento->dato->xi);
-	fprintf(output_file, "%lf \n", elemento->dato->yi);
-	fprintf(output_file, "%lf \n", elemento->dato->anguloi);
-	fprintf(output_file, "%lf \n", elemento->dato->xf);
-	fprintf(output_file, "%lf \n", elemento->dato->yf);
-	fprintf(output_file, "%lf \n", elemento->dato->angulof);
-	fprintf(output_file, "%d \n",  elemento->dato->tipo);
-	fprintf(output_file, "%lf \n", elemento->dato->xci);
-	fprintf(output_file, "%lf \n", elemento->dato->yci);
-	fprintf(output_file, "%lf \n", elemento->dato->xri); // x inicio recta
-	fprintf(output_file, "%lf \n", elemento->dato->yri); // y inicio recta
-	fprintf(output_file, "%lf \n", elemento->dato->xrf); // x final recta
-	fprintf(output_file, "%lf \n", elemento->dato->yrf); // y final recta
-	fprintf(output_file, "%lf \n", elemento->dato->xcf);
-	fprintf(output_file, "%lf \n", elemento->dato->ycf);
-	fprintf(output_file, "%lf \n", elemento->dato->Ci);
-	fprintf(output_file, "%lf \n", elemento->dato->S);
-	fprintf(output_file, "%lf \n", elemento->dato->Cf);
+	fprintf(output_file, "%lf \n", path->xi);		// x waypoint inicial
+	fprintf(output_file, "%lf \n", path->yi);		// y inicial
+	fprintf(output_file, "%lf \n", path->anguloi);	// angulo YAW inicial
+	fprintf(output_file, "%lf \n", path->xf);		// x final
+	fprintf(output_file, "%lf \n", path->yf);
+	fprintf(output_file, "%lf \n", path->angulof);
+	fprintf(output_file, "%d \n",  path->tipo);
+	fprintf(output_file, "%lf \n", path->xci);
+	fprintf(output_file, "%lf \n", path->yci);
+	fprintf(output_file, "%lf \n", path->xri);		// x inicio recta
+	fprintf(output_file, "%lf \n", path->yri);		// y inicio recta
+	fprintf(output_file, "%lf \n", path->xrf);		// x final recta
+	fprintf(output_file, "%lf \n", path->yrf);		// y final recta
+	fprintf(output_file, "%lf \n", path->xcf);
+	fprintf(output_file, "%lf \n", path->ycf);
+	fprintf(output_file, "%lf \n", path->Ci);
+	fprintf(output_file, "%lf \n", path->S);
+	fprintf(output_file, "%lf \n", path->Cf);
     }
 
     // Cierro archivo de log file
@@ -608,237 +735,469 @@ int log_trayectoria(Lista_path *lista)
 }
 
 
-int path_planning(Lista_wp *wp, Lista_path *lista_path)
+/* Giro de cada tramo de cada palabra, indexado por tipo_trayectoria_t */
+static const char dubins_giros[DUBINS_PALABRAS][3] = {
+    {'L','S','L'}, {'L','S','R'}, {'R','S','R'}, {'R','S','L'}, {'R','L','R'}, {'L','R','L'}
+};
+
+/* Centro de la cfa que recorre la pose girando hacia 'giro' */
+static void dubins_centro(const way_point_t *pose, char giro, double *xc, double *yc)
 {
-    // Creo lista de trayectorias para salida
-    //Lista_path *output = (Lista_path *)malloc(sizeof(struct ListaIdentificar_path));
-    //inicializacion_path(output);
+    if (giro == 'L') {
+        *xc = pose->x - RADIO*sin(pose->angulo);
+        *yc = pose->y + RADIO*cos(pose->angulo);
+    } else {
+        *xc = pose->x + RADIO*sin(pose->angulo);
+        *yc = pose->y - RADIO*cos(pose->angulo);
+    }
+}
 
-    // Iteracion para hallar trayectoria por cada par de way points
-    Elemento_wp *aux = wp->inicio;
-    way_point_t *p_inicial = aux->dato;
-    way_point_t *p_final = aux->siguiente->dato;
-    int i;
-    for (i=0; i < wp->tamano - 1; i++)
-    {
-        // Guardo espacio para el par de way point a unir con una trayectoria
-        way_point_t *p_inicial_conv = (way_point_t *)malloc(sizeof(struct way_point)); //TODO hacer malloc afuera
-        way_point_t *p_final_conv = (way_point_t *)malloc(sizeof(struct way_point)); //TODO hacer malloc afuera
+/* Avanza la pose un tramo de largo 'largo' (dividido el RADIO) */
+static void dubins_avanzar(way_point_t *pose, char giro, double largo)
+{
+    double h = pose->angulo;
 
-        // Convierto sistema de coordenadas
-        conversion_eje_coordenadas(p_inicial, p_final, p_inicial_conv, p_final_conv);
+    switch (giro) {
+        case 'L':
+            pose->x += RADIO*(sin(h + largo) - sin(h));
+            pose->y += RADIO*(cos(h) - cos(h + largo));
+            pose->angulo = mod2pi(h + largo);
+            break;
+        case 'R':
+            pose->x += RADIO*(sin(h) - sin(h - largo));
+            pose->y += RADIO*(cos(h - largo) - cos(h));
+            pose->angulo = mod2pi(h - largo);
+            break;
+        default:
+            pose->x += RADIO*largo*cos(h);
+            pose->y += RADIO*largo*sin(h);
+            break;
+    }
+}
 
-        // Determino en que cuadrantes se encuentran los angulos de partida y llegada
-        cuadrantes_t cuad = determinacion_cuadrantes(p_inicial_conv, p_final_conv);
+void find_path_dubins(tipo_trayectoria_t tipo, const way_point_t *p_inicial, const way_point_t *p_final, const dubins_palabra_t w[DUBINS_PALABRAS], trayectoria_t *path)
+{
+    const char *giro = dubins_giros[tipo];
+    way_point_t pose = *p_inicial;
 
-        // Defino el tipo de trayectoria
-        tipo_trayectoria_t *path_type = (tipo_trayectoria_t *)malloc(sizeof(enum tipo_trayectoria));
-        eleccion_curva_dubins(cuad, p_inicial_conv, p_final_conv, path_type);
+    path->xi = p_inicial->x;
+    path->yi = p_inicial->y;
+    path->zi = p_inicial->z;
+    path->anguloi = p_inicial->angulo;
+    path->xf = p_final->x;
+    path->yf = p_final->y;
+    path->zf = p_final->z;
+    path->angulof = p_final->angulo;
+    path->tipo = tipo;
+    path->Ci = w[tipo].t;
+    path->S = w[tipo].p;
+    path->Cf = w[tipo].q;
 
-        // Hallo la trayectoria
-        trayectoria_t *path = (trayectoria_t *)malloc(sizeof(struct trayectoria));
-        find_path(*path_type, p_inicial, p_final, p_inicial_conv, p_final_conv, path);
+    // Cfa inicial
+    dubins_centro(&pose, giro[0], &path->xci, &path->yci);
+    dubins_avanzar(&pose, giro[0], w[tipo].t);
+    path->xri = pose.x;
+    path->yri = pose.y;
+
+    // Recta o cfa intermedia
+    if (giro[1] == 'S') {
+        path->xcm = 0;
+        path->ycm = 0;
+    } else
+        dubins_centro(&pose, giro[1], &path->xcm, &path->ycm);
+    dubins_avanzar(&pose, giro[1], w[tipo].p);
+    path->xrf = pose.x;
+    path->yrf = pose.y;
+
+    // Cfa final, se toma del way point final para no acumular error
+    dubins_centro(p_final, giro[2], &path->xcf, &path->ycf);
+
+    trayectoria_segmentos(path);
 
-        // Agrego trayectoria generada en la lista de salida
-        InsercionEnLista_path(lista_path, *path);
+    return;
+}
+
+/* Tramo circular de (xs,ys) a su fin, recorriendo 'angulo' con centro (xc,yc) */
+static void segmento_cfa(segmento_t *seg, char giro, double xc, double yc, double xs, double ys, double angulo)
+{
+    double dx = xs - xc, dy = ys - yc;
+    double r = sqrt(dx*dx + dy*dy);
+
+    seg->giro = giro;
+    seg->x0 = xc;
+    seg->y0 = yc;
+    seg->ux = (r > 0) ? dx/r : 1;
+    seg->uy = (r > 0) ? dy/r : 0;
+    seg->largo = mod2pi(angulo);
+    // Un giro nulo con error numerico queda como 2*pi, y seria una vuelta entera
+    if (seg->largo > UQUAD_ANGLE_2PI - 1e-9)
+        seg->largo = 0;
+}
 
-        // Me muevo al proximo way point para el proximo ciclo del loop
-        if (i < wp->tamano - 2)
-        {
-            aux = aux->siguiente;
-            p_inicial = aux->dato;
-            p_final = aux->siguiente->dato;
+void trayectoria_segmentos(trayectoria_t *path)
+{
+    const char *giro = dubins_giros[path->tipo];
+    double dx, dy, largo, norma, rx, ry;
+
+    segmento_cfa(&path->seg[0], giro[0], path->xci, path->yci, path->xi, path->yi, path->Ci);
+
+    if (giro[1] == 'S') {
+        dx = path->xrf - path->xri;
+        dy = path->yrf - path->yri;
+        largo = norma = sqrt(dx*dx + dy*dy);
+        if (largo <= 0) {
+            // Recta nula: la direccion es la tangente al final de la primera
+            // cfa, asi sigue siendo la del recorrido
+            rx = path->xri - path->xci;
+            ry = path->yri - path->yci;
+            dx = (giro[0] == 'L') ? -ry : ry;
+            dy = (giro[0] == 'L') ? rx : -rx;
+            norma = sqrt(dx*dx + dy*dy);
         }
+        path->seg[1].giro = 'S';
+        path->seg[1].x0 = path->xri;
+        path->seg[1].y0 = path->yri;
+        path->seg[1].ux = (norma > 0) ? dx/norma : 1;
+        path->seg[1].uy = (norma > 0) ? dy/norma : 0;
+        path->seg[1].largo = largo;
+    } else
+        segmento_cfa(&path->seg[1], giro[1], path->xcm, path->ycm, path->xri, path->yri, path->S);
+
+    segmento_cfa(&path->seg[2], giro[2], path->xcf, path->ycf, path->xrf, path->yrf, path->Cf);
+}
+
+void path_planning_par(const way_point_t *p_inicial, const way_point_t *p_final, trayectoria_t *path)
+{
+#if DUBINS_HEURISTICA
+    path_planning_par_heuristica(p_inicial, p_final, path);
+#else
+    path_planning_par_minima(p_inicial, p_final, path);
+#endif
+}
+
+void path_planning_par_heuristica(const way_point_t *p_inicial, const way_point_t *p_final, trayectoria_t *path)
+{
+    way_point_t p_inicial_conv, p_final_conv;
+    dubins_palabra_t w[DUBINS_PALABRAS];
+    tipo_trayectoria_t path_type;
+    cuadrantes_t cuad;
+
+    // Convierto sistema de coordenadas
+    conversion_eje_coordenadas(p_inicial, p_final, &p_inicial_conv, &p_final_conv);
+
+    // Tramos de todas las palabras, con los terminos comunes calculados una vez
+    dubins_palabras(p_inicial_conv.angulo, p_final_conv.angulo, p_final_conv.x/RADIO, w);
+
+    // Determino en que cuadrantes se encuentran los angulos de partida y llegada
+    cuad = determinacion_cuadrantes(&p_inicial_conv, &p_final_conv);
+
+    // Defino el tipo de trayectoria
+    eleccion_curva_dubins(cuad, &p_inicial_conv, &p_final_conv, w, &path_type);
+
+    // Hallo la trayectoria
+    find_path(path_type, p_inicial, p_final, w, path);
+
+    return;
+}
+
+void path_planning_par_minima(const way_point_t *p_inicial, const way_point_t *p_final, trayectoria_t *path)
+{
+    way_point_t p_inicial_conv, p_final_conv;
+    dubins_palabra_t w[DUBINS_PALABRAS];
+    tipo_trayectoria_t path_type;
+    int factibles;
+
+    // Convierto sistema de coordenadas
+    conversion_eje_coordenadas(p_inicial, p_final, &p_inicial_conv, &p_final_conv);
+
+    // Evaluo las seis palabras y me quedo con la mas corta
+    factibles = dubins_palabras_exactas(p_inicial_conv.angulo, p_final_conv.angulo, p_final_conv.x/RADIO, w);
+    path_type = eleccion_curva_dubins_minima(w, factibles);
 
-        free(p_inicial_conv); //TODO hacer free afuera
-        free(p_final_conv);
-        free(path_type);
-        free(path);
+    // Hallo la trayectoria
+    find_path_dubins(path_type, p_inicial, p_final, w, path);
 
+    return;
+}
+
+int path_planning(wp_buff_t *wp, path_buff_t *paths)
+{
+    // La trayectoria i une los way points i e i+1: se planifica la mision
+    // entera, desde el way point 0 y con paths vacio. Asi los dos buffers
+    // son arreglos planos (sin reciclar) y se indexan directo
+    if (wp->base != 0 || paths->tamano != 0) {
+        err_log("path_planning() necesita los buffers sin usar, ver path_planning_horizonte()");
+        return -1;
     }
+    if (wp->tamano < 2)
+        return 0;
 
-    //log_trayectoria(output);
+    // Una trayectoria por par de way points, se reserva una sola vez
+    if (path_buff_reservar(paths, wp->tamano - 1) < 0)
+        return -1;
 
-    //free(output);
+#if DUBINS_HEURISTICA
+    int i;
+
+    // Iteracion para hallar trayectoria por cada par de way points
+    for (i=0; i < wp->tamano - 1; i++)
+    {
+        // La trayectoria se escribe directamente en el buffer de salida
+        path_planning_par(&wp->wp[i], &wp->wp[i+1], &paths->path[i]);
+        paths->tamano++;
+    }
+#else
+    // Todos los pares en lote, escribiendo directamente en el buffer de salida
+    if (path_planning_hilos(wp->wp, wp->tamano, paths->path, PATH_PLANNING_HILOS) < 0)
+        return -1;
+    paths->tamano = wp->tamano - 1;
+#endif
 
     return 0;
 }
 
 
 
-/** --------------------- */
-/** LISTA PARA WAY POINTS */
-/** --------------------- */
+int path_planning_horizonte(wp_buff_t *wp, path_buff_t *paths, int horizonte)
+{
+    way_point_t par[2];
+    int n, limite, i, m, nuevas;
+
+    // Pares con los dos way points recibidos que aun no se planificaron
+    n = wp->tamano - 1 - paths->tamano;
+    limite = paths->actual + horizonte - paths->tamano;
+    if (n > limite)
+        n = limite;
+    if (n > paths->capacidad - path_buff_restantes(paths))
+        n = paths->capacidad - path_buff_restantes(paths);
+    if (n <= 0)
+        return 0;
+
+    // Tramos contiguos en los dos buffers circulares
+    for (nuevas = 0; nuevas < n; nuevas += m) {
+        i = paths->tamano;
+        m = n - nuevas;
+        if (m > paths->capacidad - i % paths->capacidad)
+            m = paths->capacidad - i % paths->capacidad;
+        if (m > wp->capacidad - 1 - i % wp->capacidad)
+            m = wp->capacidad - 1 - i % wp->capacidad;
+
+        if (m > 0) {
+            if (path_planning_hilos(wp_buff_get(wp, i), m + 1, path_buff_get(paths, i), 1) < 0)
+                break;
+        } else {
+            // El par queda partido al final del buffer de way points
+            m = 1;
+            par[0] = *wp_buff_get(wp, i);
+            par[1] = *wp_buff_get(wp, i + 1);
+            if (path_planning_hilos(par, 2, path_buff_get(paths, i), 1) < 0)
+                break;
+        }
+        paths->tamano += m;
+    }
+
+    // El way point paths->tamano es el primero del proximo par
+    wp_buff_descartar(wp, paths->tamano);
+
+    return nuevas;
+}
 
-/*Inicializar una lista*/
-void inicializacion_wp(Lista_wp *lista)
+
+
+/** ---------------------- */
+/** BUFFER PARA WAY POINTS */
+/** ---------------------- */
+
+/*Inicializar el buffer*/
+void wp_buff_init(wp_buff_t *buff)
 {
-    lista->inicio = NULL;
-    lista->fin= NULL;
-    lista->tamano = 0;
+    buff->wp = NULL;
+    buff->capacidad = 0;
+    buff->base = 0;
+    buff->tamano = 0;
 }
 
-/*Insercion en una lista */
-int InsercionEnLista_wp(Lista_wp *lista, way_point_t dato)
+/*Reserva de memoria, solo al cargar la mision */
+int wp_buff_reservar(wp_buff_t *buff, int capacidad)
 {
-    Elemento_wp *nuevo_elemento;
-    if((nuevo_elemento = (Elemento_wp *)malloc(sizeof(Elemento_wp)))==NULL)
+    way_point_t *wp;
+
+    // Primero: con lugares reciclados tamano ya no es un indice del arreglo
+    if (buff->base > 0) {
+        err_log("No se puede agrandar un buffer que ya recicla lugares");
         return -1;
-    if((nuevo_elemento->dato = (way_point_t *)malloc(sizeof(struct way_point)))==NULL)
+    }
+    if (capacidad <= buff->capacidad)
+        return 0;
+    wp = (way_point_t *)realloc(buff->wp, capacidad*sizeof(way_point_t));
+    if (wp == NULL) {
+        err_log_stderr("realloc()");
         return -1;
+    }
+    buff->wp = wp;
+    buff->capacidad = capacidad;
 
-    nuevo_elemento->dato->x = dato.x;
-    nuevo_elemento->dato->y = dato.y;
-    nuevo_elemento->dato->z = dato.z;
-    nuevo_elemento->dato->angulo = dato.angulo;
-    nuevo_elemento->siguiente = NULL;
+    return 0;
+}
 
-    if (lista->tamano == 0)
-        lista->inicio = nuevo_elemento;
-    else
-        lista->fin->siguiente = nuevo_elemento;
-    lista->fin = nuevo_elemento;
-    lista->tamano++;
+/*Liberar memoria*/
+void wp_buff_liberar(wp_buff_t *buff)
+{
+    free(buff->wp);
+    wp_buff_init(buff);
+}
 
-//    free(nuevo_elemento);
+/*Insercion al final del buffer */
+int wp_buff_add(wp_buff_t *buff, way_point_t dato)
+{
+    if (wp_buff_lleno(buff))
+        return -1;
+
+    *wp_buff_get(buff, buff->tamano) = dato;
+    buff->tamano++;
 
     return 0;
 }
 
-/*visualizar lista entera*/
-void visualizacion_wp(Lista_wp *lista)
+/*Libera los lugares de los way points anteriores a i */
+void wp_buff_descartar(wp_buff_t *buff, int i)
 {
-    if (lista->tamano == 0) {
-        printf("Error: Lista vacia\n");
+    if (i > buff->tamano)
+        i = buff->tamano;
+    if (i > buff->base)
+        buff->base = i;
+}
+
+/*visualizar buffer entero*/
+void visualizacion_wp(wp_buff_t *buff)
+{
+    int i;
+
+    if (buff->tamano == 0) {
+        printf("Error: Buffer vacio\n");
         return;
     }
-    Elemento_wp *actual;
-    actual = lista->inicio;
-    while(actual != NULL) {
-        printf("\n x = %lf",actual->dato->x);
-        printf("\n y = %lf",actual->dato->y);
-        printf("\n z = %lf",actual->dato->z);
-        printf("\n angulo = %lf\n",actual->dato->angulo);
-        actual = actual->siguiente;
+    for (i = buff->base; i < buff->tamano; i++) {
+        printf("\n x = %lf",wp_buff_get(buff, i)->x);
+        printf("\n y = %lf",wp_buff_get(buff, i)->y);
+        printf("\n z = %lf",wp_buff_get(buff, i)->z);
+        printf("\n angulo = %lf\n",wp_buff_get(buff, i)->angulo);
     }
 
     return;
 }
 
-/** ----------------------- */
-/** LISTA PARA TRAYECTORIAS */
-/** ----------------------- */
+/** ------------------------ */
+/** BUFFER PARA TRAYECTORIAS */
+/** ------------------------ */
 
-/*Inicializar una lista*/
-void inicializacion_path(Lista_path *lista)
+/*Inicializar el buffer*/
+void path_buff_init(path_buff_t *buff)
 {
-    lista->inicio = NULL;
-    lista->fin= NULL;
-    lista->tamano = 0;
+    buff->path = NULL;
+    buff->capacidad = 0;
+    buff->tamano = 0;
+    buff->actual = 0;
 }
 
-/*Insercion en una lista */
-int InsercionEnLista_path(Lista_path *lista, trayectoria_t dato)
+/*Reserva de memoria, solo al planificar la mision */
+int path_buff_reservar(path_buff_t *buff, int capacidad)
 {
-    Elemento_path *nuevo_elemento;
-    if((nuevo_elemento = (Elemento_path *)malloc(sizeof(Elemento_path)))==NULL)
+    trayectoria_t *path;
+
+    if (buff->tamano > buff->capacidad) {
+        err_log("No se puede agrandar un buffer que ya recicla lugares");
         return -1;
-    if((nuevo_elemento->dato = (trayectoria_t *)malloc(sizeof(struct trayectoria)))==NULL)
+    }
+    if (capacidad <= buff->capacidad)
+        return 0;
+    path = (trayectoria_t *)realloc(buff->path, capacidad*sizeof(trayectoria_t));
+    if (path == NULL) {
+        err_log_stderr("realloc()");
         return -1;
-
-    nuevo_elemento->dato->xi = dato.xi;
-    nuevo_elemento->dato->yi = dato.yi;
-    nuevo_elemento->dato->zi = dato.zi;
-    nuevo_elemento->dato->anguloi = dato.anguloi;
-    nuevo_elemento->dato->xf = dato.xf;
-    nuevo_elemento->dato->yf = dato.yf;
-    nuevo_elemento->dato->zf = dato.zf;
-    nuevo_elemento->dato->angulof = dato.angulof;
-    nuevo_elemento->dato->tipo = dato.tipo;
-    nuevo_elemento->dato->xri = dato.xri;
-    nuevo_elemento->dato->yri = dato.yri;
-    nuevo_elemento->dato->xrf = dato.xrf;
-    nuevo_elemento->dato->yrf = dato.yrf;
-    nuevo_elemento->dato->xci = dato.xci;
-    nuevo_elemento->dato->yci = dato.yci;
-    nuevo_elemento->dato->xcf = dato.xcf;
-    nuevo_elemento->dato->ycf = dato.ycf;
-    nuevo_elemento->dato->Ci = dato.Ci;
-    nuevo_elemento->dato->S = dato.S;
-    nuevo_elemento->dato->Cf = dato.Cf;
-
-    nuevo_elemento->siguiente = NULL;
-
-    if (lista->tamano == 0)
-        lista->inicio = nuevo_elemento;
-    else
-        lista->fin->siguiente = nuevo_elemento;
-    lista->fin = nuevo_elemento;
-    lista->tamano++;
+    }
+    buff->path = path;
+    buff->capacidad = capacidad;
 
     return 0;
 }
 
-/*Elimina primer elemento en una lista */
-int BorrarEnLista_path(Lista_path *lista)
+/*Liberar memoria*/
+void path_buff_liberar(path_buff_t *buff)
+{
+    free(buff->path);
+    path_buff_init(buff);
+}
+
+/*Insercion al final del buffer */
+int path_buff_add(path_buff_t *buff, const trayectoria_t *dato)
 {
-    if (lista->tamano < 1)
-        printf("Error: Imposible eliminar elemento de la lista. La misma se encuentra vacia");
+    if (path_buff_restantes(buff) >= buff->capacidad)
+        return -1;
+
+    *path_buff_get(buff, buff->tamano) = *dato;
+    buff->tamano++;
 
-    free(lista->inicio->dato);
-    if (lista->tamano == 1)
-        inicializacion_path(lista);
-    else {
-        lista->inicio = lista->inicio->siguiente;
-        lista->tamano = lista->tamano - 1;
+    return 0;
+}
+
+/*Pasa a la siguiente trayectoria */
+int path_buff_avanzar(path_buff_t *buff)
+{
+    if (buff->actual >= buff->tamano) {
+        err_log("Error: No quedan trayectorias por recorrer");
+        return -1;
     }
 
+    buff->actual++;
+
     return 0;
 }
 
-/*visualizar lista entera*/
-void visualizacion_path(Lista_path *lista)
+/*visualizar las trayectorias que faltan recorrer*/
+void visualizacion_path(path_buff_t *buff)
 {
-    if (lista->tamano == 0) {
-        printf("Error: Lista vacia\n");
+    const trayectoria_t *actual;
+    int i;
+
+    if (path_buff_restantes(buff) == 0) {
+        printf("Error: Buffer vacio\n");
         return;
     }
-    Elemento_path *actual;
-    actual = lista->inicio;
 
-    printf("Tamano = %lf\n", (double)lista->tamano);
-    while(actual != NULL) {
+    printf("Tamano = %lf\n", (double)path_buff_restantes(buff));
+    for (i = buff->actual; i < buff->tamano; i++) {
+        actual = path_buff_get(buff, i);
 
         printf("Radio = %lf\n", RADIO);
-        printf("xi = %lf\n",actual->dato->xi);
-        printf("yi = %lf\n",actual->dato->yi);
-        //printf("zi = %lf\n",actual->dato->zi);
-        printf("angulo inicial = %lf\n",actual->dato->anguloi);
-        printf("xf = %lf\n",actual->dato->xf);
-        printf("yf = %lf\n",actual->dato->yf);
-        //printf("zf = %lf\n",actual->dato->zf);
-        printf("angulo final = %lf\n",actual->dato->angulof);
-        printf("tipo curva = %lf\n",(double)actual->dato->tipo);
-        printf("xci = %lf\n",actual->dato->xci);
-        printf("yci = %lf\n",actual->dato->yci);
-        printf("x inicial recta = %lf\n",actual->dato->xri);
-        printf("y inicial recta = %lf\n",actual->dato->yri);
-        printf("x final recta = %lf\n",actual->dato->xrf);
-        printf("y final recta = %lf\n",actual->dato->yrf);
-        printf("xcf = %lf\n",actual->dato->xcf);
-        printf("ycf = %lf\n",actual->dato->ycf);
-        printf("largo cfa inicial = %lf\n",actual->dato->Ci);
-        printf("largo recta = %lf\n",actual->dato->S);
-        printf("largo cfa final = %lf\n",actual->dato->Cf);
-        actual = actual->siguiente;
+        printf("xi = %lf\n",actual->xi);
+        printf("yi = %lf\n",actual->yi);
+        //printf("zi = %lf\n",actual->zi);
+        printf("angulo inicial = %lf\n",actual->anguloi);
+        printf("xf = %lf\n",actual->xf);
+        printf("yf = %lf\n",actual->yf);
+        //printf("zf = %lf\n",actual->zf);
+        printf("angulo final = %lf\n",actual->angulof);
+        printf("tipo curva = %lf\n",(double)actual->tipo);
+        printf("xci = %lf\n",actual->xci);
+        printf("yci = %lf\n",actual->yci);
+        printf("x inicial recta = %lf\n",actual->xri);
+        printf("y inicial recta = %lf\n",actual->yri);
+        printf("x final recta = %lf\n",actual->xrf);
+        printf("y final recta = %lf\n",actual->yrf);
+        printf("xcf = %lf\n",actual->xcf);
+        printf("ycf = %lf\n",actual->ycf);
+        printf("largo cfa inicial = %lf\n",actual->Ci);
+        printf("largo recta = %lf\n",actual->S);
+        printf("largo cfa final = %lf\n",actual->Cf);
     }
 
     return;
 }
 
-int log_lista_wp(Lista_wp *lista)
+int log_lista_wp(wp_buff_t *buff)
 {
-    Elemento_wp *elemento = lista->inicio;
+    int i;
 
     // Creo archivo log file
     FILE *output_file;
@@ -848,13 +1207,9 @@ int log_lista_wp(Lista_wp *lista)
         return -1;
     }
 
-    fprintf(output_file, "%lf\t%lf\n", elemento->dato->x, elemento->dato->y);
-
     // Guardo resultados en log file
-     while (elemento->siguiente != NULL) {
-        elemento = elemento->siguiente;
-        fprintf(output_file, "%lf\t%lf\n", elemento->dato->x, elemento->dato->y);
-    }
+    for (i = buff->base; i < buff->tamano; i++)
+        fprintf(output_file, "%lf\t%lf\n", wp_buff_get(buff, i)->x, wp_buff_get(buff, i)->y);
 
     // Cierro archivo de log file
     fclose(output_file);
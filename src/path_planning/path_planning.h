@@ -1,10 +1,28 @@
-#ifndef PATH_PlANNING_H
+#ifndef PATH_PLANNING_H
 #define PATH_PLANNING_H
 
+#include <stddef.h>
+
 #define WAYPOINTS_FILE	"way_points_in.txt"
+#define WAYPOINTS_STREAM	1	// lee los way points a medida que llegan (ver wp_stream.h)
+#define PATH_PLANNING_HORIZONTE	3	// trayectorias planificadas por delante de la actual
 
 #define pii 3.141592653589793238462643
 #define RADIO 10.0                // Radio minimo de curvatura
+
+/**
+ * 1: elige la palabra de Dubins con la tabla de cuadrantes (solo CSC).
+ * 0: evalua las seis palabras y elige la de menor largo.
+ */
+#define DUBINS_HEURISTICA 0
+
+/**
+ * Hilos para planificar la mision entera en path_planning(), ver
+ * path_planning_hilos.h. Se crean en cada llamada, solo vale la pena con
+ * misiones largas planificadas antes del loop. Con pocos way points
+ * alcanza con uno.
+ */
+#define PATH_PLANNING_HILOS 1
 //#define DISTANCIA_WP 0.5        // Distancia entre dos way points de la trayectoria
 
 /** --------------------- */
@@ -46,6 +64,31 @@ typedef enum cuadrantes {
     cuatro_cuatro,
 } cuadrantes_t;
 
+/**
+ * Largos de los tres tramos de una palabra de Dubins (normalizados por
+ * RADIO), en la nomenclatura t/p/q de las funciones t_*, p_* y q_*.
+ */
+typedef struct dubins_palabra {
+    double t;                   // primer tramo
+    double p;                   // segundo tramo
+    double q;                   // tercer tramo
+} dubins_palabra_t;
+
+#define DUBINS_PALABRAS 6       // LSL, LSR, RSR, RSL, RLR, LRL
+
+/**
+ * Tramo de una trayectoria, precalculado al planificar para que el
+ * seguimiento solo tenga que proyectar la posicion.
+ */
+typedef struct segmento {
+    char giro;                  // 'L', 'R' (cfa) o 'S' (recta)
+    double x0;                  // recta: x inicial, cfa: x centro
+    double y0;                  // recta: y inicial, cfa: y centro
+    double ux;                  // recta: direccion, cfa: radio al punto inicial
+    double uy;                  // (vector unitario)
+    double largo;               // recta: largo [m], cfa: angulo a recorrer [rad]
+} segmento_t;
+
 typedef struct trayectoria {
     double xi;                  // x inicial
     double yi;                  // y inicial
@@ -64,63 +107,134 @@ typedef struct trayectoria {
     double yci;                 // y centro cfa inicial
     double xcf;                 // x centro cfa final
     double ycf;                 // y centro cfa final
+    double xcm;                 // x centro cfa intermedia (solo RLR y LRL)
+    double ycm;                 // y centro cfa intermedia (solo RLR y LRL)
     double Ci;                  // angulo trayectoria primer circulo
-    double S;                   // largo trayectoria recta (dividio el RADIO)
+    double S;                   // largo trayectoria recta (dividio el RADIO), o angulo cfa intermedia
     double Cf;                  // angulo trayectoria segundo circulo
+    segmento_t seg[3];          // tramos, ver trayectoria_segmentos()
 } trayectoria_t;
 
 
 
 /** --------------------------------------------------------- */
-/**                   LISTA DE WAY POINTS                     */
+/**                  BUFFER DE WAY POINTS                     */
 /** --------------------------------------------------------- */
 
-typedef struct ElementoLista_wp{
-    way_point_t *dato;
-    struct ElementoLista_wp *siguiente;
-} Elemento_wp;
-
-typedef struct ListaIdentificar_wp{
-    Elemento_wp *inicio;
-    Elemento_wp *fin;
-    int tamano;
-} Lista_wp;
+#define WAYPOINTS_STREAM_BUFF	64	// way points (y trayectorias) en los buffers circulares del stream
 
-/* Inicializar una lista */
-void inicializacion_wp(Lista_wp *lista);
-
-/* Agregar en una lista */
-int InsercionEnLista_wp(Lista_wp *lista, way_point_t dato);
-
-/* visualizar lista entera */
-void visualizacion_wp(Lista_wp *lista);
+/**
+ * Arreglo que se reserva una sola vez, al cargar la mision, con
+ * wp_buff_reservar() (no hay malloc por elemento como en las listas, ni
+ * operaciones sobre el heap durante el vuelo).
+ *
+ * Los indices son absolutos: el way point i se guarda en wp[i % capacidad],
+ * y quedan guardados los de base a tamano - 1. Con wp_buff_descartar() se
+ * reciclan los lugares de los way points que ya no se usan, asi una mision
+ * por stream puede tener cualquier cantidad de way points.
+ */
+typedef struct wp_buff {
+    way_point_t *wp;
+    int capacidad;	// lugares reservados
+    int base;		// primer way point guardado
+    int tamano;		// way points agregados desde el inicio
+} wp_buff_t;
+
+/* Inicializar el buffer, vacio y sin memoria reservada */
+void wp_buff_init(wp_buff_t *buff);
+
+/* Reservar lugar para al menos capacidad way points, conservando los que
+ * ya estan. Devuelve -1 si no hay memoria o si ya se reciclaron lugares
+ * (aunque la capacidad alcance). Si devuelve 0, wp[0] a wp[capacidad - 1]
+ * es un arreglo plano con los way points 0 a tamano - 1 al principio */
+int wp_buff_reservar(wp_buff_t *buff, int capacidad);
+
+/* Liberar la memoria reservada */
+void wp_buff_liberar(wp_buff_t *buff);
+
+/* Agregar al final del buffer. Devuelve -1 si esta lleno (no reserva) */
+int wp_buff_add(wp_buff_t *buff, way_point_t dato);
+
+/* Way point i (indice absoluto, entre base y tamano - 1) */
+static inline way_point_t *wp_buff_get(const wp_buff_t *buff, int i)
+{
+    return &buff->wp[i % buff->capacidad];
+}
+
+/* No hay lugar para otro way point */
+static inline int wp_buff_lleno(const wp_buff_t *buff)
+{
+    return buff->tamano - buff->base >= buff->capacidad;
+}
+
+/* Los way points anteriores a i ya no se usan, su lugar queda libre */
+void wp_buff_descartar(wp_buff_t *buff, int i);
+
+/* visualizar buffer entero */
+void visualizacion_wp(wp_buff_t *buff);
 
 /** --------------------------------------------------------- */
-/**                  LISTA DE TRAYECTORIAS                    */
+/**                 BUFFER DE TRAYECTORIAS                    */
 /** --------------------------------------------------------- */
 
-typedef struct ElementoLista_path{
-    trayectoria_t *dato;
-    struct ElementoLista_path *siguiente;
-} Elemento_path;
-
-typedef struct ListaIdentificar_path{
-    Elemento_path *inicio;
-    Elemento_path *fin;
-    int tamano;
-} Lista_path;
-
-/* Inicializar una lista */
-void inicializacion_path(Lista_path *lista);
-
-/* Agregar en una lista */
-int InsercionEnLista_path(Lista_path *lista, trayectoria_t dato);
-
-/*Elimina primer elemento en una lista */
-int BorrarEnLista_path(Lista_path *lista);
-
-/* visualizar lista entera */
-void visualizacion_path(Lista_path *lista);
+/**
+ * Las trayectorias se guardan en orden en un arreglo circular. En lugar de
+ * borrar la trayectoria terminada se avanza el cursor 'actual', por lo que
+ * durante el vuelo no hay operaciones sobre el heap.
+ *
+ * Los indices son absolutos, igual que en wp_buff_t: la trayectoria i une
+ * los way points i e i+1 y se guarda en path[i % capacidad]. Los lugares
+ * de las trayectorias anteriores a 'actual' se reutilizan.
+ */
+typedef struct path_buff {
+    trayectoria_t *path;
+    int capacidad;	// lugares reservados
+    int tamano;		// trayectorias cargadas
+    int actual;		// trayectoria que se esta siguiendo
+} path_buff_t;
+
+/* Inicializar el buffer, vacio y sin memoria reservada */
+void path_buff_init(path_buff_t *buff);
+
+/* Reservar lugar para al menos capacidad trayectorias, conservando las que
+ * ya estan. Devuelve -1 si no hay memoria o si ya se reciclaron lugares */
+int path_buff_reservar(path_buff_t *buff, int capacidad);
+
+/* Liberar la memoria reservada */
+void path_buff_liberar(path_buff_t *buff);
+
+/* Agregar al final del buffer. Devuelve -1 si esta lleno (no reserva) */
+int path_buff_add(path_buff_t *buff, const trayectoria_t *dato);
+
+/* Trayectoria i (indice absoluto) */
+static inline trayectoria_t *path_buff_get(const path_buff_t *buff, int i)
+{
+    return &buff->path[i % buff->capacidad];
+}
+
+/* Trayectoria actual, NULL si ya se recorrieron todas */
+static inline const trayectoria_t *path_buff_actual(const path_buff_t *buff)
+{
+    return (buff->actual < buff->tamano) ? path_buff_get(buff, buff->actual) : NULL;
+}
+
+/* Primera trayectoria que sigue guardada (las anteriores se reutilizaron) */
+static inline int path_buff_primera(const path_buff_t *buff)
+{
+    return (buff->tamano > buff->capacidad) ? buff->tamano - buff->capacidad : 0;
+}
+
+/* Trayectorias que faltan recorrer (incluye la actual) */
+static inline int path_buff_restantes(const path_buff_t *buff)
+{
+    return buff->tamano - buff->actual;
+}
+
+/* Da por terminada la trayectoria actual y pasa a la siguiente */
+int path_buff_avanzar(path_buff_t *buff);
+
+/* visualizar las trayectorias que faltan recorrer */
+void visualizacion_path(path_buff_t *buff);
 
 /** --------------------------------------------------------- */
 /** --------------------------------------------------------- */
@@ -160,10 +274,11 @@ double mod2pi(double angulo);
 //void way_points_input(way_point_t *p_inicial, way_point_t *p_final);
 
 /**
- * Carga lista de way points desde
- * archivo de texto dado por el usuario
+ * Carga buffer de way points desde
+ * archivo de texto dado por el usuario,
+ * o desde una mision binaria (ver mision.h)
  */
-int way_points_input(Lista_wp *wp_lista);
+int way_points_input(wp_buff_t *wp_buff);
 
 /**
  * Convierte los way point al sistema de
@@ -173,7 +288,7 @@ int way_points_input(Lista_wp *wp_lista);
  * que une ambos way points
  *
  */
- void conversion_eje_coordenadas(way_point_t *p_inicial_src, way_point_t *p_final_src, way_point_t *p_inicial_dest, way_point_t *p_final_dest);
+ void conversion_eje_coordenadas(const way_point_t *p_inicial_src, const way_point_t *p_final_src, way_point_t *p_inicial_dest, way_point_t *p_final_dest);
 
 /**
  * Determina en que cuadrantes se encuentran
@@ -185,7 +300,7 @@ int way_points_input(Lista_wp *wp_lista);
  *
  * @return cuadrantes
  */
-cuadrantes_t determinacion_cuadrantes(way_point_t *p_inicial, way_point_t *p_final);
+cuadrantes_t determinacion_cuadrantes(const way_point_t *p_inicial, const way_point_t *p_final);
 
 /**
  * Varias funciones que calculan las distancias
@@ -220,6 +335,56 @@ double t_lrl(double a, double b, double d);
 double p_lrl(double a, double b, double d);
 double q_lrl(double a, double b, double d);
 
+/**
+ * Calcula los tramos de las seis palabras de Dubins de una sola vez.
+ * Da los mismos valores que las funciones t_*, p_* y q_*, pero evalua
+ * sin(a), cos(a), sin(b), cos(b) y cos(a-b) una unica vez y no repite
+ * p_lsr, p_rsl ni p_rlr dentro de t_* y q_*.
+ *
+ * @param a angulo alpha
+ * @param b angulo beta
+ * @param d distancia entre origen y destino (dividida el RADIO)
+ * @param w tramos de cada palabra, indexado por tipo_trayectoria_t
+ */
+void dubins_palabras(double a, double b, double d, dubins_palabra_t w[DUBINS_PALABRAS]);
+
+/**
+ * Calcula los tramos de las seis palabras de Dubins con las formulas de
+ * Shkel y Lumelsky. Todos los tramos quedan en [0, 2pi) y el largo de
+ * cada palabra es (t + p + q)*RADIO.
+ *
+ * @param a angulo alpha
+ * @param b angulo beta
+ * @param d distancia entre origen y destino (dividida el RADIO)
+ * @param w tramos de cada palabra, indexado por tipo_trayectoria_t
+ *
+ * @return mascara de palabras factibles (bit tipo_trayectoria_t)
+ */
+int dubins_palabras_exactas(double a, double b, double d, dubins_palabra_t w[DUBINS_PALABRAS]);
+
+/**
+ * Igual que dubins_palabras_exactas() pero calcula una sola palabra.
+ *
+ * @param tipo palabra a calcular
+ * @param a angulo alpha
+ * @param b angulo beta
+ * @param d distancia entre origen y destino (dividida el RADIO)
+ * @param w se escribe solo w[tipo]
+ *
+ * @return 1 si la palabra es factible, 0 si no
+ */
+int dubins_palabra_exacta(tipo_trayectoria_t tipo, double a, double b, double d, dubins_palabra_t w[DUBINS_PALABRAS]);
+
+/**
+ * Elige la palabra factible de menor largo.
+ *
+ * @param w tramos de cada palabra, ver dubins_palabras_exactas()
+ * @param factibles mascara de palabras factibles
+ *
+ * @return palabra de menor largo
+ */
+tipo_trayectoria_t eleccion_curva_dubins_minima(const dubins_palabra_t w[DUBINS_PALABRAS], int factibles);
+
 /**
  * Define que tipo de curva de Dubins es
  * la que minimiza la trayectoria
@@ -229,14 +394,15 @@ double q_lrl(double a, double b, double d);
  *
  * @param p_inicial
  * @param p_final
+ * @param w tramos de las seis palabras, ver dubins_palabras()
  * @param path_type
  */
-void eleccion_curva_dubins(cuadrantes_t cuad, way_point_t *p_inicial, way_point_t *p_final, tipo_trayectoria_t *path_type);
+void eleccion_curva_dubins(cuadrantes_t cuad, const way_point_t *p_inicial, const way_point_t *p_final, const dubins_palabra_t w[DUBINS_PALABRAS], tipo_trayectoria_t *path_type);
 
 /**
- * A partir del tipo de curva de Dubins y de
- * los way points iniciales y finales en ambos
- * sistemas de coordenadas, definen los datos
+ * A partir del tipo de curva de Dubins, de
+ * los way points iniciales y finales y de los
+ * tramos de cada palabra, definen los datos
  * de la trayactoria
  *
  * x inicial
@@ -256,26 +422,92 @@ void eleccion_curva_dubins(cuadrantes_t cuad, way_point_t *p_inicial, way_point_
  * largo trayectoria recta (dividio el RADIO)
  * angulo trayectoria segundo circulo
  */
-void find_path(tipo_trayectoria_t tipo, way_point_t *p_inicial, way_point_t *p_final, way_point_t *p_inicial_conv, way_point_t *p_final_conv, trayectoria_t *path);
+void find_path(tipo_trayectoria_t tipo, const way_point_t *p_inicial, const way_point_t *p_final, const dubins_palabra_t w[DUBINS_PALABRAS], trayectoria_t *path);
+
+/**
+ * Calcula los tramos (seg) de una trayectoria ya resuelta por find_path()
+ * o find_path_dubins(). Lo llaman ambas.
+ *
+ * @param path
+ */
+void trayectoria_segmentos(trayectoria_t *path);
+
+/**
+ * Igual que find_path() pero para tramos calculados con
+ * dubins_palabras_exactas(). Los puntos de cambio de tramo se obtienen
+ * propagando la pose inicial por cada tramo, por lo que sirve para las
+ * seis palabras (incluye el centro de la cfa intermedia de RLR y LRL).
+ */
+void find_path_dubins(tipo_trayectoria_t tipo, const way_point_t *p_inicial, const way_point_t *p_final, const dubins_palabra_t w[DUBINS_PALABRAS], trayectoria_t *path);
+
+/**
+ * Planifica la trayectoria que une un par de way points. Es reentrante y
+ * no reserva memoria: el resultado se escribe en path.
+ *
+ * @param p_inicial
+ * @param p_final
+ * @param path trayectoria resultante
+ */
+void path_planning_par(const way_point_t *p_inicial, const way_point_t *p_final, trayectoria_t *path);
+
+/**
+ * Las dos formas de elegir la palabra de path_planning_par(), que usa una
+ * u otra segun DUBINS_HEURISTICA. Se compilan siempre para poder
+ * compararlas (ver dubins_bench.c).
+ *
+ * _heuristica: tabla de cuadrantes, solo palabras CSC.
+ * _minima: la mas corta de las seis palabras.
+ */
+void path_planning_par_heuristica(const way_point_t *p_inicial, const way_point_t *p_final, trayectoria_t *path);
+void path_planning_par_minima(const way_point_t *p_inicial, const way_point_t *p_final, trayectoria_t *path);
 
 /**
  * Dada una trayectoria ya definida genera
  * una lista con la trayectoria discretizada
  * solo en terminos de posicion (x,y,z)
  */
-int path_discreto(trayectoria_t trayectoria, Lista_wp *lista);
+int path_discreto(trayectoria_t trayectoria, wp_buff_t *buff);
 
 /**
- * Loggea en un archivo de texto .txt una lista
+ * Loggea en un archivo de texto .txt un buffer
  * de way points (x,y,z)
  */
-int log_trayectoria_discreta(Lista_wp *lista);
+int log_trayectoria_discreta(wp_buff_t *buff);
+
+/**
+ * Loggea en trayectoria.txt las trayectorias que
+ * faltan recorrer
+ */
+int log_trayectoria(path_buff_t *buff);
 
 /**
  * Funcion principal que haciendo uso de todo el resto
- * genera un archivo .txt con una trayectoria discreta
- * a seguir
+ * genera las trayectorias que unen cada par de way
+ * points consecutivos. paths se agranda para que entren todas.
+ *
+ * Planifica la mision entera de una vez: wp no puede haber descartado way
+ * points y paths tiene que estar vacio, si no devuelve -1. Para misiones
+ * por stream, con buffers circulares, ver path_planning_horizonte().
+ *
+ * @return 0 si ok, -1 si no hay memoria o los buffers ya estan en uso
+ */
+int path_planning(wp_buff_t *wp, path_buff_t *paths);
+
+/**
+ * Planifica solo las trayectorias que faltan para tener 'horizonte'
+ * trayectorias desde la actual, con los way points que ya llegaron.
+ * La trayectoria i une los way points i e i+1, por lo que wp y paths
+ * tienen que haberse llenado siempre juntos desde el principio.
+ * Los way points que ya no hacen falta se descartan (wp_buff_descartar())
+ * para dejar lugar a los que siguen llegando, y las trayectorias nuevas
+ * ocupan los lugares de las ya recorridas.
+ *
+ * @param wp way points recibidos hasta ahora
+ * @param paths
+ * @param horizonte
+ *
+ * @return cantidad de trayectorias nuevas
  */
-int path_planning(Lista_wp *wp, Lista_path *lista_path);
+int path_planning_horizonte(wp_buff_t *wp, path_buff_t *paths, int horizonte);
 
 #endif
@@ -0,0 +1,89 @@
+#include <pthread.h>
+#include "path_planning_hilos.h"
+#include "dubins_lote.h"
+#include <uquad_error_codes.h>
+
+typedef struct tramo {
+    const way_point_t *wp;      // primer way point del tramo
+    int n;                      // way points del tramo (pares + 1)
+    trayectoria_t *paths;       // salida del tramo
+} tramo_t;
+
+static void planificar_tramo(const tramo_t *t)
+{
+#if DUBINS_HEURISTICA
+    int i;
+    for (i = 0; i < t->n - 1; i++)
+        path_planning_par(&t->wp[i], &t->wp[i+1], &t->paths[i]);
+#else
+    path_planning_lote(t->wp, t->n, t->paths);
+#endif
+}
+
+static void *planificar_tramo_hilo(void *arg)
+{
+    planificar_tramo((const tramo_t *)arg);
+    return NULL;
+}
+
+int path_planning_hilos(const way_point_t *wp, int n, trayectoria_t *paths, int hilos)
+{
+    tramo_t tramo[PATH_PLANNING_HILOS_MAX];
+    pthread_t hilo[PATH_PLANNING_HILOS_MAX];
+    int creado[PATH_PLANNING_HILOS_MAX];
+    int pares, por_hilo, inicio, k, retval;
+
+    if (wp == NULL || paths == NULL || hilos < 1) {
+        err_log("Argumentos invalidos");
+        return -1;
+    }
+    if (n < 2)
+        return 0;
+
+    pares = n - 1;
+    if (hilos > PATH_PLANNING_HILOS_MAX)
+        hilos = PATH_PLANNING_HILOS_MAX;
+    if (pares < 2*DUBINS_LOTE_BLOQUE*hilos)
+        hilos = pares/(2*DUBINS_LOTE_BLOQUE);
+    if (hilos <= 1) {
+        tramo[0].wp = wp;
+        tramo[0].n = n;
+        tramo[0].paths = paths;
+        planificar_tramo(&tramo[0]);
+        return 0;
+    }
+
+    // Hilos nuevos en cada llamada (ver path_planning_hilos.h), no usar
+    // desde el loop de control con hilos > 1
+    // Tramos contiguos, redondeados a bloques enteros
+    por_hilo = (pares + hilos - 1)/hilos;
+    por_hilo = ((por_hilo + DUBINS_LOTE_BLOQUE - 1)/DUBINS_LOTE_BLOQUE)*DUBINS_LOTE_BLOQUE;
+
+    for (k = 0, inicio = 0; k < hilos; k++, inicio += por_hilo) {
+        creado[k] = 0;
+        tramo[k].wp = &wp[inicio];
+        tramo[k].paths = &paths[inicio];
+        tramo[k].n = (inicio >= pares) ? 1 : ((pares - inicio < por_hilo) ? pares - inicio : por_hilo) + 1;
+        // El primer tramo lo hace el hilo que llama
+        if (k == 0 || tramo[k].n < 2)
+            continue;
+        retval = pthread_create(&hilo[k], NULL, planificar_tramo_hilo, &tramo[k]);
+        if (retval != 0) {
+            // Sin hilo el tramo se hace igual, al final en este hilo
+            err_log_num("pthread_create() failed!", retval);
+            continue;
+        }
+        creado[k] = 1;
+    }
+
+    planificar_tramo(&tramo[0]);
+
+    for (k = 1; k < hilos; k++) {
+        if (creado[k])
+            pthread_join(hilo[k], NULL);
+        else if (tramo[k].n >= 2)
+            planificar_tramo(&tramo[k]);
+    }
+
+    return 0;
+}
@@ -0,0 +1,37 @@
+#ifndef PATH_PLANNING_HILOS_H
+#define PATH_PLANNING_HILOS_H
+
+#include "path_planning.h"
+
+/**
+ * Planificacion de misiones largas repartida entre varios hilos.
+ *
+ * Cada trayectoria depende solo de su par de way points, asi que los pares
+ * se reparten en tramos contiguos (multiplos de DUBINS_LOTE_BLOQUE) y cada
+ * hilo escribe su tramo del arreglo de salida. El resultado es identico al
+ * de path_planning_lote() para cualquier cantidad de hilos.
+ *
+ * Los hilos se crean y se esperan en cada llamada, no hay un pool fijo. Es
+ * para planificar una mision entera de una vez (path_planning() antes del
+ * loop, o replanificar fuera de linea), donde crear los hilos cuesta mucho
+ * menos que los bloques que planifica cada uno. En el loop de control se
+ * usa path_planning_horizonte(), que llama con un hilo y no crea ninguno.
+ */
+
+#define PATH_PLANNING_HILOS_MAX 8   // hilos como maximo, contando al que llama
+
+/**
+ * Trayectorias para los n-1 pares consecutivos de wp.
+ * Con pocos pares (menos de dos bloques por hilo) se planifica en el hilo
+ * que llama, sin crear hilos.
+ *
+ * @param wp way points
+ * @param n cantidad de way points
+ * @param paths salida, n-1 trayectorias
+ * @param hilos cantidad de hilos a usar (se limita a PATH_PLANNING_HILOS_MAX)
+ *
+ * @return 0 si OK, -1 si los argumentos no son validos
+ */
+int path_planning_hilos(const way_point_t *wp, int n, trayectoria_t *paths, int hilos);
+
+#endif
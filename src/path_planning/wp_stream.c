@@ -0,0 +1,184 @@
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "wp_stream.h"
+#include "mision.h"
+#include <uquad_error_codes.h>
+
+void wp_stream_init_fd(wp_stream_t *s, int fd)
+{
+    struct stat st;
+    int flags;
+
+    s->fd = fd;
+    s->len = 0;
+    s->n_campos = 0;
+    s->linea = 1;
+    s->fin = false;
+    s->archivo = (fstat(fd, &st) == 0 && S_ISREG(st.st_mode));
+    s->mapa.base = NULL;
+    s->mapa.wp = NULL;
+    s->mapa.n = 0;
+    s->sig = 0;
+
+    flags = fcntl(fd, F_GETFL);
+    if (flags >= 0)
+        (void)fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+int wp_stream_open(wp_stream_t *s, const char *path)
+{
+    char magic[sizeof(MISION_MAGIC)];
+
+    // Abro bloqueante: si es un FIFO espero a que haya quien escriba, sino
+    // read() devolveria EOF enseguida
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        err_log_stderr("open()");
+        return -1;
+    }
+
+    wp_stream_init_fd(s, fd);
+
+    // Mision binaria: se mapea entera, el fd no hace falta
+    if (s->archivo && pread(fd, magic, sizeof(magic), 0) == (ssize_t)sizeof(magic) &&
+        memcmp(magic, MISION_MAGIC, sizeof(MISION_MAGIC)) == 0) {
+        close(fd);
+        s->fd = -1;
+        if (mision_map_abrir(path, &s->mapa) < 0)
+            return -1;
+        s->fin = (s->mapa.n == 0);
+    }
+    return 0;
+}
+
+/* Copia way points de la mision mapeada mientras haya lugar */
+static int wp_stream_leer_mapa(wp_stream_t *s, wp_buff_t *wp_buff)
+{
+    int nuevos = 0;
+
+    while (s->sig < s->mapa.n && wp_buff_add(wp_buff, s->mapa.wp[s->sig]) == 0) {
+        s->sig++;
+        nuevos++;
+    }
+    if (s->sig == s->mapa.n)
+        s->fin = true;
+
+    return nuevos;
+}
+
+/* Procesa los numeros completos de s->buff, devuelve way points agregados */
+static int wp_stream_procesar(wp_stream_t *s, wp_buff_t *wp_buff)
+{
+    way_point_t wp;
+    char *p = s->buff, *fin_buff = s->buff + s->len, *tok;
+    const char *end;
+    int nuevos = 0;
+    bool lleno = false;
+
+    while (1) {
+        // Salteo blancos
+        while (p < fin_buff && isspace((unsigned char)*p)) {
+            if (*p == '\n')
+                s->linea++;
+            p++;
+        }
+        tok = p;
+        while (p < fin_buff && !isspace((unsigned char)*p))
+            p++;
+        if (tok == p)
+            break;
+        if (s->n_campos == 0 && wp_buff_lleno(wp_buff)) {
+            // Sigue cuando haya lugar
+            p = tok;
+            lleno = true;
+            break;
+        }
+        if (p == fin_buff && !s->fin) {
+            // El numero puede seguir en la proxima lectura
+            p = tok;
+            break;
+        }
+
+        end = mision_parse_double(tok, p, &s->campos[s->n_campos]);
+        if (end != p) {
+            err_log_num("Valor invalido en la linea", s->linea);
+            return -1;
+        }
+
+        if (++s->n_campos == 4) {
+            s->n_campos = 0;
+            wp.x = s->campos[0];
+            wp.y = s->campos[1];
+            wp.z = s->campos[2];
+            wp.angulo = conversion_grados2rad(s->campos[3]);
+            (void)wp_buff_add(wp_buff, wp);
+            nuevos++;
+        }
+    }
+
+    // Lo que quedo sin procesar pasa al principio
+    s->len = fin_buff - p;
+    memmove(s->buff, p, s->len);
+
+    if (!lleno && s->len == WP_STREAM_BUFF - 1) {
+        err_log_num("Valor demasiado largo en la linea", s->linea);
+        return -1;
+    }
+    if (s->fin && s->n_campos != 0)
+        err_log("WARN: el ultimo way point esta incompleto, se descarta");
+
+    return nuevos;
+}
+
+int wp_stream_leer(wp_stream_t *s, wp_buff_t *wp_buff)
+{
+    ssize_t leidos;
+    int retval, nuevos = 0;
+
+    if (s->mapa.base != NULL)
+        return wp_stream_leer_mapa(s, wp_buff);
+
+    // Primero lo que quedo pendiente por falta de lugar
+    if (s->len > 0) {
+        nuevos = wp_stream_procesar(s, wp_buff);
+        if (nuevos < 0)
+            return -1;
+    }
+
+    while (!s->fin && !wp_buff_lleno(wp_buff)) {
+        leidos = read(s->fd, s->buff + s->len, WP_STREAM_BUFF - 1 - s->len);
+        if (leidos < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            err_log_stderr("read()");
+            return -1;
+        }
+        if (leidos == 0)
+            s->fin = true;
+        s->len += leidos;
+
+        retval = wp_stream_procesar(s, wp_buff);
+        if (retval < 0)
+            return -1;
+        nuevos += retval;
+    }
+
+    return nuevos;
+}
+
+void wp_stream_close(wp_stream_t *s)
+{
+    if (s->fd >= 0)
+        close(s->fd);
+    mision_map_cerrar(&s->mapa);
+    s->fd = -1;
+    s->fin = true;
+    s->len = 0;
+}
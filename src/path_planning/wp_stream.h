@@ -0,0 +1,84 @@
+#ifndef WP_STREAM_H
+#define WP_STREAM_H
+
+#include <stdbool.h>
+#include "path_planning.h"
+#include "mision.h"
+
+/**
+ * Lectura de way points a medida que llegan, desde un archivo, un pipe o
+ * un socket. El formato es el mismo que lee way_points_input(): cuatro
+ * numeros separados por blancos (x y z angulo, angulo en grados) por way
+ * point. Los way points se agregan al wp_buff_t a medida que se completan,
+ * para poder planificar sin esperar al resto de la mision.
+ *
+ * Si el wp_buff_t se llena la lectura se pausa, sin error, hasta que se
+ * descarten way points (ver path_planning_horizonte()).
+ *
+ * Un archivo regular que empieza con MISION_MAGIC (generado con mision2bin)
+ * se mapea con mision_map_abrir() y sus way points se copian al buffer a
+ * medida que hay lugar, sin parsear.
+ */
+
+#define WP_STREAM_BUFF 256      // bytes de lectura pendientes de procesar
+
+typedef struct wp_stream {
+    int fd;
+    char buff[WP_STREAM_BUFF];
+    int len;                    // bytes en buff sin procesar
+    double campos[4];           // way point a medio leer
+    int n_campos;
+    int linea;                  // linea actual, para mensajes de error
+    bool fin;                   // se llego al EOF, no hay mas para leer
+    bool archivo;               // archivo regular, no se puede usar con epoll
+    mision_map_t mapa;          // mision binaria, mapa.base == NULL si es texto
+    int sig;                    // proximo way point de mapa a agregar
+} wp_stream_t;
+
+/**
+ * Abre un archivo o FIFO. Si es un FIFO espera a que se conecte quien
+ * escribe. El fd queda en modo no bloqueante para usarlo con epoll.
+ * Si es una mision binaria se mapea y no queda ningun fd abierto.
+ *
+ * @param s
+ * @param path
+ *
+ * @return 0 si OK, -1 si no se pudo abrir
+ */
+int wp_stream_open(wp_stream_t *s, const char *path);
+
+/**
+ * Usa un fd ya abierto (ej: socket). Se pasa a modo no bloqueante.
+ *
+ * @param s
+ * @param fd
+ */
+void wp_stream_init_fd(wp_stream_t *s, int fd);
+
+/**
+ * Lee lo que haya disponible y agrega los way points completos al buffer.
+ * No bloquea. Si el buffer se llena deja de leer, y lo que quedo pendiente
+ * se agrega en las proximas llamadas.
+ *
+ * @param s
+ * @param wp_buff
+ *
+ * @return cantidad de way points agregados, -1 si hubo un error de lectura
+ *         o un valor invalido
+ */
+int wp_stream_leer(wp_stream_t *s, wp_buff_t *wp_buff);
+
+/* Ya se agregaron todos los way points del stream */
+static inline bool wp_stream_terminado(const wp_stream_t *s)
+{
+    return s->fin && s->len == 0;
+}
+
+/**
+ * Cierra el fd, o desmapea la mision binaria.
+ *
+ * @param s
+ */
+void wp_stream_close(wp_stream_t *s);
+
+#endif
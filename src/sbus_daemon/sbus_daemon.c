@@ -4,30 +4,43 @@
 #include <uquad_aux_time.h>
 #include <uquad_error_codes.h>
 #include <quadcop_config.h>
-#include <uquad_kernel_msgq.h>
+#include <uquad_shm_cmd.h>
 
 #include <stdio.h>   /* Standard input/output definitions */
 #include <errno.h>   /* Error number definitions */
 #include <unistd.h>
 #include <stdint.h>
 #include <sys/resource.h> // for setpriority()
+#include <sched.h> // for sched_setscheduler()
+#include <sys/mman.h> // for mlockall()
 #include <signal.h> // for SIGINT, SIGQUIT
 #include <stdlib.h> 
 #include <fcntl.h>
 #include <sys/prctl.h>
 
-// kernel queues
-#include <sys/ipc.h> // for IPC_NOWAIT
-#include <sys/msg.h>
-
-#define CH_COUNT		6
+#define CH_COUNT		UQUAD_CMD_CH_COUNT
 #define LOOP_T_US		14000UL
+#define LOOP_T_NS		(LOOP_T_US*1000L)
 #define MAX_ERR_SBUSD		20
+// Heartbeat: edad maxima del ultimo comando, la misma tolerancia que tiene
+// el main con los acks de sbusd
+#define CMD_MAX_AGE_US		(UQUAD_KQ_MAX_ACKS_MISSED*MAIN_LOOP_T_US)
 
 #define HOW_TO    		"./sbus_daemon <device>"
 
+/* Histograma del atraso de cada trama respecto a su deadline. La clase 0
+ * cuenta atrasos menores a 1us y la clase i atrasos en [2^(i-1), 2^i) us.
+ * La ultima clase acumula todo lo que no entra en las anteriores. */
+#define LATE_HIST_LEN		16
+
 // Global vars
-static message_buf_t rbuf; //Buffer para almacenar mensajes de kernel
+static uquad_shm_cmd_t *shm_cmd = NULL; //Bloque de comandos compartido con main
+static uint16_t rbuf[CH_COUNT]; //Ultimo comando leido
+
+static unsigned long late_hist[LATE_HIST_LEN];
+static long long late_max_ns = 0;
+static unsigned long frames_missed = 0;
+static volatile sig_atomic_t dump_hist = 0; //SIGUSR1 pide imprimir el histograma
 
 /* Variable que almacena el file descriptor del puerto serie
  * usado para enviar el mensaje sbus. */
@@ -43,6 +56,7 @@ FILE * fp = NULL;
 void quit()
 {
     int ret;
+    uquad_shm_cmd_deinit(shm_cmd);
 #if !PC_TEST
     ret = close(fd);
     if(ret < 0)
@@ -66,6 +80,41 @@ void uquad_sig_handler(int signal_num){
     quit();
 }
 
+void dump_hist_handler(int signal_num){
+    dump_hist = 1;
+}
+
+static void late_hist_add(long long late_ns)
+{
+    long long us = late_ns/1000;
+    int i = 0;
+
+    while(us > 0 && i < LATE_HIST_LEN-1)
+    {
+	us >>= 1;
+	i++;
+    }
+    late_hist[i]++;
+    if(late_ns > late_max_ns)
+	late_max_ns = late_ns;
+}
+
+static void late_hist_print(FILE *out)
+{
+    int i;
+    unsigned long total = 0;
+
+    for(i=0; i<LATE_HIST_LEN; i++)
+	total += late_hist[i];
+    fprintf(out, "sbusd: %lu tramas, atraso max %lld us, tramas perdidas %lu\n",
+	    total, late_max_ns/1000, frames_missed);
+    fprintf(out, "\t<1 us:\t%lu\n", late_hist[0]);
+    for(i=1; i<LATE_HIST_LEN-1; i++)
+	fprintf(out, "\t<%ld us:\t%lu\n", 1L << i, late_hist[i]);
+    fprintf(out, "\tmas:\t%lu\n", late_hist[LATE_HIST_LEN-1]);
+    fflush(out);
+}
+
 
 int main(int argc, char *argv[])
 {  
@@ -74,10 +123,8 @@ int main(int argc, char *argv[])
    int rcv_err_count = 0;
    bool msg_received = false;
    char* device;
-   /* Para parsear el los mensajes se recorre el arreglo con un puntero
-    *  a enteros de dos bytes.
-    */
-   int16_t *ch_buff;
+   /* Los canales se interpretan con signo, como en futaba_sbus_set_channel(). */
+   int16_t *ch_buff = (int16_t *)rbuf;
    
    //char str[128]; // dbg
 
@@ -89,12 +136,9 @@ int main(int argc, char *argv[])
    }
    else device = argv[1];
 
-   struct timeval tv_in;
-   struct timeval tv_end;
-   struct timeval tv_diff;
-#if DEBUG_TIMING_SBUSD
-   struct timeval tv_last;
-#endif //#if DEBUG_TIMING_SBUSD
+   struct timespec deadline;
+   struct timespec now;
+   long long late_ns;
 
 #if !PC_TEST 
    fd = open_port(device);
@@ -111,6 +155,18 @@ int main(int argc, char *argv[])
    }
 #endif
 
+#if SBUSD_SCHED_FIFO
+   /**
+    * Tiempo real: sbusd le gana al main y a los parsers en el unico core.
+    */
+   struct sched_param sp;
+   sp.sched_priority = SBUSD_FIFO_PRIO;
+   if(sched_setscheduler(0, SCHED_FIFO, &sp) == -1)   //requires being superuser
+   {
+      err_log_num("sched_setscheduler() failed!",errno);
+      return -1;
+   }
+#else
    /**
     * Inherit priority from main.c for correct IPC.
     */
@@ -119,12 +175,30 @@ int main(int argc, char *argv[])
       err_log_num("setpriority() failed!",errno);
       return -1;
     }
+#endif //SBUSD_SCHED_FIFO
+
+#if SBUSD_MLOCKALL
+   if(mlockall(MCL_CURRENT | MCL_FUTURE) == -1)   //requires being superuser
+   {
+      err_log_num("mlockall() failed!",errno);
+      return -1;
+   }
+#endif //SBUSD_MLOCKALL
 
    // Catch signals
    prctl(PR_SET_PDEATHSIG, SIGHUP);
    signal(SIGHUP, uquad_sig_handler);
    signal(SIGINT, uquad_sig_handler);
    signal(SIGQUIT, uquad_sig_handler);
+   signal(SIGUSR1, dump_hist_handler);
+
+   // El bloque de comandos lo crea el main antes de lanzar sbusd
+   shm_cmd = uquad_shm_cmd_init(false);
+   if(shm_cmd == NULL)
+   {
+      err_log("Failed to open command block!");
+      quit();
+   }
 
 #if PC_TEST
    futaba_sbus_begin(); //para tiempo de start
@@ -142,13 +216,14 @@ int main(int argc, char *argv[])
    
    bool main_ready = false;
 
+   // Los deadlines son absolutos, el periodo no acumula error
+   clock_gettime(CLOCK_MONOTONIC, &deadline);
+
    // -- -- -- -- -- -- -- -- -- -- -- -- -- -- -- -- -- --
    // Loop
    // -- -- -- -- -- -- -- -- -- -- -- -- -- -- -- -- -- --
    for(;;)
    {
-	gettimeofday(&tv_in,NULL);
-
 	//printf("errores: %d\n",err_count);//dbg
 
 #if !PC_TEST
@@ -160,21 +235,14 @@ int main(int argc, char *argv[])
 	}
 #endif
 
-	ret = uquad_read(&rbuf);
+	// Lee el ultimo comando, el ack queda implicito en la lectura
+	ret = uquad_shm_cmd_read(shm_cmd, rbuf);
 	if(ret == ERROR_OK)
 	{
 	   if(!main_ready) main_ready = true;
 
            //err_log("read ok!");
  	   msg_received = true;
-	   // Parse message. 2 bytes per channel.
-	   ch_buff = (int16_t *)rbuf.mtext;
-	   // send ack
-	   ret = uquad_send_ack();
-	   if(ret != ERROR_OK)
-	   {
-		err_log("Failed to send ack!");
-	   }
 	   if (rcv_err_count > 0)
 		rcv_err_count = 0;
            
@@ -186,6 +254,13 @@ int main(int argc, char *argv[])
 		err_count++;
 		rcv_err_count = 0;
 	   }
+	   // Con el main colgado (vivo, sin PDEATHSIG) el seq no avanza y el
+	   // heartbeat envejece: se deja de enviar sbus y la CC3D entra en failsafe
+	   if (main_ready && uquad_shm_cmd_age_us(shm_cmd) > (long)CMD_MAX_AGE_US)
+	   {
+		err_log("main no envia comandos, heartbeat vencido");
+		quit();
+	   }
 	}
 
 	if(msg_received)
@@ -208,6 +283,10 @@ int main(int argc, char *argv[])
 		futaba_sbus_set_failsafe(SBUS_SIGNAL_OK);
  
 	   futaba_sbus_update_msg();
+#if DEBUG_SBUS_ENCODER
+	   if (futaba_sbus_check_msg() < 0)
+		err_count++;
+#endif //DEBUG_SBUS_ENCODER
 	   msg_received = false;
 	   //print_sbus_data();  // dbg
 	}
@@ -224,30 +303,33 @@ int main(int argc, char *argv[])
 	   if(err_count > 0)
 	      err_count--;
 	}
-	sleep_ms(5);  //TODO revisar si hay que hacerlo siempre!!
-#else
-	sleep_ms(5);  //TODO revisar si hay que hacerlo siempre!!
 #endif
 	// Escribe el mensaje a stdout - dbg
 	//convert_sbus_data(str);
 	//printf("%s",str);
 
 	/// Control de tiempo
-	gettimeofday(&tv_end,NULL);
-	ret = uquad_timeval_substract(&tv_diff, tv_end, tv_in);
-	if(ret > 0)
+	uquad_timespec_add_ns(&deadline, LOOP_T_NS);
+	while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR)
+	   ; // SIGUSR1, se vuelve a dormir hasta el mismo deadline
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	late_ns = uquad_timespec_diff_ns(&now, &deadline);
+	late_hist_add(late_ns);
+	if(late_ns >= LOOP_T_NS)
 	{
-	   if(tv_diff.tv_usec < LOOP_T_US)
-		usleep(LOOP_T_US - (unsigned long)tv_diff.tv_usec);
+	   // Se perdieron tramas: se resincroniza en lugar de mandarlas en rafaga
+	   frames_missed += (unsigned long)(late_ns / LOOP_T_NS);
+	   deadline = now;
+	}
+	if(dump_hist)
+	{
+	   late_hist_print(stderr);
+	   dump_hist = 0;
+	}
 #if DEBUG_TIMING_SBUSD
-           gettimeofday(&tv_end,NULL);
-           uquad_timeval_substract(&tv_diff, tv_end, tv_in);
-           printf("duracion loop sbusd (14ms): %lu\n",(unsigned long)tv_diff.tv_usec);
+	printf("atraso sbusd: %lld us\tedad comando: %ld\n", late_ns/1000,
+	       uquad_shm_cmd_age_us(shm_cmd));
 #endif
-	} else {
-	   err_log("WARN: Absurd timing!");
-	   err_count++; // si no cumplo el tiempo de loop falla la comunicacion sbus
-	}
 
       //printf("rcv_err_count: %d\n", rcv_err_count);
       //printf("err_count: %d\n", err_count);
@@ -139,6 +139,27 @@ void serial_flush(int fd)
 }
 
 
+int serial_set_vmin(int fd, cc_t vmin)
+{
+  struct termios options;
+
+  if(tcgetattr(fd, &options) < 0){
+     err_log_stderr("Error al obtener atributos: ");
+     return -1;
+  }
+
+  options.c_cc[VMIN]  = vmin;
+  options.c_cc[VTIME] = 0;
+
+  if(tcsetattr(fd, TCSANOW, &options) < 0){
+     err_log_stderr("Error al aplicar nuevos atributos: ");
+     return -1;
+  }
+
+  return 0;
+}
+
+
 /* devuelve true si puedo leer, false si no puedo */
 bool check_read_locks(int fd) {
 
@@ -49,6 +49,19 @@ int configure_port_gps(int fd, speed_t baudrate);
 
 void serial_flush(int fd);
 
+/**
+ * Configura la cantidad minima de bytes (VMIN) para considerar que el
+ * puerto tiene datos. Con VTIME = 0 poll()/epoll() solo reportan el fd
+ * como legible cuando hay al menos vmin bytes en el buffer de entrada,
+ * evitando despertar al proceso por tramas incompletas.
+ *
+ * @param fd file descriptor del puerto
+ * @param vmin cantidad minima de bytes
+ *
+ * @return 0 si ok, -1 si falla
+ */
+int serial_set_vmin(int fd, cc_t vmin);
+
 bool check_read_locks(int fd);
 bool check_write_locks(int fd);
 
@@ -0,0 +1,247 @@
+/**
+ ******************************************************************************
+ *
+ * @file       uquad_shm_cmd.c
+ * @author     Federico Favaro, Joaquin Berrutti y Lucas Falkenstein
+ * @brief      Bloque de comandos en memoria compartida entre el main y sbusd.
+ *
+ *****************************************************************************/
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <http://www.gnu.org/licenses/> or write to the
+ * Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "uquad_shm_cmd.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Reintentos de lectura si el main esta escribiendo justo en ese momento
+#define UQUAD_SHM_CMD_MAX_RETRY	10
+
+uquad_shm_cmd_t *uquad_shm_cmd_init(bool server)
+{
+    int fd;
+    void *p;
+    struct stat st;
+    uquad_shm_cmd_t *cmd = (uquad_shm_cmd_t *)malloc(sizeof(uquad_shm_cmd_t));
+    if(cmd == NULL)
+    {
+	err_log_stderr("malloc()");
+	return NULL;
+    }
+
+    if(server)
+    {
+	// Si quedo un bloque de una corrida anterior se descarta
+	shm_unlink(UQUAD_SHM_CMD_NAME);
+	fd = shm_open(UQUAD_SHM_CMD_NAME, O_CREAT | O_EXCL | O_RDWR, 0600);
+    }
+    else
+	fd = shm_open(UQUAD_SHM_CMD_NAME, O_RDWR, 0);
+    if(fd < 0)
+    {
+	err_log_stderr("shm_open()");
+	free(cmd);
+	return NULL;
+    }
+
+    if(server && ftruncate(fd, sizeof(uquad_cmd_block_t)) < 0)
+    {
+	err_log_stderr("ftruncate()");
+	close(fd);
+	shm_unlink(UQUAD_SHM_CMD_NAME);
+	free(cmd);
+	return NULL;
+    }
+
+    // Un bloque de otro tamano es de otra version (y mapearlo podria dar SIGBUS)
+    if(!server && (fstat(fd, &st) < 0 || st.st_size != sizeof(uquad_cmd_block_t)))
+    {
+	err_log("Command block size mismatch, main and sbusd versions differ?");
+	close(fd);
+	free(cmd);
+	return NULL;
+    }
+
+    p = mmap(NULL, sizeof(uquad_cmd_block_t), PROT_READ | PROT_WRITE,
+	     MAP_SHARED, fd, 0);
+    // El mapeo sigue siendo valido luego de cerrar el fd
+    close(fd);
+    if(p == MAP_FAILED)
+    {
+	err_log_stderr("mmap()");
+	if(server)
+	    shm_unlink(UQUAD_SHM_CMD_NAME);
+	free(cmd);
+	return NULL;
+    }
+
+    cmd->blk = (uquad_cmd_block_t *)p;
+    cmd->server = server;
+    cmd->acks_missed = 0;
+    if(server)
+    {
+	memset(cmd->blk, 0, sizeof(uquad_cmd_block_t));
+	cmd->blk->magic = UQUAD_SHM_CMD_MAGIC;
+	cmd->blk->version = UQUAD_SHM_CMD_VERSION;
+	cmd->blk->size = sizeof(uquad_cmd_block_t);
+	cmd->last_seq = 0;
+    }
+    else if(cmd->blk->magic != UQUAD_SHM_CMD_MAGIC ||
+	    cmd->blk->version != UQUAD_SHM_CMD_VERSION ||
+	    cmd->blk->size != sizeof(uquad_cmd_block_t))
+    {
+	err_log_num("Command block version mismatch! version:", (int)cmd->blk->version);
+	munmap(p, sizeof(uquad_cmd_block_t));
+	free(cmd);
+	return NULL;
+    }
+    else
+	// Solo interesan los comandos enviados de aca en adelante
+	cmd->last_seq = __atomic_load_n(&cmd->blk->seq, __ATOMIC_ACQUIRE) & ~1U;
+
+    return cmd;
+}
+
+/**
+ * Copia el contenido del bloque de forma consistente.
+ *
+ * @return seq de la copia, o un numero impar si no se logro una copia consistente
+ */
+static uint32_t uquad_shm_cmd_snapshot(const uquad_cmd_block_t *blk, uint16_t *ch, struct timespec *ts)
+{
+    uint32_t s0, s1;
+    int i, retry;
+
+    for(retry = 0; retry < UQUAD_SHM_CMD_MAX_RETRY; ++retry)
+    {
+	s0 = __atomic_load_n(&blk->seq, __ATOMIC_ACQUIRE);
+	if(s0 & 1U)
+	    continue;
+	if(ch != NULL)
+	    for(i = 0; i < UQUAD_CMD_CH_COUNT; ++i)
+		ch[i] = blk->ch[i];
+	if(ts != NULL)
+	    *ts = blk->ts;
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	s1 = __atomic_load_n(&blk->seq, __ATOMIC_RELAXED);
+	if(s0 == s1)
+	    return s0;
+    }
+
+    return 1U;
+}
+
+int uquad_shm_cmd_send(uquad_shm_cmd_t *cmd, const uint16_t *ch)
+{
+    int i, retval = ERROR_OK;
+    uquad_cmd_block_t *blk;
+    uint32_t seq;
+
+    if(cmd == NULL || !cmd->server || ch == NULL)
+    {
+	err_check(ERROR_INVALID_ARG,"Invalid argument!");
+    }
+    blk = cmd->blk;
+
+    // Verifica que sbusd haya leido el comando anterior
+    if(cmd->last_seq != 0)
+    {
+	if(__atomic_load_n(&blk->ack_seq, __ATOMIC_ACQUIRE) == cmd->last_seq)
+	{
+	    if(cmd->acks_missed > UQUAD_KQ_WARN_ACKS)
+	    {
+		err_log_num("sbusd recovered! acks missed:",cmd->acks_missed);
+	    }
+	    cmd->acks_missed = 0;
+	}
+	else
+	{
+	    if(++cmd->acks_missed > UQUAD_KQ_MAX_ACKS_MISSED)
+	    {
+		err_check(ERROR_KQ_ACK_NONE,"Missed too many acks!");
+	    }
+	    if(cmd->acks_missed > UQUAD_KQ_WARN_ACKS)
+	    {
+		err_log_num("WARN: client did not ack!",cmd->acks_missed);
+	    }
+	    retval = ERROR_KQ_ACK_NONE;
+	}
+    }
+
+    seq = cmd->last_seq;
+    __atomic_store_n(&blk->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    for(i = 0; i < UQUAD_CMD_CH_COUNT; ++i)
+	blk->ch[i] = ch[i];
+    clock_gettime(CLOCK_MONOTONIC, &blk->ts);
+    __atomic_store_n(&blk->seq, seq + 2, __ATOMIC_RELEASE);
+    cmd->last_seq = seq + 2;
+
+    // Un ack faltante aislado no es un error para quien llama
+    return (retval == ERROR_KQ_ACK_NONE) ? ERROR_OK : retval;
+}
+
+int uquad_shm_cmd_read(uquad_shm_cmd_t *cmd, uint16_t *ch)
+{
+    uint32_t seq;
+
+    if(cmd == NULL || cmd->server || ch == NULL)
+    {
+	err_check(ERROR_INVALID_ARG,"Invalid argument!");
+    }
+
+    // Sin syscalls: si no cambio la secuencia no hay comando nuevo
+    if(__atomic_load_n(&cmd->blk->seq, __ATOMIC_ACQUIRE) == cmd->last_seq)
+	return ERROR_KQ_NO_ACKS_AVAIL;
+
+    seq = uquad_shm_cmd_snapshot(cmd->blk, ch, NULL);
+    if(seq & 1U)
+	// El main esta escribiendo, se lee en la proxima iteracion
+	return ERROR_KQ_NO_ACKS_AVAIL;
+
+    cmd->last_seq = seq;
+    __atomic_store_n(&cmd->blk->ack_seq, seq, __ATOMIC_RELEASE);
+
+    return ERROR_OK;
+}
+
+long uquad_shm_cmd_age_us(uquad_shm_cmd_t *cmd)
+{
+    struct timespec ts, now;
+    uint32_t seq;
+
+    if(cmd == NULL)
+	return -1;
+    seq = uquad_shm_cmd_snapshot(cmd->blk, NULL, &ts);
+    if(seq == 0 || (seq & 1U))
+	return -1;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long)(now.tv_sec - ts.tv_sec)*1000000L + (now.tv_nsec - ts.tv_nsec)/1000L;
+}
+
+void uquad_shm_cmd_deinit(uquad_shm_cmd_t *cmd)
+{
+    if(cmd == NULL)
+	return;
+    munmap(cmd->blk, sizeof(uquad_cmd_block_t));
+    if(cmd->server)
+	shm_unlink(UQUAD_SHM_CMD_NAME);
+    free(cmd);
+}
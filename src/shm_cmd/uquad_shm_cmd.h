@@ -0,0 +1,128 @@
+/**
+ ******************************************************************************
+ *
+ * @file       uquad_shm_cmd.h
+ * @author     Federico Favaro, Joaquin Berrutti y Lucas Falkenstein
+ * @brief      Bloque de comandos en memoria compartida entre el main y sbusd.
+ *
+ * Reemplaza a las colas de mensajes de kernel. El main escribe los canales
+ * en un bloque de memoria compartida POSIX protegido con un numero de
+ * secuencia (seqlock) junto con un timestamp de heartbeat. sbusd lee el
+ * ultimo comando sin locks ni syscalls y devuelve como ack el numero de
+ * secuencia leido. Si sbusd deja de confirmar comandos el main se detiene
+ * luego de UQUAD_KQ_MAX_ACKS_MISSED envios, igual que con las colas.
+ *
+ * Como sbusd se ejecuta con execl() no hereda mapeos anonimos, por eso
+ * se usa un objeto con nombre (shm_open).
+ *
+ * Examples:
+ *   - src/main/main.c
+ *   - src/sbus_daemon/sbus_daemon.c
+ *
+ *****************************************************************************/
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, see <http://www.gnu.org/licenses/> or write to the
+ * Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+#ifndef UQUAD_SHM_CMD_H
+#define UQUAD_SHM_CMD_H
+
+#include <uquad_error_codes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#define UQUAD_SHM_CMD_NAME	"/uquad_cmd"
+#define UQUAD_SHM_CMD_MAGIC	0x55514344	// "UQCD"
+#define UQUAD_SHM_CMD_VERSION	1		// cambiar si cambia uquad_cmd_block_t
+#define UQUAD_CMD_CH_COUNT	6	// canales enviados a sbusd (ver *_CH_INDEX en futaba_sbus.h)
+
+#define UQUAD_KQ_WARN_ACKS       0   // # of errors to allow before logging errors
+#define UQUAD_KQ_MAX_ACKS_MISSED 20
+
+/**
+ * Bloque compartido. Solo el main escribe seq, ch y ts; solo sbusd escribe
+ * ack_seq. seq es impar mientras el main esta escribiendo.
+ *
+ * main y sbusd son binarios distintos: magic, version y size los escribe
+ * el main al crear el bloque y sbusd no se conecta si no coinciden con los
+ * suyos (ej: un sbusd viejo con otro formato).
+ */
+typedef struct uquad_cmd_block {
+    uint32_t magic;		// UQUAD_SHM_CMD_MAGIC
+    uint32_t version;		// UQUAD_SHM_CMD_VERSION
+    uint32_t size;		// sizeof(uquad_cmd_block_t)
+    uint32_t seq;
+    uint16_t ch[UQUAD_CMD_CH_COUNT];
+    struct timespec ts;		// heartbeat: CLOCK_MONOTONIC del ultimo envio
+    uint32_t ack_seq;		// ultimo seq leido por sbusd
+} uquad_cmd_block_t;
+
+typedef struct uquad_shm_cmd {
+    uquad_cmd_block_t *blk;
+    bool server;		// true en el main (crea y borra el objeto)
+    uint32_t last_seq;		// server: ultimo seq enviado, client: ultimo seq leido
+    int acks_missed;		// envios seguidos sin ack (solo server)
+} uquad_shm_cmd_t;
+
+/**
+ * Abre el bloque compartido. El server (main) lo crea y lo inicializa,
+ * por lo que debe llamarse antes de lanzar sbusd. El client (sbusd)
+ * falla si el bloque no existe o si su formato no coincide.
+ *
+ * @param server true para el main, false para sbusd
+ *
+ * @return puntero al bloque, NULL si falla
+ */
+uquad_shm_cmd_t *uquad_shm_cmd_init(bool server);
+
+/**
+ * Publica un nuevo comando (solo server). Antes verifica que sbusd haya
+ * leido el comando anterior; si se pierden mas de UQUAD_KQ_MAX_ACKS_MISSED
+ * acks seguidos devuelve error.
+ *
+ * @param cmd
+ * @param ch arreglo de UQUAD_CMD_CH_COUNT canales
+ *
+ * @return error code
+ */
+int uquad_shm_cmd_send(uquad_shm_cmd_t *cmd, const uint16_t *ch);
+
+/**
+ * Lee el ultimo comando publicado (solo client) y lo confirma.
+ *
+ * @param cmd
+ * @param ch arreglo de UQUAD_CMD_CH_COUNT canales donde copiar el comando
+ *
+ * @return ERROR_OK si habia un comando nuevo, ERROR_KQ_NO_ACKS_AVAIL si no
+ */
+int uquad_shm_cmd_read(uquad_shm_cmd_t *cmd, uint16_t *ch);
+
+/**
+ * Tiempo transcurrido desde el ultimo comando publicado (heartbeat).
+ *
+ * @param cmd
+ *
+ * @return edad del ultimo comando en microsegundos, -1 si nunca se envio
+ */
+long uquad_shm_cmd_age_us(uquad_shm_cmd_t *cmd);
+
+/**
+ * Desmapea el bloque. El server ademas borra el objeto compartido.
+ *
+ * @param cmd
+ */
+void uquad_shm_cmd_deinit(uquad_shm_cmd_t *cmd);
+
+#endif //UQUAD_SHM_CMD_H
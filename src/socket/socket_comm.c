@@ -88,40 +88,39 @@ int socket_comm_wait_client(void)
 }
 
 
-int socket_comm_send_path(Lista_path *lista)
+int socket_comm_send_path(path_buff_t *buff)
 {
-   Elemento_path *elemento = lista->inicio;
+   const trayectoria_t *path;
 
-   int lista_tamano = lista->tamano;
+   int lista_tamano = path_buff_restantes(buff);
 
    double buffer_sock_double[19*lista_tamano+1];
    int buffer_sock_double_len = sizeof(buffer_sock_double);
 
-   buffer_sock_double[0] = (double)lista->tamano;
+   buffer_sock_double[0] = (double)lista_tamano;
  
-   int i = 0;
-   while (elemento != NULL) {
+   int i;
+   for (i = 0; i < lista_tamano; i++) {
+	path = path_buff_get(buff, buff->actual + i);
 	buffer_sock_double[1+i*19] = RADIO;
-	buffer_sock_double[2+i*19] = elemento->dato->xi;
-	buffer_sock_double[3+i*19] = elemento->dato->yi;
-	buffer_sock_double[4+i*19] = elemento->dato->anguloi;
-	buffer_sock_double[5+i*19] = elemento->dato->xf;
-	buffer_sock_double[6+i*19] = elemento->dato->yf;
-	buffer_sock_double[7+i*19] = elemento->dato->angulof;
-	buffer_sock_double[8+i*19] = (double)elemento->dato->tipo;
-	buffer_sock_double[9+i*19] = elemento->dato->xci;
-	buffer_sock_double[10+i*19] = elemento->dato->yci;
-	buffer_sock_double[11+i*19] = elemento->dato->xri;
-	buffer_sock_double[12+i*19] = elemento->dato->yri;
-	buffer_sock_double[13+i*19] = elemento->dato->xrf;
-	buffer_sock_double[14+i*19] = elemento->dato->yrf;
-	buffer_sock_double[15+i*19] = elemento->dato->xcf;
-	buffer_sock_double[16+i*19] = elemento->dato->ycf;
-	buffer_sock_double[17+i*19] = elemento->dato->Ci;
-	buffer_sock_double[18+i*19] = elemento->dato->S;
-	buffer_sock_double[19+i*19] = elemento->dato->Cf;
-	elemento = elemento->siguiente;
-        i++;
+	buffer_sock_double[2+i*19] = path->xi;
+	buffer_sock_double[3+i*19] = path->yi;
+	buffer_sock_double[4+i*19] = path->anguloi;
+	buffer_sock_double[5+i*19] = path->xf;
+	buffer_sock_double[6+i*19] = path->yf;
+	buffer_sock_double[7+i*19] = path->angulof;
+	buffer_sock_double[8+i*19] = (double)path->tipo;
+	buffer_sock_double[9+i*19] = path->xci;
+	buffer_sock_double[10+i*19] = path->yci;
+	buffer_sock_double[11+i*19] = path->xri;
+	buffer_sock_double[12+i*19] = path->yri;
+	buffer_sock_double[13+i*19] = path->xrf;
+	buffer_sock_double[14+i*19] = path->yrf;
+	buffer_sock_double[15+i*19] = path->xcf;
+	buffer_sock_double[16+i*19] = path->ycf;
+	buffer_sock_double[17+i*19] = path->Ci;
+	buffer_sock_double[18+i*19] = path->S;
+	buffer_sock_double[19+i*19] = path->Cf;
    }
 
 //int j = 0;
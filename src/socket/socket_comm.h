@@ -44,7 +44,7 @@ int socket_comm_init(void);
 
 int socket_comm_wait_client(void);
 
-int socket_comm_send_path(Lista_path *lista);
+int socket_comm_send_path(path_buff_t *buff);
 
 int socket_comm_update_position(position_t position);
 
@@ -31,22 +31,23 @@
 #include "OSD_Vars.h"
 #include <uquad_aux_time.h>
 #include <uquad_aux_math.h>
+#include <uquad_aux_angle.h>
 
 #include <sys/signal.h>
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <errno.h>
 #include <sys/ioctl.h> 
 #include <linux/serial.h>
 #include <termios.h>
 #include <math.h>
 
-#include <semaphore.h>
 #include <sys/types.h>
-#include <sys/ipc.h>
-#include <sys/shm.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
 
 
 struct timeval main_start_time;
@@ -85,6 +86,10 @@ int configure_port_CC3D(int fd, speed_t baudrate) //TODO cambiar nombre
   cfsetospeed(&options, baudrate);			// set the out baud rate...
   cfmakeraw(&options);
   options.c_cflag |= (CLOCAL | CREAD);			// enable the receiver and set local mode...
+  // El puerto queda no bloqueante (open_port_CC3D()): el parser espera con
+  // poll() y vacia con read() todo lo que haya, sin retener mensajes completos
+  options.c_cc[VMIN]  = 1;
+  options.c_cc[VTIME] = 0;
   
   // set the new options for the port...
   if((rc = tcsetattr(fd, TCSANOW, &options)) < 0){
@@ -97,23 +102,6 @@ int configure_port_CC3D(int fd, speed_t baudrate) //TODO cambiar nombre
 }
 
 
-/* devuelve true si puedo leer, false si no puedo */
-bool check_read_locks_CC3D(int fd) {
-
-   fd_set rfds;
-   struct timeval tv;
-   tv.tv_sec = 0;
-   tv.tv_usec = 10000; //TODO detemrinar el timeout en microsegundos
-   FD_ZERO(&rfds);
-   FD_SET(fd, &rfds);
-   int retval = select(fd+1, &rfds, NULL, NULL, &tv);
-   if(retval < 0)
-      puts("select() failed!");
-     
-   return FD_ISSET(fd,&rfds);
-}
-
-
 /*********************************************/
 /**************** UAVTalk ********************/
 /*********************************************/
@@ -169,67 +157,152 @@ int uavtalk_deinit(int fd)
 
 
 
-sem_t * sem_id_main;  	//Semaphore
-int shmid_main;	  	//Shared memory id
-act_sdata_t *shm_main;	//Shared memory var
-key_t key_main = 5678;
+/*********************************************/
+/*********** Canal de actitud ****************/
+/*********************************************/
 
-int uavtalk_init_shm(void)
-{
+#define UAVTALK_CH_MASK		(UAVTALK_CH_LEN - 1)
 
-   //Semaphore open
-   sem_id_main = sem_open("/mysem", O_CREAT, S_IRUSR | S_IWUSR, 1);
+static uavtalk_channel_t *ch = NULL;	// canal compartido (heredado por el parser)
+static int ch_efd = -1;			// eventfd para avisar al main
+static uint32_t ch_tail = 0;		// proxima muestra a leer (solo main)
+static unsigned long ch_lost = 0;	// muestras pisadas antes de ser leidas (solo main)
+static uint32_t ch_state_seq = 0;	// ultima version de state leida (solo main)
 
-   //Locate the segment.
-   if ((shmid_main = shmget(key_main, SHMSZ, 0666)) < 0) {
-        perror("shmget");
-        return -1;
+int uavtalk_init_shm(void)
+{
+   // Memoria compartida anonima, el hijo la hereda con el fork
+   ch = mmap(NULL, sizeof(uavtalk_channel_t), PROT_READ | PROT_WRITE,
+	     MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+   if (ch == MAP_FAILED) {
+	ch = NULL;
+	perror("mmap");
+	return -1;
    }
+   memset(ch, 0, sizeof(uavtalk_channel_t));
 
-   //Now we attach the segment to our data space.
-   if ((shm_main = shmat(shmid_main, NULL, 0)) == (void *) -1) {
-       perror("shmat");
-       return -1;
+   ch_efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+   if (ch_efd < 0) {
+	perror("eventfd");
+	return -1;
    }
-   
+
    return 0;
+}
 
+int uavtalk_get_fd(void)
+{
+   return ch_efd;
 }
 
+/**
+ * Escribe una muestra en el canal (lo llama solo el parser).
+ */
+static void uavtalk_ch_write(const actitud_t *act)
+{
+   uint64_t one = 1;
+   uint32_t n = ch->head;
+   uavtalk_ch_slot_t *slot = &ch->slot[n & UAVTALK_CH_MASK];
+
+   __atomic_store_n(&slot->seq, 2*n + 1, __ATOMIC_RELAXED);
+   __atomic_thread_fence(__ATOMIC_RELEASE);
+   slot->act = *act;
+   __atomic_store_n(&slot->seq, 2*n + 2, __ATOMIC_RELEASE);
+   __atomic_store_n(&ch->head, n + 1, __ATOMIC_RELEASE);
+
+   if (write(ch_efd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+	perror("write eventfd");
+}
 
-int uavtalk_read(actitud_t *act)
+/**
+ * Publica el estado de la CC3D (lo llama solo el parser). Si avisar es
+ * true despierta al main por el eventfd, igual que una muestra de actitud.
+ */
+static void uavtalk_ch_write_state(const uavtalk_state_t *st, bool avisar)
 {
-   int err_act = 0;	//Aumenta si no hay datos nuevos de actitud
-   int wait_data = 1;   //Va a cero si tengo dato nuevo para leer
+   uint64_t one = 1;
+   uint32_t seq = ch->state_seq;
 
-   while(wait_data) {
-   
-      // control de errores - si intento leer 3 veces (15ms) y no hay datos nuevos, cierro
-      if(err_act > 2) {
-	 return -1;
-      } 
-
-      sem_wait(sem_id_main); //activo semaforo para evitar que el parser modifique los datos mientras los leo
-      
-      // El parser sobreescribio un dato - //dbg
-      if(shm_main->flag == 2)
-         puts("perdi un dato actitud!"); //dbg
-
-      // si llego al dato antes de que este pronto espero un poco y vuelvo a consultar	
-      if(shm_main->flag == 0) { 
-         puts("llegue muy temprano!"); //dbg
-         sem_post(sem_id_main); //desactivo semaforo - no pude leer dato
-         sleep_ms(5); //doy tiempo a que este pronto el dato //TODO determinar cuanto
-         err_act++;
-      } else wait_data = 0; //si flag != 0 tengo dato nuevo!
-   
-   } //end while
+   __atomic_store_n(&ch->state_seq, seq + 1, __ATOMIC_RELAXED);
+   __atomic_thread_fence(__ATOMIC_RELEASE);
+   ch->state = *st;
+   __atomic_store_n(&ch->state_seq, seq + 2, __ATOMIC_RELEASE);
 
-   *act = shm_main->act; // copio de la memoria compartida a la memoria del main
-   shm_main->flag = 0;  // marco el flag acorde (dato leido)
-   sem_post(sem_id_main); //desactivo semaforo - (dato leido)
-   
-   return 0; //uavtalk_updated = true;
+   if (avisar && write(ch_efd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+	perror("write eventfd");
+}
+
+int uavtalk_read_state(uavtalk_state_t *st)
+{
+   uint32_t seq;
+
+   do {
+	seq = __atomic_load_n(&ch->state_seq, __ATOMIC_ACQUIRE);
+	if (seq == ch_state_seq)
+	   return 0; // sin cambios
+	*st = ch->state;
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+   } while ((seq & 1) || __atomic_load_n(&ch->state_seq, __ATOMIC_RELAXED) != seq);
+
+   ch_state_seq = seq;
+   return 1;
+}
+
+int uavtalk_read_samples(actitud_t *acts, int max)
+{
+   uint64_t cnt;
+   uint32_t head, seq;
+   uavtalk_ch_slot_t *slot;
+   int n = 0;
+
+   // Vacio el eventfd, a partir de aca cualquier muestra nueva lo vuelve a activar
+   if (read(ch_efd, &cnt, sizeof(cnt)) < 0 && errno != EAGAIN)
+	perror("read eventfd");
+
+   head = __atomic_load_n(&ch->head, __ATOMIC_ACQUIRE);
+
+   // El parser dio la vuelta al buffer
+   if (head - ch_tail > UAVTALK_CH_LEN) {
+	ch_lost += head - ch_tail - UAVTALK_CH_LEN;
+	ch_tail = head - UAVTALK_CH_LEN;
+   }
+
+   while (ch_tail != head && n < max) {
+	slot = &ch->slot[ch_tail & UAVTALK_CH_MASK];
+	seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+	acts[n] = slot->act;
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	if (seq != 2*ch_tail + 2 || __atomic_load_n(&slot->seq, __ATOMIC_RELAXED) != seq) {
+	   // Se piso mientras leia
+	   ch_lost++;
+	} else {
+	   n++;
+	}
+	ch_tail++;
+   }
+
+   return n;
+}
+
+int uavtalk_read(actitud_t *act)
+{
+   actitud_t acts[UAVTALK_CH_LEN];
+   int n, total = 0;
+
+   // Si quedan mas muestras que lugar en acts sigo leyendo
+   do {
+	n = uavtalk_read_samples(acts, UAVTALK_CH_LEN);
+	if (n > 0)
+	   *act = acts[n - 1];
+	total += n;
+   } while (n == UAVTALK_CH_LEN);
+
+   return total;
+}
+
+unsigned long uavtalk_get_lost(void)
+{
+   return ch_lost;
 }
 
 void uavtalk_print_attitude(actitud_t act)
@@ -256,166 +329,247 @@ int uavtalk_to_str(char* buf_str, actitud_t act)
 }
 
 
-static inline float uavtalk_get_float(uavtalk_message_t *msg, int pos) {
+static inline float uavtalk_get_float(const uavtalk_view_t *msg, int pos) {
 	float f;
 	memcpy(&f, msg->Data+pos, sizeof(float));
 	return f;
 }
 
 
-uint8_t uavtalk_parse_char(uint8_t c, uavtalk_message_t *msg)
+/**
+ * Lee del puerto (no bloqueante) todo lo que entre en el buffer de
+ * recepcion con un unico read(). Antes mueve al principio los bytes que
+ * quedaron sin procesar.
+ *
+ * @return bytes leidos, 0 si no hay datos disponibles, -1 si falla
+ */
+static int uavtalk_rx_fill(int fd, uavtalk_rx_t *rx)
 {
-	static uint8_t status = UAVTALK_PARSE_STATE_WAIT_SYNC;
-	static uint8_t crc = 0;
-	static uint8_t cnt = 0;
-
-	switch (status) {
-		case UAVTALK_PARSE_STATE_WAIT_SYNC:
-			if (c == UAVTALK_SYNC_VAL) {
-				//got_sync:;
-                                status = UAVTALK_PARSE_STATE_GOT_SYNC;
-				msg->Sync = c;
-				crc = crc_table[0 ^ c];
-			}
-		break;
-		case UAVTALK_PARSE_STATE_GOT_SYNC:
-			crc = crc_table[crc ^ c];
-			if ((c & UAVTALK_TYPE_MASK) == UAVTALK_TYPE_VER) {
-				status = UAVTALK_PARSE_STATE_GOT_MSG_TYPE;
-				msg->MsgType = c;
-				cnt = 0;
-			}
-			else {
-				status = UAVTALK_PARSE_STATE_WAIT_SYNC;
-			}
-		break;
-		case UAVTALK_PARSE_STATE_GOT_MSG_TYPE:
-			crc = crc_table[crc ^ c];
-			cnt++;
-			if (cnt < 2) {
-				msg->Length = ((uint16_t) c);
-			}
-			else {
-				msg->Length += ((uint16_t) c) << 8;
-                                if ((msg->Length < HEADER_LEN) || (msg->Length > 255 + HEADER_LEN)) {
-                                       // Drop corrupted messages:
-                                       // Minimal length is HEADER_LEN
-                                       // Maximum is HEADER_LEN + 255 (Data) + 2 (Optional Instance Id)
-                                       // As we are not parsing Instance Id, 255 is a hard maximum. 
-				       status = UAVTALK_PARSE_STATE_WAIT_SYNC;
-                                } else {
-				       status = UAVTALK_PARSE_STATE_GOT_LENGTH;
-				       cnt = 0;
-                                }
-			}
-		break;
-		case UAVTALK_PARSE_STATE_GOT_LENGTH:
-			crc = crc_table[crc ^ c];
-			cnt++;
-			switch (cnt) {
-				case 1:
-					msg->ObjID = ((uint32_t) c);
-				break;
-				case 2:
-					msg->ObjID += ((uint32_t) c) << 8;
-				break;
-				case 3:
-					msg->ObjID += ((uint32_t) c) << 16;
-				break;
-				case 4:
-					msg->ObjID += ((uint32_t) c) << 24;
-					status = UAVTALK_PARSE_STATE_GOT_OBJID;
-					cnt = 0;
-				break;
-			}
-		break;
-		case UAVTALK_PARSE_STATE_GOT_OBJID:
-			crc = crc_table[crc ^ c];
-			cnt++;
-			switch (cnt) {
-				case 1:
-					msg->InstID = ((uint32_t) c);
-				break;
-				case 2:
-					msg->InstID += ((uint32_t) c) << 8;
-					if (msg->Length == HEADER_LEN) { // no data exists
-						status = UAVTALK_PARSE_STATE_GOT_DATA;
-					} else {
-						status = UAVTALK_PARSE_STATE_GOT_INSTID;
-					}
-					cnt = 0;
-				break;
-			}
-		break;
-		case UAVTALK_PARSE_STATE_GOT_INSTID:
-			crc = crc_table[crc ^ c];
-			cnt++;
-			msg->Data[cnt - 1] = c;
-			if (cnt >= msg->Length - HEADER_LEN) {
-				status = UAVTALK_PARSE_STATE_GOT_DATA;
-				cnt = 0;
-			}
-		break;
-		case UAVTALK_PARSE_STATE_GOT_DATA:
-			msg->Crc = c;
-			status = UAVTALK_PARSE_STATE_GOT_CRC;
-		break;
+	int n;
+
+	if (rx->start > 0) {
+		memmove(rx->buff, rx->buff + rx->start, rx->end - rx->start);
+		rx->end -= rx->start;
+		rx->start = 0;
 	}
-	
-	if (status == UAVTALK_PARSE_STATE_GOT_CRC) {
-		status = UAVTALK_PARSE_STATE_WAIT_SYNC;
-		if (crc == msg->Crc) {
-			return msg->Length;
-		} else {
+
+	n = read(fd, rx->buff + rx->end, UAVTALK_RX_BUFF_SIZE - rx->end);
+	if (n < 0) {
+		if (errno == EAGAIN || errno == EWOULDBLOCK)
+			return 0;
+		if (errno != EINTR)
+			perror("read CC3D");
+		return -1;
+	}
+	rx->end += n;
+
+	return n;
+}
+
+
+/**
+ * Busca el proximo mensaje completo con CRC valido en el buffer de
+ * recepcion. Los bytes que no forman un mensaje valido se descartan.
+ *
+ * @param rx
+ * @param msg vista del mensaje encontrado (apunta a rx->buff)
+ *
+ * @return 1 si hay mensaje, 0 si hay que leer mas datos
+ */
+static int uavtalk_rx_next(uavtalk_rx_t *rx, uavtalk_view_t *msg)
+{
+	const uint8_t *p, *sync;
+	uint16_t length;
+	uint8_t crc;
+	int avail, i;
+
+	while (rx->start < rx->end) {
+		// Sincronizo
+		p = rx->buff + rx->start;
+		avail = rx->end - rx->start;
+		sync = memchr(p, UAVTALK_SYNC_VAL, avail);
+		if (sync == NULL) {
+			rx->start = rx->end;
 			return 0;
 		}
-	} else {
-		return 0;
+		rx->start += sync - p;
+		p = sync;
+		avail = rx->end - rx->start;
+
+		if (avail < HEADER_LEN)
+			return 0;
+
+		length = (uint16_t)p[2] | ((uint16_t)p[3] << 8);
+		if (((p[1] & UAVTALK_TYPE_MASK) != UAVTALK_TYPE_VER) ||
+		    (length < HEADER_LEN) || (length > 255 + HEADER_LEN)) {
+			// Drop corrupted messages:
+			// Minimal length is HEADER_LEN
+			// Maximum is HEADER_LEN + 255 (Data) + 2 (Optional Instance Id)
+			// As we are not parsing Instance Id, 255 is a hard maximum.
+			rx->start++;
+			continue;
+		}
+
+		if (avail < length + 1)
+			return 0; // falta el resto del mensaje
+
+		crc = 0;
+		for (i = 0; i < length; ++i)
+			crc = crc_table[crc ^ p[i]];
+		if (crc != p[length]) {
+			rx->start++;
+			continue;
+		}
+
+		msg->MsgType = p[1];
+		msg->Length  = length;
+		msg->ObjID   = (uint32_t)p[4] | ((uint32_t)p[5] << 8) |
+			       ((uint32_t)p[6] << 16) | ((uint32_t)p[7] << 24);
+		msg->InstID  = (uint16_t)p[8] | ((uint16_t)p[9] << 8);
+		msg->Data    = p + HEADER_LEN;
+
+		rx->start += length + 1;
+		return 1;
 	}
+
+	return 0;
 }
 
 
-int uavtalk_parser_read_char(int fd_CC3D, actitud_t *act)
+/*********************************************/
+/************** Decoders *********************/
+/*********************************************/
+
+static inline uint16_t uavtalk_get_uint16(const uavtalk_view_t *msg, int pos) {
+	return (uint16_t)msg->Data[pos] | ((uint16_t)msg->Data[pos+1] << 8);
+}
+
+/**
+ * Verifica que el mensaje tenga los datos necesarios (los requests y acks
+ * llegan sin datos).
+ */
+static inline bool uavtalk_has_data(const uavtalk_view_t *msg, int len) {
+	return (msg->Length - HEADER_LEN) >= len;
+}
+
+static int uavtalk_decode_attitude(const uavtalk_view_t *msg, uavtalk_decode_ctx_t *ctx)
 {
-   int retval = 0;
-   static uavtalk_message_t msg;
-   uint8_t data;
    static double last_yaw = 0; //Para fix
+   actitud_t *act = &ctx->act;
 
    // Control de tiempos
    struct timeval tv_aux;
+   int retval;
 
-   retval = read(fd_CC3D,&data,1);
-   if (retval <= 0) {
-	puts("read failed");
-	return -1;
-   } else {
-	retval = uavtalk_parse_char(data, &msg);
-	if (retval > 0) {
-	   // consume msg
-	   if (msg.ObjID == ATTITUDESTATE_OBJID)
-	   {
-		act->roll  = uavtalk_get_float(&msg, ATTITUDEACTUAL_OBJ_ROLL)*M_PI/180;
-		act->pitch = uavtalk_get_float(&msg, ATTITUDEACTUAL_OBJ_PITCH)*M_PI/180;
-		act->yaw   = uavtalk_get_float(&msg, ATTITUDEACTUAL_OBJ_YAW)*M_PI/180;
-		   
-		//Correccion de discontinuidad de atan2
-		double dyaw = act->yaw - last_yaw;
-		if (abs(dyaw) >= M_PI)
-		   act->yaw -= 2.0*M_PI*fix((dyaw+M_PI*sign(dyaw))/(2.0*M_PI));
-		last_yaw = act->yaw;
-                                 
-		// Timestamp
-		gettimeofday(&tv_aux,NULL);
-                uquad_timeval_substract(&act->ts, tv_aux, main_start_time);
-   		if(retval < 0)
-		   puts("WARN: Absurd timing!");
-		return 1; //uavtalk updated!
-	   }
-	}
+   if (!uavtalk_has_data(msg, ATTITUDEACTUAL_OBJ_YAW + sizeof(float)))
+	return 0;
+
+   act->roll  = uavtalk_get_float(msg, ATTITUDEACTUAL_OBJ_ROLL)*M_PI/180;
+   act->pitch = uavtalk_get_float(msg, ATTITUDEACTUAL_OBJ_PITCH)*M_PI/180;
+   act->yaw   = uavtalk_get_float(msg, ATTITUDEACTUAL_OBJ_YAW)*M_PI/180;
+
+   //Correccion de discontinuidad de atan2
+   act->yaw = uquad_angle_unwrap(act->yaw, last_yaw);
+   last_yaw = act->yaw;
+
+   // Timestamp
+   gettimeofday(&tv_aux,NULL);
+   retval = uquad_timeval_substract(&act->ts, tv_aux, main_start_time);
+   if(retval < 0)
+	puts("WARN: Absurd timing!");
+
+   return 1; //uavtalk updated!
+}
+
+static int uavtalk_decode_flightstatus(const uavtalk_view_t *msg, uavtalk_decode_ctx_t *ctx)
+{
+   if (!uavtalk_has_data(msg, FLIGHTSTATUS_OBJ_FLIGHTMODE + 1))
+	return 0;
+
+   ctx->state.armed       = msg->Data[FLIGHTSTATUS_OBJ_ARMED];
+   ctx->state.flight_mode = msg->Data[FLIGHTSTATUS_OBJ_FLIGHTMODE];
+   return 1;
+}
+
+static int uavtalk_decode_manualcontrol(const uavtalk_view_t *msg, uavtalk_decode_ctx_t *ctx)
+{
+   int i;
+
+   if (!uavtalk_has_data(msg, MANUALCONTROLCOMMAND_OBJ_CHANNEL_8 + sizeof(uint16_t)))
+	return 0;
+
+   ctx->state.throttle = uavtalk_get_float(msg, MANUALCONTROLCOMMAND_OBJ_THROTTLE);
+   for (i = 0; i < UAVTALK_MANUALCONTROL_CHANNELS; ++i)
+	ctx->state.channel[i] = uavtalk_get_uint16(msg, MANUALCONTROLCOMMAND_OBJ_CHANNEL_0 + 2*i);
+   return 1;
+}
+
+static int uavtalk_decode_alarms(const uavtalk_view_t *msg, uavtalk_decode_ctx_t *ctx)
+{
+   if (!uavtalk_has_data(msg, SYSTEMALARMS_ALARM_MANUALCONTROL + 1))
+	return 0;
+
+   ctx->state.alarm_cpu    = msg->Data[SYSTEMALARMS_ALARM_CPUOVERLOAD];
+   ctx->state.alarm_event  = msg->Data[SYSTEMALARMS_ALARM_EVENTSYSTEM];
+   ctx->state.alarm_manual = msg->Data[SYSTEMALARMS_ALARM_MANUALCONTROL];
+   return 1;
+}
+
+static int uavtalk_decode_telemetry(const uavtalk_view_t *msg, uavtalk_decode_ctx_t *ctx)
+{
+   if (!uavtalk_has_data(msg, FLIGHTTELEMETRYSTATS_OBJ_STATUS_001 + 1))
+	return 0;
+
+   ctx->state.telemetry_status = msg->Data[FLIGHTTELEMETRYSTATS_OBJ_STATUS_001];
+   return 1;
+}
+
+/*
+ * Objetos registrados: UAVTALK_OBJETO(ObjID, decoder, slot), uno por linea
+ * y ORDENADOS POR ObjID para la busqueda binaria. El orden se verifica al
+ * compilar. ObjIDs de VERSION_RELEASE_15_02_1. Para agregar un objeto se
+ * escribe su decoder y se registra aca, en el lugar que le corresponde.
+ */
+#define UAVTALK_OBJETOS(UAVTALK_OBJETO) \
+	UAVTALK_OBJETO(MANUALCONTROLCOMMAND_OBJID_002,	uavtalk_decode_manualcontrol,	UAVTALK_SLOT_MANUALCONTROL)	/* 0x161A2C98 */ \
+	UAVTALK_OBJETO(FLIGHTTELEMETRYSTATS_OBJID_001,	uavtalk_decode_telemetry,	UAVTALK_SLOT_TELEMETRY)		/* 0x6737BB5A */ \
+	UAVTALK_OBJETO(SYSTEMALARMS_OBJID_005,		uavtalk_decode_alarms,		UAVTALK_SLOT_ALARMS)		/* 0x6B7639EC */ \
+	UAVTALK_OBJETO(FLIGHTSTATUS_OBJID_005,		uavtalk_decode_flightstatus,	UAVTALK_SLOT_FLIGHTSTATUS)	/* 0x8A80EA52 */ \
+	UAVTALK_OBJETO(ATTITUDESTATE_OBJID,		uavtalk_decode_attitude,	UAVTALK_SLOT_ATTITUDE)		/* 0xD7E0D964 */
+
+#define UAVTALK_DISPATCH_ENTRADA(id, decoder, slot)	{ id, decoder, slot },
+static const uavtalk_dispatch_t uavtalk_dispatch_table[] = {
+	UAVTALK_OBJETOS(UAVTALK_DISPATCH_ENTRADA)
+};
+
+// Orden estricto, se expande a (-1 < id0) && (id0 < id1) && ... && (idN < 2^32)
+#define UAVTALK_DISPATCH_MENOR(id, decoder, slot)	< (long long)(id)) && ((long long)(id)
+_Static_assert(((-1LL UAVTALK_OBJETOS(UAVTALK_DISPATCH_MENOR) < 0x100000000LL)),
+	       "uavtalk_dispatch_table tiene que estar ordenada por ObjID");
+
+#define UAVTALK_DISPATCH_LEN	(sizeof(uavtalk_dispatch_table)/sizeof(uavtalk_dispatch_t))
+
+/**
+ * Busca el decoder de un ObjID. La tabla es fija y chica, la busqueda
+ * binaria hace a lo sumo 3 comparaciones.
+ *
+ * @return entrada de la tabla o NULL si el objeto no interesa
+ */
+static const uavtalk_dispatch_t *uavtalk_dispatch_find(uint32_t objid)
+{
+   int lo = 0, hi = UAVTALK_DISPATCH_LEN - 1, mid;
+
+   while (lo <= hi) {
+	mid = (lo + hi) / 2;
+	if (uavtalk_dispatch_table[mid].ObjID == objid)
+	   return &uavtalk_dispatch_table[mid];
+	if (uavtalk_dispatch_table[mid].ObjID < objid)
+	   lo = mid + 1;
+	else
+	   hi = mid - 1;
    }
 
-   return 0; //uavtalk not updated.
+   return NULL;
 }
 
 
@@ -431,16 +585,15 @@ int uavtalk_parser_start(struct timeval main_start)
 	int retval = 0;
 
 	int fd_CC3D;
-	int shmid;
-	sem_t *sem_id;
-
-	bool CC3D_readOK;
-	actitud_t act;
-	int act_updated = 0;
 
-	// shm - shared memory.
-	key_t key = 5678;
-	act_sdata_t *shm;
+	static uavtalk_rx_t rx;
+	uavtalk_view_t msg;
+	uavtalk_decode_ctx_t ctx;
+	const uavtalk_dispatch_t *disp;
+	bool state_updated;
+	static uavtalk_state_t state_pub;	// ultimo estado publicado
+	struct timeval tv_aux;
+	struct pollfd pfd;
 
 	main_start_time = main_start;
 
@@ -453,49 +606,60 @@ int uavtalk_parser_start(struct timeval main_start)
 	   puts("Failed to init UAVTalk!");
 	   exit(1);  
 	}
-   
-	// Semaphore open
-	sem_id=sem_open("/mysem", O_CREAT, S_IRUSR | S_IWUSR, 1);
-
-	//Create the segment.
-	if ((shmid = shmget(key, SHMSZ, IPC_CREAT | 0666)) < 0) {
-	   perror("shmget");
-	   exit(1);
-	}
 
-	//Now we attach the segment to our data space.
-	if ((shm = shmat(shmid, NULL, 0)) == (void *) -1) {
-	   perror("shmat");
+	// El canal lo crea el main con uavtalk_init_shm() antes del fork
+	if (ch == NULL) {
+	   puts("Canal de actitud no inicializado!");
 	   exit(1);
 	}
 
-	// inicializa el valor del flag
-	shm->flag = 0;
+	memset(&ctx, 0, sizeof(ctx));
 
 	// -- -- -- -- -- -- -- -- -- 
 	// Loop
 	// -- -- -- -- -- -- -- -- -- 
+	rx.start = 0;
+	rx.end = 0;
+	pfd.fd = fd_CC3D;
+	pfd.events = POLLIN;
 	for(;;)
 	{
-	
-	   CC3D_readOK = check_read_locks_CC3D(fd_CC3D);
-	   if (CC3D_readOK) {
-		act_updated = uavtalk_parser_read_char(fd_CC3D, &act);
-		CC3D_readOK = false;
+	   // Espero a que lleguen datos, sin timeout
+	   if (poll(&pfd, 1, -1) < 0) {
+		if (errno != EINTR)
+		   perror("poll CC3D");
+		continue;
 	   }
 
-	   if(act_updated > 0)
+	   // Vacio el puerto: un read() por bloque de datos, no por byte, y
+	   // consumo todos los mensajes completos de cada bloque
+	   state_updated = false;
+	   while (uavtalk_rx_fill(fd_CC3D, &rx) > 0)
 	   {
-		sem_wait(sem_id);
-		shm->act = act;
-		if(shm->flag > 0) {
-		   shm->flag = 2;
-		} else {
-		   shm->flag = 1;
+		while (uavtalk_rx_next(&rx, &msg) > 0)
+		{
+		   disp = uavtalk_dispatch_find(msg.ObjID);
+		   if (disp == NULL || disp->decode(&msg, &ctx) <= 0)
+			continue;
+
+		   if (disp->slot == UAVTALK_SLOT_ATTITUDE) {
+			uavtalk_ch_write(&ctx.act);
+		   } else {
+			ctx.state.updated |= 1 << disp->slot;
+			state_updated = true;
+		   }
 		}
-		sem_post(sem_id);
+	   }
 
-		act_updated = 0;
+	   // El estado se publica una vez por despertar, y se avisa al main si
+	   // cambio algo ademas del timestamp (ts todavia es el de la
+	   // publicacion anterior)
+	   if (state_updated) {
+		state_updated = (memcmp(&ctx.state, &state_pub, sizeof(state_pub)) != 0);
+		gettimeofday(&tv_aux,NULL);
+		uquad_timeval_substract(&ctx.state.ts, tv_aux, main_start_time);
+		uavtalk_ch_write_state(&ctx.state, state_updated);
+		memcpy(&state_pub, &ctx.state, sizeof(state_pub));
 	   }
 
 	} // for(;;)
@@ -509,17 +673,6 @@ int uavtalk_parser_start(struct timeval main_start)
 	if(retval != 0)
 	   puts("Could not close UAVTalk correctly!");
 
-	// Remove shared memory
-	shmctl(shmid, IPC_RMID, NULL);
-
-	//Semaphore Close: Close a named semaphore
-	if ( sem_close(sem_id) < 0 )
-	   perror("sem_close");
-    
-	//Semaphore unlink: Remove a named semaphore  from the system.
-	if ( sem_unlink("/mysem") < 0 )
-	   perror("sem_unlink");
-	
 	return -1;
 
    }
@@ -130,19 +130,11 @@
 #define UAVTALK_TYPE_NACK				(UAVTALK_TYPE_VER | 0x04)
 
 #define CC3D_DEVICE	"/dev/ttyO1"
-#define SHMSZ     27
 
-typedef enum {
-	UAVTALK_PARSE_STATE_WAIT_SYNC = 0,
-	UAVTALK_PARSE_STATE_GOT_SYNC,
-	UAVTALK_PARSE_STATE_GOT_MSG_TYPE,
-	UAVTALK_PARSE_STATE_GOT_LENGTH,
-	UAVTALK_PARSE_STATE_GOT_OBJID,
-	UAVTALK_PARSE_STATE_GOT_INSTID,
-	UAVTALK_PARSE_STATE_GOT_DATA,
-	UAVTALK_PARSE_STATE_GOT_CRC
-} uavtalk_parse_state_t;
+#define UAVTALK_CH_LEN	16	// muestras de actitud en el canal compartido (potencia de 2)
 
+#define UAVTALK_RX_BUFF_SIZE	1024	// buffer de recepcion del parser
+#define UAVTALK_MAX_MSG_LEN	(HEADER_LEN + 255 + 1)	// header + datos + crc
 
 typedef enum {
 	TELEMETRYSTATS_STATE_DISCONNECTED = 0,
@@ -152,15 +144,29 @@ typedef enum {
 } telemetrystats_state_t;
 
 
-typedef struct __uavtalk_message {
-	uint8_t Sync;
+/*
+ * Vista de un mensaje completo y con CRC valido dentro del buffer de
+ * recepcion. Los datos no se copian: Data apunta al buffer y es valido
+ * hasta la proxima lectura del puerto.
+ */
+typedef struct uavtalk_view {
 	uint8_t MsgType;
-	uint16_t Length;
+	uint16_t Length;		// largo del header + datos (sin CRC)
 	uint32_t ObjID;
 	uint16_t InstID;
-	uint8_t Data[255];
-	uint8_t Crc;
-} uavtalk_message_t;
+	const uint8_t *Data;		// Length - HEADER_LEN bytes
+} uavtalk_view_t;
+
+/*
+ * Buffer de recepcion del parser. Se llena con un read() por vez y los
+ * mensajes se extraen de [start, end). Lo que queda sin procesar se mueve
+ * al principio antes de volver a leer, asi cada mensaje queda contiguo.
+ */
+typedef struct uavtalk_rx {
+	uint8_t buff[UAVTALK_RX_BUFF_SIZE];
+	int start;			// primer byte sin procesar
+	int end;			// fin de los datos recibidos
+} uavtalk_rx_t;
 
 
 typedef struct actitud {
@@ -172,24 +178,139 @@ typedef struct actitud {
 
 
 /*
- * Estructura para almacenar valor de actitud en memoria compartida
- * entre el main y el proceso uavtalk_parser
+ * Canal de actitud en memoria compartida entre el proceso uavtalk_parser
+ * (unico productor) y el main (unico consumidor).
  *
- * El valor del flag significa:
- * 0 - No hay dato nuevo
- * 1 - Hay un dato nuevo
- * 2 - Se sobreescribio un dato no leido
+ * Es un buffer circular sin locks: cada lugar tiene un numero de secuencia
+ * que vale 2n+1 mientras el parser escribe la muestra n y 2n+2 cuando
+ * termino. El main lee sin bloquear al parser; si el parser le da la vuelta
+ * al buffer antes de que el main lea, las muestras pisadas se cuentan como
+ * perdidas.
+ */
+typedef struct uavtalk_ch_slot {
+	uint32_t seq;
+	actitud_t act;
+} uavtalk_ch_slot_t;
+
+/*
+ * Destino de cada objeto decodificado en el canal compartido. La actitud
+ * va al buffer circular (interesa cada muestra), el resto a uavtalk_state_t
+ * (interesa el ultimo valor).
+ */
+typedef enum {
+	UAVTALK_SLOT_ATTITUDE = 0,
+	UAVTALK_SLOT_FLIGHTSTATUS,
+	UAVTALK_SLOT_MANUALCONTROL,
+	UAVTALK_SLOT_ALARMS,
+	UAVTALK_SLOT_TELEMETRY,
+	UAVTALK_SLOT_COUNT
+} uavtalk_slot_t;
+
+#define UAVTALK_MANUALCONTROL_CHANNELS	9
+
+/*
+ * Ultimo estado de la CC3D publicado por el parser junto con la actitud.
  */
-typedef struct act_sdata {
+typedef struct uavtalk_state {
+	uint8_t armed;				// FLIGHTSTATUS: 0 desarmado, 1 armando, 2 armado
+	uint8_t flight_mode;			// FLIGHTSTATUS: modo de vuelo
+	float throttle;				// MANUALCONTROLCOMMAND: throttle [-1,1]
+	uint16_t channel[UAVTALK_MANUALCONTROL_CHANNELS]; // MANUALCONTROLCOMMAND: canales del receptor
+	uint8_t alarm_cpu;			// SYSTEMALARMS: 1 OK, 2 warning, 3 error, 4 critico
+	uint8_t alarm_event;
+	uint8_t alarm_manual;
+	uint8_t telemetry_status;		// FLIGHTTELEMETRYSTATS: telemetrystats_state_t
+	uint32_t updated;			// slots recibidos alguna vez (1 << uavtalk_slot_t)
+	struct timeval ts;			// ultima actualizacion
+} uavtalk_state_t;
+
+typedef struct uavtalk_channel {
+	uint32_t head;				// muestras escritas (solo lo modifica el parser)
+	uavtalk_ch_slot_t slot[UAVTALK_CH_LEN];
+	uint32_t state_seq;			// seqlock de state (impar mientras se escribe)
+	uavtalk_state_t state;
+} uavtalk_channel_t;
+
+/*
+ * Estado local del parser sobre el que trabajan los decoders.
+ */
+typedef struct uavtalk_decode_ctx {
 	actitud_t act;
-	int flag;
-} act_sdata_t;
+	uavtalk_state_t state;
+} uavtalk_decode_ctx_t;
+
+/**
+ * Decoder de un objeto UAVTalk.
+ *
+ * @param msg mensaje completo con CRC valido
+ * @param ctx estado local donde se guarda lo decodificado
+ *
+ * @return 1 si se actualizo ctx, 0 si no
+ */
+typedef int (*uavtalk_decoder_t)(const uavtalk_view_t *msg, uavtalk_decode_ctx_t *ctx);
+
+/*
+ * Entrada de la tabla de despacho ObjID -> decoder -> slot destino.
+ * Los objetos se registran en UAVTALK_OBJETOS (uavtalk_parser.c), ordenados
+ * por ObjID; el orden se verifica al compilar.
+ */
+typedef struct uavtalk_dispatch {
+	uint32_t ObjID;
+	uavtalk_decoder_t decode;
+	uavtalk_slot_t slot;
+} uavtalk_dispatch_t;
 
 int uavtalk_parser_start(struct timeval main_start);
 void uavtalk_print_attitude(actitud_t act);
 int uavtalk_to_str(char* buf_str, actitud_t act);
+
+/**
+ * Crea el canal compartido y el eventfd con el que el parser avisa que hay
+ * muestras nuevas. Se debe llamar antes de uavtalk_parser_start() para que
+ * el proceso hijo los herede.
+ *
+ * @return 0 si ok, -1 si falla
+ */
 int uavtalk_init_shm(void);
+
+/**
+ * Devuelve el eventfd que se vuelve legible cuando hay muestras nuevas,
+ * para registrarlo en el bucle de eventos del main.
+ */
+int uavtalk_get_fd(void);
+
+/**
+ * Lee, sin bloquear, todas las muestras nuevas en orden.
+ *
+ * @param acts buffer donde se copian las muestras
+ * @param max tamano del buffer
+ *
+ * @return cantidad de muestras leidas
+ */
+int uavtalk_read_samples(actitud_t *acts, int max);
+
+/**
+ * Lee, sin bloquear, la muestra de actitud mas nueva.
+ *
+ * @param act
+ *
+ * @return cantidad de muestras nuevas (0 si no hay dato nuevo)
+ */
 int uavtalk_read(actitud_t *act);
 
+/**
+ * Lee, sin bloquear, el ultimo estado publicado por la CC3D.
+ *
+ * @param st
+ *
+ * @return 1 si cambio desde la ultima lectura, 0 si no
+ */
+int uavtalk_read_state(uavtalk_state_t *st);
+
+/**
+ * @return cantidad de muestras pisadas por el parser antes de ser leidas
+ */
+unsigned long uavtalk_get_lost(void);
+
 #endif /* UAVTALK_H_ */
 